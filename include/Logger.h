@@ -20,6 +20,8 @@ class Logger{
     Logger &operator<<(T& thing){m_stream<<thing;return *this;}
   // For correct instantiation of std::endl template parameters (so you can use 'endl' instead of '\n'
   Logger &operator<<(std::ostream& (*pf) (std::ostream&)){m_stream<<pf;return *this;}
+  // Start the log again in filename (a forked -pmceval worker)
+  void redirect(const std::string& filename);
  private:
   Logger();
   ~Logger();
@@ -18,6 +18,12 @@
 	
 	A class for iteratively solving the Baranov Catch Equation
 	when conditioned on catch.
+
+	All of the getFishingMortality overloads share one templated Newton
+	solver; the overloads differ only in the shape of natural mortality
+	(scalar, vector-at-age, or matrix by sex) and whether catch is in
+	numbers or weight.  Work arrays are kept in the object between calls,
+	so reuse one BaranovCatchEquation object inside year and draw loops.
 	
 © Copyright `2013`  - . All Rights Reserved.
 
@@ -27,9 +33,64 @@
 **/
 #include <admodel.h>
 
+/** \brief Outcome of one Baranov catch equation solve.
+
+	converged is true when norm(ct - chat) < TOL was reached; clipped is
+	true when any ft was truncated at MAXF, which usually means the catch
+	cannot be taken from the available biomass (e.g. a high TAC).
+**/
+struct BaranovResult
+{
+	int    iterations;	//!< Newton iterations used.
+	double fnorm;		//!< Norm of ct - chat at the last iteration.
+	bool   converged;	//!< Residual below TOL.
+	bool   clipped;		//!< Some ft truncated at MAXF.
+};
+
+/** \brief Aggregate counters over many Baranov solves.
+
+	\sa BaranovCatchEquation::getStats
+**/
+struct BaranovStats
+{
+	long   calls;			//!< Number of solves.
+	long   iterations;		//!< Total Newton iterations.
+	int    maxIterations;	//!< Most iterations used by one solve.
+	long   unconverged;		//!< Solves that stopped with norm(fx) >= TOL.
+	long   clipped;			//!< Solves with ft truncated at MAXF.
+	double maxFnorm;		//!< Largest final residual norm.
+	long   histogram[MAXITS+1];	//!< Number of solves by iterations used.
+
+	BaranovStats() { reset(); }
+	void reset();
+	void add(const BaranovResult& r);
+	void add(const BaranovStats& s);
+	void write(ostream& os) const;
+};
+
 class BaranovCatchEquation
 {
-	dmatrix m_hCt;
+	dmatrix m_hCt;		//!< Catch by sex (row) and gear (col) from the last solve.
+
+	// Work arrays for the Newton iterations, reallocated only when the
+	// number of gears, sexes or ages changes between calls.
+	dvector m_ft;		//!< Fishing mortality rate for each gear.
+	dvector m_chat;		//!< Predicted catch for each gear.
+	dvector m_fx;		//!< Residual ct - chat, overwritten by the Newton step.
+	dmatrix m_G;		//!< Jacobian d(fx)/d(ft), overwritten by its LU factors.
+	dmatrix m_ba;		//!< Numbers (or biomass) at age by sex.
+
+	BaranovResult m_result;	//!< Convergence record of the last solve.
+
+	void allocateWorkspace(const int& ngear, const int& nsex, const int& sage, const int& nage);
+	void luSolve();
+
+	template<class M_t, class V_t, class N_t, class W_t>
+	dvector solve(const dvector &ct, const M_t &ma, const V_t &V, const N_t &na, const W_t &wa);
+
+	template<class M_t, class V_t, class N_t, class W_t>
+	dmatrix jacobian(const dvector &ft, const M_t &ma, const V_t &V, const N_t &na, const W_t &wa);
+
 public:
 	//! Constructor
 	BaranovCatchEquation();
@@ -40,6 +101,16 @@ public:
 	**/
 	~BaranovCatchEquation();
 
+	//! Convergence record of the most recent getFishingMortality call.
+	const BaranovResult& getResult() const { return m_result; }
+
+	// Counters summed over every solve in this process (thread safe).
+	static void record(const BaranovResult& r);
+	static void record(const BaranovStats& s);
+	static BaranovStats getStats();
+	static void resetStats();
+	static void writeStats(ostream& os);
+
 	double get_ft(const double& ct, const double& m, const dvector& va, const dvector& ba);
 	double get_ftdd(const double& ct, const double& m, const double& b);
 		
@@ -56,6 +127,10 @@ public:
 	// SM 2sex version which modifes a catch by sex matrix
 	dvector getFishingMortality(const dvector &ct, const dmatrix &ma, const d3_array *p_V, const dmatrix &na, dmatrix &_hCt);
 	dvector getFishingMortality(const dvector &ct, const dmatrix &ma, const d3_array *p_V, const dmatrix &na, const dmatrix &wa, dmatrix &_hCt);
+
+	// dC/dF at ft, for attaching derivatives to a catch conditioned ft.
+	dmatrix getCatchJacobian(const dvector &ft, const dmatrix &ma, const d3_array *p_V, const dmatrix &na);
+	dmatrix getCatchJacobian(const dvector &ft, const dmatrix &ma, const d3_array *p_V, const dmatrix &na, const dmatrix &wa);
 	
 };
 
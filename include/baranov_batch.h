@@ -0,0 +1,82 @@
+#ifndef BARANOV_BATCH_H
+#define BARANOV_BATCH_H
+
+#include <vector>
+#include <admodel.h>
+#include "baranov.h"
+
+/** \brief  Batched Baranov catch equation solver
+
+	Solves many independent catch equations (one per projection year,
+	TAC option or posterior draw) for the fishing mortality rates that
+	predict the catch by gear, using the same Newton-Raphson iterations,
+	starting values and stopping rule as BaranovCatchEquation.
+
+	Problems are stored structure-of-arrays, with the problem index
+	running fastest, e.g. N(a,p) is at [(a-sage)*nprob + p-1].  Problems
+	are solved in blocks of BLOCK; every loop over a block is a unit stride
+	loop over problems so the compiler can vectorize across problems.  The
+	small Jacobian systems are reduced with the partial pivoting of
+	BaranovCatchEquation::luSolve, the pivot row chosen per problem; a
+	problem whose pivot vanishes is marked as failed rather than stopping
+	the batch.  With threaded = true the blocks
+	are shared out with parallel::for_each.  Each block adds its
+	convergence counts to BaranovCatchEquation::getStats.
+
+	Natural mortality and selectivity are at age for a single sex, as in
+	projection_model.  Catch is in weight when wa is given, otherwise in
+	numbers.
+
+	\sa BaranovCatchEquation
+**/
+class BaranovBatch
+{
+private:
+	int m_nprob;	//!< Number of problems
+	int m_ngear;	//!< Number of gears with catch
+	int m_sage;		//!< Youngest age
+	int m_nage;		//!< Oldest age
+	int m_nages;	//!< Number of ages
+
+	std::vector<double> m_ct;	//!< Catch (gear, problem)
+	std::vector<double> m_M;	//!< Natural mortality (age, problem)
+	std::vector<double> m_V;	//!< Selectivity (gear, age, problem)
+	std::vector<double> m_N;	//!< Numbers-at-age (age, problem)
+	std::vector<double> m_W;	//!< Weight-at-age (age, problem), 1 for catch in numbers
+	std::vector<double> m_F;	//!< Solution (gear, problem)
+	std::vector<int>    m_its;	//!< Iterations used (problem)
+	std::vector<char>   m_fail;	//!< Singular Jacobian (problem)
+	std::vector<double> m_fnorm;	//!< Final residual norm (problem)
+	std::vector<char>   m_clip;	//!< F truncated at MAXF (problem)
+
+	void solveBlock(const int& p0, const int& p1);
+
+public:
+	static const int BLOCK = 64;	//!< Problems per block
+
+	BaranovBatch(const int& nprob, const int& ngear, const int& sage, const int& nage);
+
+	// Fill problem p (1..nprob)
+	void setProblem(const int& p, const dvector &ct, const dvector &ma, const dmatrix &V, const dvector &na, const dvector &wa);
+	void setProblem(const int& p, const dvector &ct, const dvector &ma, const dmatrix &V, const dvector &na);
+	void setProblem(const int& p, const dvector &ct, const double &m, const dmatrix &V, const dvector &na, const dvector &wa);
+
+	// Direct access for callers that lay the problems out themselves
+	double& ct(const int& p, const int& k)             { return m_ct[(k-1)*m_nprob + p-1]; }
+	double& M (const int& p, const int& a)             { return m_M[(a-m_sage)*m_nprob + p-1]; }
+	double& V (const int& p, const int& k, const int& a) { return m_V[((k-1)*m_nages + a-m_sage)*m_nprob + p-1]; }
+	double& N (const int& p, const int& a)             { return m_N[(a-m_sage)*m_nprob + p-1]; }
+	double& W (const int& p, const int& a)             { return m_W[(a-m_sage)*m_nprob + p-1]; }
+
+	void solve(const bool& threaded = false);
+
+	// Getters
+	int    getProblems() const { return m_nprob; }
+	double getF(const int& p, const int& k) const { return m_F[(k-1)*m_nprob + p-1]; }
+	dvector getFishingMortality(const int& p) const;
+	int    getIterations(const int& p) const { return m_its[p-1]; }
+	bool   getFail(const int& p) const { return m_fail[p-1]; }
+	BaranovResult getResult(const int& p) const;
+};
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef _BUFFERED_OFSTREAM_H
+#define _BUFFERED_OFSTREAM_H
+
+#include <csignal>
+#include <fstream>
+#include <ostream>
+#include <streambuf>
+#include <vector>
+
+/** \brief  Output file with a large user-space buffer and a background writer
+
+	An output stream that is meant to stay open for a whole mceval: the
+	stream fills a BUFSIZE buffer, and when the buffer is full or flush()
+	is called the buffer is handed to a single writer thread that does the
+	disk write, so the thread evaluating the model does not wait on the
+	file system.  The hand-over is a bounded queue of QUEUESIZE buffers
+	(see the .cpp); only if the disk falls that far behind does the
+	producer block.  Buffers of all files go through the one queue in the
+	order they are handed over, so each file is written in order.
+
+	Every open BufferedOfstream is registered so that flushAll()
+	(FINAL_SECTION) can write out what is left in the buffers.  flush()
+	only queues the buffer; close() and flushAll() return once the data
+	has been written.
+
+	The handler installed by flushOnSignal() only records SIGINT or
+	SIGTERM (and restores the default action, so a second signal ends the
+	run at once).  The main thread writes out the buffers and raises the
+	signal again at the next record boundary: flush(), or pollSignal(),
+	which the model calls once per mceval draw.  A full buffer is not one
+	(it can end in the middle of a row), so the files end with whole rows.
+	With no file open the handler raises the signal right away.
+
+	Files are opened, written and closed from the main thread only (the
+	queue has a single producer).
+**/
+class BufferedOfstream : public std::ostream
+{
+private:
+	/** Stream buffer that queues full buffers for the writer thread */
+	class AsyncBuf : public std::streambuf
+	{
+	private:
+		std::filebuf      m_file;
+		std::vector<char> m_buf;
+		bool              m_failed;
+
+	public:
+		AsyncBuf();
+
+		bool open(const char* filename, std::ios_base::openmode mode);
+		bool close();
+		bool is_open() const { return m_file.is_open(); }
+		bool submit();
+
+	protected:
+		virtual int_type overflow(int_type c);
+		virtual int sync();
+	};
+
+	AsyncBuf m_sbuf;
+
+	static std::vector<BufferedOfstream*>& registry();
+	static void onSignal(int sig);
+
+	static volatile std::sig_atomic_t s_signal;	//!< Signal to raise after flushing, 0 for none
+	static volatile std::sig_atomic_t s_open;	//!< Number of open files
+
+public:
+	static const size_t BUFSIZE   = 1 << 20;	//!< Buffer size in bytes
+	static const size_t QUEUESIZE = 8;			//!< Buffers waiting for the writer
+
+	BufferedOfstream();
+	~BufferedOfstream();
+
+	void open(const char* filename, std::ios_base::openmode mode = std::ios_base::out);
+	bool is_open() const { return m_sbuf.is_open(); }
+	void close();
+
+	static void flushAll();
+	static void flushOnSignal();
+	static void pollSignal();
+};
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef _COUNTER_RNG_H
+#define _COUNTER_RNG_H
+
+#include <stdint.h>
+#include <admodel.h>
+
+/** \brief  Counter-based random numbers (Philox4x32-10)
+
+	Each random number is a pure function of a key and a counter
+	(Salmon et al. 2011, "Parallel random numbers: as easy as 1, 2, 3").
+	The key is (seed, stream) and the counter is four integers that name
+	the number, e.g. (draw, TAC, year, index) in the projections, so the
+	value does not depend on how many numbers were drawn before it, on the
+	order of evaluation or on the number of threads.
+
+	Streams keep the different sources of noise apart, e.g. observation
+	errors in simulationModel do not shift the process errors when the
+	number of observations changes.
+
+	uniform() is in (0,1) with 53 random bits; randn() is a Box-Muller
+	standard normal from the four words of one Philox block.
+**/
+class CounterRng
+{
+private:
+	uint32_t m_key[2];
+
+public:
+	/** Stream identifiers, never reuse a number for a different purpose. */
+	enum Stream
+	{
+		PROJ_RECRUITMENT     = 1,	//!< Recruitment deviates in the projections (draw, TAC, year)
+		SIM_SELECTIVITY      = 2,	//!< Selectivity block offsets (gear, block)
+		SIM_SURVEY           = 3,	//!< Survey observation errors (survey, obs)
+		SIM_RECRUITMENT      = 4,	//!< Recruitment deviates (group, year)
+		SIM_INIT_RECRUITMENT = 5,	//!< Initial recruitment deviates (group, age)
+		SIM_CATCH            = 6,	//!< Catch observation errors (obs)
+		SIM_AGE_COMPOSITION  = 7,	//!< Age composition errors (gear, obs, age)
+		MCMC_START           = 8	//!< Starting points of the -nchains chains (chain, parameter)
+	};
+
+	CounterRng(const long& seed, const int& stream);
+
+	static void philox(uint32_t ctr[4], const uint32_t key[2]);
+
+	double uniform(const int& c0, const int& c1 = 0, const int& c2 = 0, const int& c3 = 0) const;
+	double randn(const int& c0, const int& c1 = 0, const int& c2 = 0, const int& c3 = 0) const;
+};
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef _DD_PROJECTION_H
+#define _DD_PROJECTION_H
+
+#include <vector>
+#include <iostream>
+#include <admodel.h>
+#include "projection_model.h"
+
+/** \brief  Inputs for projecting one draw of the delay difference model
+
+	bt, N, S and ft are the historical biomass, numbers, survival and
+	fishing mortality (syr..nyr), xx the recruitment deviates (already
+	scaled by tau) for nyr+1..pyr.  As for ProjectionDraw, xx is not part
+	of the saved state.
+**/
+struct DDProjectionDraw
+{
+	int     draw;	//!< mceval draw number (0 for the MPD)
+	double  so;		//!< Recruitment parameter
+	double  beta;	//!< Recruitment parameter
+	double  tau;	//!< Recruitment standard deviation
+	double  M;		//!< Natural mortality rate
+	double  rho;	//!< Ford-Walford slope
+	double  alpha;	//!< Ford-Walford intercept
+	double  wk;		//!< Weight at recruitment
+	dvector bt;		//!< Biomass syr..nyr
+	dvector N;		//!< Numbers syr..nyr
+	dvector S;		//!< Survival syr..nyr
+	dvector ft;		//!< Fishing mortality syr..nyr
+	dvector xx;		//!< Recruitment deviates nyr+1..pyr
+	double  bo;		//!< Unfished biomass
+	double  bmsy;	//!< Biomass at MSY
+	double  fmsy;	//!< Fmsy
+
+	void write(std::ostream& os) const;
+	bool read(std::istream& is, const ProjectionStateHeader& h);
+};
+
+/** \brief  Batched delay difference projections
+
+	Projects many constant-catch problems (TAC options of one draw, or
+	TAC options of many draws) with the delay difference recursions of
+	projection_model_dd:
+
+	  R(i)  = f(B(i-kage)) exp(xx(i) - 0.5 tau^2)
+	  B(i)  = S(i-1) (rho B(i-1) + alpha N(i-1)) + wk R(i)
+	  N(i)  = S(i-1) N(i-1) + R(i)
+	  F(i)  from TAC = B(i) (1-exp(-M-F)) F/(M+F)
+	  S(i)  = exp(-M-F(i))
+
+	State is stored by year with the problem index running fastest, and
+	problems are worked in blocks of BLOCK so every update is a unit stride
+	loop over problems.  The catch equation uses the Newton steps and
+	stopping rule of BaranovCatchEquation::get_ftdd (at most 50, a problem
+	stops once its catch residual is below TOL) for all problems of a block
+	at once (F = 20 when the TAC is not less than the biomass), so results
+	match the scalar version.  Blocks do not depend on each other and with
+	threaded = true they are shared out with parallel::for_each.
+
+	\sa BaranovCatchEquation::get_ftdd, projection_model_dd in iscam.tpl
+**/
+class DDProjection
+{
+private:
+	int m_nprob;	//!< Number of problems
+	int m_syr;		//!< First year of the historical arrays
+	int m_nyr;		//!< Last year of the historical arrays
+	int m_pyr;		//!< Last projection year
+	int m_kage;		//!< Age at recruitment
+	int m_srr;		//!< Stock-recruitment model 1 = Beverton-Holt, 2 = Ricker
+
+	// Inputs (problem)
+	std::vector<double> m_tac, m_so, m_beta, m_tau, m_M, m_rho, m_alpha, m_wk;
+	// By year (syr..pyr) and problem; years up to nyr hold the history.
+	std::vector<double> m_bt, m_N, m_S, m_ft;
+	std::vector<double> m_xx;	//!< Deviates (nyr+1..pyr, problem)
+	std::vector<char>   m_clip;	//!< F set to 20 because TAC >= biomass (nyr+1..pyr, problem)
+
+	int at(const int& i, const int& p) const { return (i-m_syr)*m_nprob + p-1; }
+	void runBlock(const int& p0, const int& p1);
+
+public:
+	static const int BLOCK = 64;	//!< Problems per block
+
+	DDProjection(const int& nprob, const int& syr, const int& nyr,
+	             const int& kage, const int& nproj = 2, const int& srr = 1);
+
+	void setProblem(const int& p, const DDProjectionDraw& d, const double& tac);
+	void run(const bool& threaded = false);
+
+	// Getters
+	int    getProblems() const { return m_nprob; }
+	int    getLastYear() const { return m_pyr; }
+	double getTac(const int& p) const { return m_tac[p-1]; }
+	double getBt(const int& p, const int& i) const { return m_bt[at(i,p)]; } /**< Biomass in year i (syr..pyr)*/
+	double getFt(const int& p, const int& i) const { return m_ft[at(i,p)]; } /**< Fishing mortality in year i (syr..pyr)*/
+	bool   getClipped(const int& p, const int& i) const { return m_clip[(i-m_nyr-1)*m_nprob + p-1]; } /**< TAC not less than the biomass in year i (nyr+1..pyr)*/
+};
+
+#endif
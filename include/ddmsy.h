@@ -0,0 +1,74 @@
+#ifndef _DDMSY_H
+#define _DDMSY_H
+
+#include <vector>
+
+/** \brief  MSY-based reference points for the delay difference model
+
+	Solves for Fmsy in the delay difference model (Hilborn & Walters 1992,
+	ch. 9) using the closed form equilibrium biomass and yield:
+
+	  s     = exp(-M-F)
+	  w     = (s*alpha + wk*(1-s)) / (1-rho*s)     equilibrium mean weight
+	  phi   = w / (1-s)                           biomass per recruit
+	  Be    = (a*phi - 1) / b                     Beverton-Holt
+	  Be    = log(a*phi) / b                      Ricker
+	  Ye    = Be * (1-s) * F/(F+M)
+
+	The first and second derivatives of Ye with respect to F are carried
+	through the same expressions analytically.  The maximum is bracketed on
+	a coarse grid over [0, fmax] and dYe/dF = 0 is solved with a Newton
+	step that falls back to bisection whenever the step leaves the
+	bracket (rtsafe, Numerical Recipes 9.4).
+
+	Only double types are used, so independent problems (stocks, or
+	posterior samples) can be solved concurrently with DDMsy::solve.
+
+	\sa run_FRPdd in iscam.tpl
+**/
+class DDMsy
+{
+private:
+	int     m_srr;		//!< Stock-recruitment model 1 = Beverton-Holt, 2 = Ricker
+	int     m_iter;		//!< Number of iterations used by get_fmsy
+	bool    m_FAIL;		//!< Flag for convergence
+
+	double  m_a;		//!< Recruitment parameter (so)
+	double  m_b;		//!< Recruitment parameter (beta)
+	double  m_M;		//!< Natural mortality rate
+	double  m_alpha;	//!< Ford-Walford intercept
+	double  m_rho;		//!< Ford-Walford slope
+	double  m_wk;		//!< Weight at recruitment
+
+	double  m_fmsy;
+	double  m_msy;
+	double  m_bmsy;
+
+	double  m_ye;		//!< Equilibrium yield
+	double  m_be;		//!< Equilibrium biomass
+	double  m_dye;		//!< dYe/dF
+	double  m_d2ye;		//!< d2Ye/dF2
+
+public:
+	DDMsy(const double& a, const double& b, const double& m,
+	      const double& alpha, const double& rho, const double& wk,
+	      const int& srr = 1);
+
+	void   calcEquilibrium(const double& fe);
+	double get_fmsy(const double& finit = 0.1, const double& fmax = 1.0);
+
+	static void solve(std::vector<DDMsy>& problems);
+
+	// Getters
+	bool    getFail() const { return m_FAIL; }  /**< Flag for convergence */
+	int getIterations() const { return m_iter; } /**< Iterations used by get_fmsy */
+	double  getFmsy() const { return m_fmsy; }  /**< Return fishing mortality rate at MSY*/
+	double   getMsy() const { return m_msy;  }  /**< Return maximum sustainable yield*/
+	double  getBmsy() const { return m_bmsy; }  /**< Return biomass at MSY*/
+	double    getYe() const { return m_ye;   }  /**< Return equilibrium yield*/
+	double    getBe() const { return m_be;   }  /**< Return equilibrium biomass*/
+	double   getdYe() const { return m_dye;  }  /**< Return dYe/dF*/
+	double  getd2Ye() const { return m_d2ye; }  /**< Return d2Ye/dF2*/
+};
+
+#endif
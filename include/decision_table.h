@@ -0,0 +1,84 @@
+#ifndef _DECISION_TABLE_H
+#define _DECISION_TABLE_H
+
+#include <vector>
+#include <admodel.h>
+
+/** \brief  Streaming quantile estimate (P-square algorithm)
+
+	Estimates one quantile of a stream of values without storing them,
+	using the five marker piecewise-parabolic method of Jain and Chlamtac
+	(1985, Comm. ACM 28:1076-1085).  The first five values are kept and
+	the estimate is exact (linear interpolation) until then.
+**/
+class P2Quantile
+{
+private:
+	double m_p;			//!< Probability of the quantile
+	int    m_count;		//!< Number of values added
+	double m_q[5];		//!< Marker heights
+	double m_n[5];		//!< Marker positions
+	double m_np[5];		//!< Desired marker positions
+	double m_dn[5];		//!< Increments of the desired positions
+
+	double parabolic(const int& i, const double& d) const;
+	double linear(const int& i, const int& d) const;
+
+public:
+	P2Quantile(const double& p = 0.5);
+
+	void   add(const double& x);
+	double getQuantile() const;
+	int    getCount() const { return m_count; }
+};
+
+
+/** \brief  Decision table accumulated one draw at a time
+
+	Keeps, for every TAC option, the probability indicators and posterior
+	quantiles that are otherwise computed in R from the per-draw rows of
+	iscammcmc_proj_Gear1.csv.  add() takes the same projection of a draw
+	as write_proj_output and write() produces the finished table, one row
+	per TAC.  With B1 = B(nyr+1), B2 = B(nyr+2), F0 = F(nyr) and
+	F1 = F(nyr+1) the probabilities are
+
+	  P(B2 < B1), P(B2 < 0.4 Bo), P(B2 < 0.2 Bo), P(B2 < B(syr)), P(F1 > F0)
+	  and, with MSY reference points,
+	  P(B2 < Bmsy), P(B2 < 0.8 Bmsy), P(B2 < 0.4 Bmsy), P(F1 > Fmsy).
+
+	Quantiles (2.5%, 50%, 97.5%) of B2, B2/Bo and F1 use P2Quantile, so
+	memory does not grow with the number of draws.
+
+	\sa write_proj_output
+**/
+class DecisionTable
+{
+private:
+	int     m_syr;
+	int     m_nyr;
+	bool    m_msy;		//!< Include MSY based indicators
+	dvector m_tac;		//!< TAC options
+
+	std::vector<int>    m_count;	//!< Draws added (tac)
+	std::vector<int>    m_hits;		//!< Indicator counts (tac, indicator)
+	std::vector<P2Quantile> m_quant;	//!< Quantile estimates (tac, variable, probability)
+
+	int nIndicators() const { return m_msy ? 9 : 5; }
+
+public:
+	static const int NVAR  = 3;	//!< B2, B2/Bo and F1
+	static const int NPROB = 3;	//!< 2.5%, 50% and 97.5%
+
+	DecisionTable() : m_syr(0), m_nyr(0), m_msy(false) {}
+
+	void allocate(const dvector& tac, const int& syr, const int& nyr, const bool& include_msy);
+	bool allocated() const { return !m_count.empty(); }
+
+	void add(const int& t, const dvector& p_sbt, const dmatrix& p_ft,
+	         const double& ftnyr, const double& bo, const double& fmsy, const double& bmsy);
+	void write(ostream& ofs) const;
+
+	int  getCount(const int& t) const { return m_count[t-1]; }
+};
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef _DRAW_MEMO_H
+#define _DRAW_MEMO_H
+
+#include <stdint.h>
+#include <vector>
+#include <admodel.h>
+
+/** \brief  Detects an mceval draw that repeats the previous one (-memo)
+
+	A Metropolis chain keeps its state for every rejected proposal, so the
+	psv file has runs of identical parameter vectors.  repeat() hashes the
+	parameter vector of a draw and compares it with the previous draw (the
+	hash first, then the values bit for bit), so that the output of the
+	previous draw can be written again instead of evaluating the model.
+**/
+class DrawMemo
+{
+private:
+	std::vector<double> m_last;
+	uint64_t  m_hash;
+	long long m_draws;
+	long long m_repeats;
+
+public:
+	DrawMemo();
+
+	static uint64_t hash(const double* x, const size_t& n);
+
+	bool repeat(const dvector& x);
+
+	long long getDraws() const { return m_draws; }
+	long long getRepeats() const { return m_repeats; }
+};
+
+#endif
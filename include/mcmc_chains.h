@@ -0,0 +1,32 @@
+#ifndef _MCMC_CHAINS_H
+#define _MCMC_CHAINS_H
+
+#include <string>
+#include <vector>
+
+/** \brief  Estimates, standard deviations and correlations from an ADMB .cor file
+
+	The first nvar rows of the .cor file are the active parameters, in the
+	order of the .psv file and of initial_params::copy_all_values; the
+	sdreport variables after them are not read.  Used for the starting
+	points of the -nchains chains.
+**/
+struct ParameterCorrelations
+{
+	std::vector<std::string> names;
+	std::vector<double> value;
+	std::vector<double> sd;
+	std::vector<double> cor;	//!< nvar x nvar, row-major
+
+	bool read(const std::string& filename, const int& nvar);
+	std::vector<std::string> columnNames() const;
+};
+
+
+bool cholesky(std::vector<double>& a, const int& n);
+
+bool merge_chains(const std::vector<std::string>& psvfiles, const std::vector<int>& chains,
+                  const std::vector<std::string>& names,
+                  const std::string& psvfile, const std::string& csvfile);
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef _MCMC_MONITOR_H
+#define _MCMC_MONITOR_H
+
+#include <iostream>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/** \brief  Values computed for recently evaluated parameter vectors
+
+	Keyed by the parameter vector (DrawMemo::hash, then compared value by
+	value).  Holds the last maxSize vectors (the evaluations between two
+	reads of the chain, with some margin); get() makes a vector the most
+	recent again, so the state of a chain that keeps rejecting proposals is
+	not dropped while it is read.
+**/
+class DrawCache
+{
+private:
+	struct Entry
+	{
+		uint64_t hash;
+		std::vector<double> x;
+		std::vector<double> values;
+	};
+	std::list<Entry> m_entries;		//!< Oldest first
+	std::multimap<uint64_t, std::list<Entry>::iterator> m_index;
+
+	size_t m_maxSize;
+
+	std::list<Entry>::iterator find(const uint64_t& h, const double* x, const size_t& n);
+
+public:
+	explicit DrawCache(const size_t& maxSize);
+
+	void put(const double* x, const size_t& n, const std::vector<double>& values);
+	const std::vector<double>* get(const double* x, const size_t& n);
+};
+
+
+/** \brief  Split-R-hat and effective sample size of a growing chain
+
+	The draws of one chain are added as they are saved; update() splits the
+	chain in two halves and computes, for each column, the split-R-hat and
+	the effective sample size of Vehtari et al. (2021, Rank-normalization,
+	folding and localization: an improved R-hat, Bayesian Analysis 16),
+	without the rank normalization, with Geyer's initial monotone sequence
+	as in Stan.  Constant columns (fixed parameters) are skipped.
+
+	So that a long run does not cost O(n^2), at most MAXBATCH values are
+	kept per column: batch means of a batch size that doubles (adjacent
+	batches are averaged) whenever the store is full.  Up to MAXBATCH
+	draws the diagnostics are those of the draws themselves; after that
+	they are computed from the batch means, the effective sample size
+	scaled back to draws with the variance of the draws (running sums).
+	The R-hat of batch means is slightly larger (by a factor of about
+	1 + 1/MAXBATCH for independent draws).  update() is then O(MAXBATCH)
+	per column and lag, whatever the length of the chain.
+
+	The status is CONVERGED when every R-hat is below RHAT_OK and every
+	effective sample size at least ESS_OK, FAILING when an R-hat is still
+	above RHAT_FAIL after MIN_FAIL draws, WAITING with fewer than MIN_DRAWS
+	draws, and RUNNING otherwise.
+**/
+class ConvergenceMonitor
+{
+public:
+	enum Status { WAITING, RUNNING, CONVERGED, FAILING };
+
+	static const int MIN_DRAWS = 20;
+	static const int MIN_FAIL  = 1000;
+	static const size_t MAXBATCH = 2048;
+	static const double RHAT_OK;
+	static const double RHAT_FAIL;
+	static const double ESS_OK;
+
+private:
+	std::vector<std::string> m_names;
+	std::vector< std::vector<double> > m_draws;	//!< Batch means, one vector per column
+	std::vector<double> m_sum;		//!< Sums of the batch being filled
+	std::vector<double> m_mean;		//!< Means of all draws
+	std::vector<double> m_ss;		//!< Sums of squared deviations from m_mean
+	long long m_count;				//!< Draws added
+	long long m_batch;				//!< Draws per batch
+	long long m_fill;				//!< Draws in the batch being filled
+	std::vector<double> m_rhat;
+	std::vector<double> m_ess;
+	Status m_status;
+
+public:
+	ConvergenceMonitor();
+
+	void allocate(const std::vector<std::string>& names);
+	bool allocated() const { return !m_names.empty(); }
+	void add(const std::vector<double>& values);
+	Status update();
+	void write(std::ostream& os) const;
+
+	long long getCount() const { return m_count; }
+	Status getStatus() const { return m_status; }
+	static const char* statusName(const Status& s);
+
+	static double splitRhat(const std::vector<double>& x);
+	static double splitEss(const std::vector<double>& x);
+	static double splitVarPlus(const std::vector<double>& x);
+};
+
+#endif
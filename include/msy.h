@@ -34,6 +34,7 @@
 	\sa
 **/
 #include <admodel.h>
+#include "msy_workspace.hpp"
 
 class Msy
 {
@@ -79,6 +80,11 @@ private:
 	dvector m_g;	// gradient
 	dvector m_p;	// Newton-Raphson step for iteratively solving for Fmsy
 	
+	//!< Work arrays for calcEquilibrium, sized once in the constructor.
+	rfp::msyWorkspace<double,dvector,dmatrix,d3_array> m_ws;
+	
+	void allocateWorkspace();
+	
 	
 public:
 	
@@ -14,6 +14,7 @@
 #endif
 
 #include <admodel.h>
+#include "msy_workspace.hpp"
 
 namespace rfp {
 	/**
@@ -82,6 +83,8 @@ namespace rfp {
 		T m_dYe;		/// Derivative of total yield.
 		T m_d2Ye;		/// Second derivative of total yield.
 		T m_fbar_stp;	/// Newton step for average F.
+		T m_tol;		/// Convergence tolerance on the Newton step (0 = MAXITER steps).
+		int m_iter;		/// Number of Newton iterations used by the last solve.
 
 		T1 m_fe;		/// Fishing mortality rate
 		T1 m_fmsy;      /// Fishing mortality rate at MSY
@@ -103,6 +106,8 @@ namespace rfp {
 
 		T3 m_Va;		/// Selectivity-at-age.
 
+		msyWorkspace<T,T1,T2,T3> m_ws;	/// Work arrays for calcEquilibrium.
+
 		void calcPhie();
 		void calcEquilibrium(const T1 &fe);
 		
@@ -117,7 +122,7 @@ namespace rfp {
 		    const T2 wa ,
 		    const T2 fa ,
 		    const T3 V )
-		:m_ro(ro),m_h(h),m_rho(rho),m_Ma(ma),m_Wa(wa),m_Fa(fa),m_Va(V) 
+		:m_ro(ro),m_h(h),m_rho(rho),m_tol(0.0),m_iter(0),m_Ma(ma),m_Wa(wa),m_Fa(fa),m_Va(V) 
 		{
 			//m_Va.allocate(*V);
 			//m_Va = *V;
@@ -135,6 +140,15 @@ namespace rfp {
 			m_sage = m_Ma.colmin();
 			m_nage = m_Ma.colmax();
 
+			m_ws.allocate(m_nGrp,m_nGear,m_sage,m_nage);
+			m_lz.allocate(1,m_nGrp,m_sage,m_nage);
+			m_phiq.allocate(1,m_nGear);
+			m_dphiq.allocate(1,m_nGear);
+			m_dre.allocate(1,m_nGear);
+			m_fstp.allocate(1,m_nGear);
+			m_ye.allocate(1,m_nGear);
+			m_dye.allocate(1,m_nGear);
+
 			calcPhie();
 
 			//LOG<<"In constructor\n"<<m_phie<<'\n';
@@ -150,6 +164,10 @@ namespace rfp {
 		virtual const T1 getMsy()  {return m_msy; }
 		virtual const T1 getAllocation() {return m_allocation; }
 		//virtual const T1 getdYe()  {return m_dYe; }
+		int getIterations() const {return m_iter;}
+
+		/// Stop the Newton iterations once the step is smaller than tol.
+		void setTolerance(const T tol) {m_tol = tol;}
 		
 		void print();
 		void checkDerivatives(const T1 & fe);
@@ -271,7 +289,7 @@ namespace rfp {
 		m_fe = fe;
 		m_ak = ak;
 
-		for(int iter = 1; iter <= MAXITER; iter++ )
+		for(m_iter = 1; m_iter <= MAXITER; m_iter++ )
 		{
 			fk = fbar;
 			calcEquilibrium(fk);
@@ -292,7 +310,9 @@ namespace rfp {
 				fbar += 0.98 * m_fbar_stp;
 			}
 
+			if( m_tol > 0.0 && fabs(m_fbar_stp) < m_tol ) break;
 		}
+		if( m_iter > MAXITER ) m_iter = MAXITER;	// no early exit: all steps ran
 		m_fe = fk;
 		m_rmsy = m_re; 
 		m_fmsy = m_fe;
@@ -324,7 +344,7 @@ namespace rfp {
 		T1 ftry = fe;
 		m_ak.deallocate();
 		m_fe = fe;
-		for(int iter=1; iter<=MAXITER; iter++)
+		for(m_iter=1; m_iter<=MAXITER; m_iter++)
 		{
 			calcEquilibrium(m_fe);
 			m_fe = m_fe +  m_fstp;
@@ -341,8 +361,9 @@ namespace rfp {
 			}
 			//LOG<<iter<<" delta = "<<delta<<" fmsy = "<<m_fe<<'\n';
 			
-			
+			if( m_tol > 0.0 && norm2(m_fstp) < m_tol*m_tol ) break;
 		}
+		if( m_iter > MAXITER ) m_iter = MAXITER;	// no early exit: all steps ran
 		m_msy = m_ye;
 		m_allocation = m_msy/sum(m_msy);
 		m_bmsy = m_be;
@@ -350,202 +371,158 @@ namespace rfp {
 		return(m_fe);	
 	}
 
+	/**
+	 * @brief Equilibrium yield and derivatives for a vector of fishing rates.
+	 * @details Computes survivorship, per-recruit yield, equilibrium recruits,
+	 * yield and spawning biomass, and the Newton step m_fstp that maximizes
+	 * the total yield.  All temporaries live in the workspace m_ws that is
+	 * sized in the constructor, and the Newton system is solved by Gaussian
+	 * elimination rather than an explicit inverse, so this routine does not
+	 * allocate memory.
+	 * 
+	 * @param fe vector of fishing mortality rates for each gear.
+	 */
 	template<class T, class T1, class T2, class T3>
 	void msy<T,T1,T2,T3>::calcEquilibrium(const T1 &fe)
 	{
-		//LOG<<"Working on this routine"<<'\n';
 		int j,h,k,kk;
 		T phif = 0.0;
 		
+		T1 &phiq   = m_ws.phiq;
+		T1 &dphif  = m_ws.dphif;
+		T1 &d2phif = m_ws.d2phif;
+		T1 &dre    = m_ws.dre;
+		T1 &d2re   = m_ws.d2re;
+		T1 &ye     = m_ws.ye;
+		T1 &dye    = m_ws.dye;
+		T2 &dphiq  = m_ws.dphiq;
+		T2 &d2phiq = m_ws.d2phiq;
+		T2 &d2ye   = m_ws.d2ye;
 
-		T1 pza(m_sage,m_nage);
-		T1 psa(m_sage,m_nage);
-		T1 poa(m_sage,m_nage);
-		T2  za(1,m_nGrp,m_sage,m_nage);
-		T2  sa(1,m_nGrp,m_sage,m_nage);
-		T2  oa(1,m_nGrp,m_sage,m_nage);
-		T2  lz(1,m_nGrp,m_sage,m_nage);
-		T2  lw(1,m_nGrp,m_sage,m_nage);
-
-		T2   qa(1,m_nGear,m_sage,m_nage);
-		T2  dlz(1,m_nGear,m_sage,m_nage);
-		T2 d2lz(1,m_nGear,m_sage,m_nage);
-		T2  dlw(1,m_nGear,m_sage,m_nage);
-		T2 d2lw(1,m_nGear,m_sage,m_nage);
-		dlz.initialize();
-		dlw.initialize();
-		d2lz.initialize();
-		d2lw.initialize();
-
-		T3   qa_m(1,m_nGrp,1,m_nGear,m_sage,m_nage);
-		T3  dlz_m(1,m_nGrp,1,m_nGear,m_sage,m_nage);
-		T3 d2lz_m(1,m_nGrp,1,m_nGear,m_sage,m_nage);
-		T3  dlw_m(1,m_nGrp,1,m_nGear,m_sage,m_nage);
-		T3 d2lw_m(1,m_nGrp,1,m_nGear,m_sage,m_nage);
-
-		//LOG<<m_Va<<'\n';
 		for( h = 1; h <= m_nGrp; h++ )
 		{
-			za(h) = m_Ma(h);
-			for( k = 1; k <= m_nGear; k++ )
-			{
-				za(h) = za(h) + fe(k) * m_Va(h)(k);
-				//LOG<<h<<" "<<k<<'\n';
-			}
-			sa(h) = exp(-za(h));
-			oa(h) = 1.0 - sa(h);
-			pza   = m_rho*za(h);
-			psa   = exp(-pza);
-			poa   = 1.0 - elem_prod(sa(h),psa);
-			for(k=1;k<=m_nGear;k++)
+			T1 &za   = m_ws.za(h);
+			T1 &sa   = m_ws.sa(h);
+			T1 &oa   = m_ws.oa(h);
+			T1 &lz   = m_ws.lz(h);
+			T2 &qa   = m_ws.qa(h);
+			T2 &dlz  = m_ws.dlz(h);
+			T2 &d2lz = m_ws.d2lz(h);
+
+			for( j = m_sage; j <= m_nage; j++ )
 			{
-				qa(k)      = elem_div(elem_prod(elem_prod(m_Va(h)(k),m_Wa(h)),oa(h)),za(h));
-				qa_m(h)(k) = qa(k);
-
-				dlw(k,m_sage)      = -psa(m_sage)*m_rho*m_Va(h)(k)(m_sage);
-				dlw_m(h,k,m_sage)  = dlw(k,m_sage);
-				d2lw(k,m_sage)     = psa(m_sage)*square(m_rho)*square(m_Va(h)(k)(m_sage));
-				d2lw_m(h,k,m_sage) = d2lw(k,m_sage);
-
-				dlz(k,m_sage)      = 0;
-				dlz_m(h,k,m_sage)  = 0;
-				d2lz(k,m_sage)     = 0;
-				d2lz_m(h,k,m_sage) = 0;
+				za(j) = m_Ma(h,j);
+				for( k = 1; k <= m_nGear; k++ )
+				{
+					za(j) += fe(k) * m_Va(h,k,j);
+				}
+				sa(j) = exp(-za(j));
+				oa(j) = 1.0 - sa(j);
+				for( k = 1; k <= m_nGear; k++ )
+				{
+					qa(k,j) = m_Va(h,k,j) * m_Wa(h,j) * oa(j) / za(j);
+				}
 			}
 
 			// Survivorship
-			lz(h)(m_sage) = 1.0/m_nGrp;
-			lw(h)(m_sage) = 1.0/m_nGrp * psa(m_sage);
+			lz(m_sage) = 1.0/m_nGrp;
+			for( k = 1; k <= m_nGear; k++ )
+			{
+				dlz(k,m_sage)  = 0;
+				d2lz(k,m_sage) = 0;
+			}
 			for( j = m_sage+1; j <= m_nage; j++ )
 			{
-				lz(h,j) = lz(h,j-1) * sa(h,j-1);
-				lw(h,j) = lw(h,j-1) * psa(j);
+				lz(j) = lz(j-1) * sa(j-1);
 				if( j == m_nage )
 				{
-					lz(h,j) = lz(h,j)/oa(h,j);
-					lw(h,j) = lz(h,j-1)*sa(h,j-1)*psa(j)/oa(h,j);
+					lz(j) = lz(j)/oa(j);
 				}
 
 				for( k = 1; k <= m_nGear; k++ )
 				{
 					// derivatives for survivorship
-					dlz(k)(j)  = sa(h)(j-1)*( dlz(k)(j-1)-lz(h)(j-1)*m_Va(h)(k)(j-1));
-					d2lz(k)(j) = sa(h)(j-1)*(d2lz(k)(j-1)+lz(h)(j-1)*square(m_Va(h)(k)(j-1)));
-					
-					// derivatives for spawning survivorship
-					dlw(k)(j)  = -lz(h)(j)*m_rho*m_Va(h)(k)(j)*psa(j); 
-					d2lw(k)(j) =  lz(h)(j)*square(m_rho)*square(m_Va(h)(k)(j))*psa(j);
+					T V1 = m_Va(h,k,j-1);
+					dlz(k,j)  = sa(j-1)*( dlz(k,j-1)-lz(j-1)*V1);
+					d2lz(k,j) = sa(j-1)*(d2lz(k,j-1)+lz(j-1)*V1*V1);
 
 					if( j == m_nage ) // + group derivatives
 					{
-						dlz(k)(j)  = dlz(k)(j)/oa(h)(j) 
-						             - lz(h)(j-1)*sa(h)(j-1)*m_Va(h)(k)(j)*sa(h)(j)
-						             /square(oa(h)(j));
-						
-						dlw(k)(j)  = -lz(h)(j-1)*sa(h)(j-1)*m_rho*m_Va(h)(k)(j)/oa(h)(j)
-									- lz(h)(j-1)*psa(j)*m_Va(h)(k)(j)*sa(h)(j)
-									/square(oa(h)(j));
-						
-						T V1  	   = m_Va(h)(k)(j-1);
-						T V2  	   = m_Va(h)(k)(j);
-						T oa2 	   = oa(h)(j)*oa(h)(j);
-						
-						d2lz(k)(j) = d2lz(k)(j-1)*sa(h)(j-1)/oa(h)(j) 
-									+ 2*lz(h)(j-1)*V1*sa(h)(j-1)*V2*sa(h)(j)/oa2
-									+ 2*lz(h)(j-1)*sa(h)(j-1)*V2*V2*sa(h)(j)*sa(h)(j)
-									/(oa(h)(j)*oa2)
-									+ lz(h)(j-1)*sa(h)(j-1)*V2*V2*sa(h)(j)/oa2;
+						T V2  = m_Va(h,k,j);
+						T oa2 = oa(j)*oa(j);
+
+						dlz(k,j)  = dlz(k,j)/oa(j) 
+						            - lz(j-1)*sa(j-1)*V2*sa(j)/oa2;
 						
-						d2lw(k)(j) = lz(h)(j-1)*square(m_rho)*square(V2)*psa(j)/oa(h)(j)
-									+ 2*lz(h)(j-1)*m_rho*square(V2)*psa(j)*sa(h)(j)/oa2
-									+ 2*lz(h)(j-1)*psa(j)*square(V2)*square(sa(h)(j))
-									/(oa(h)(j)*oa2)
-									+ lz(h)(j-1)*psa(j)*square(V2)*sa(h)(j)/oa2;
+						d2lz(k,j) = d2lz(k,j-1)*sa(j-1)/oa(j) 
+						            + 2*lz(j-1)*V1*sa(j-1)*V2*sa(j)/oa2
+						            + 2*lz(j-1)*sa(j-1)*V2*V2*sa(j)*sa(j)
+						            /(oa(j)*oa2)
+						            + lz(j-1)*sa(j-1)*V2*V2*sa(j)/oa2;
 					}
-					dlz_m(h,k,j)  =  dlz(k)(j);
-					d2lz_m(h,k,j) = d2lz(k)(j);
-					dlw_m(h,k,j)  =  dlw(k)(j);
-					d2lw_m(h,k,j) = d2lw(k)(j);
 				} // m_nGear
 			} // m_nage
 
 			// Spawning biomass per recruit in fished conditions.
-			phif += lz(h) * m_Fa(h);
-			// phif += lw(h) * m_Fa(h);
-
+			for( j = m_sage; j <= m_nage; j++ )
+			{
+				phif += lz(j) * m_Fa(h,j);
+			}
 		} // m_nGrp
 		m_phif  = phif;
-		m_lz    = lz;
+		m_lz    = m_ws.lz;
 
 		// Incidence functions and associated derivatives
-		T1   dphif(1,m_nGear);   dphif.initialize();
-		T1  d2phif(1,m_nGear);  d2phif.initialize();
-		T1    phiq(1,m_nGear);    phiq.initialize();
-		
-		
-		T1     dre(1,m_nGear);     dre.initialize();
-		T1    d2re(1,m_nGear);    d2re.initialize();
-		// T1      t1(m_sage,m_nage);  t1.initialize();
-		T1      tj(m_sage,m_nage);  tj.initialize();
-
-		T2   dphiq(1,m_nGear,1,m_nGear);   dphiq.initialize();
-		T2  d2phiq(1,m_nGear,1,m_nGear);  d2phiq.initialize();
-
+		dphif.initialize();
+		d2phif.initialize();
+		phiq.initialize();
+		dphiq.initialize();
+		d2phiq.initialize();
 		for( h = 1; h <= m_nGrp; h++ )
 		{
+			T1 &za   = m_ws.za(h);
+			T1 &sa   = m_ws.sa(h);
+			T1 &oa   = m_ws.oa(h);
+			T1 &lz   = m_ws.lz(h);
+			T2 &qa   = m_ws.qa(h);
+			T2 &dlz  = m_ws.dlz(h);
+			T2 &d2lz = m_ws.d2lz(h);
+
 			for( k = 1; k <= m_nGear; k++ )
 			{
-				dphif(k)  += dlz_m(h)(k)  * m_Fa(h);
-				d2phif(k) += d2lz_m(h)(k) * m_Fa(h);
-				// dphif(k)   += dlw_m(h)(k)  * m_Fa(h);
-				// d2phif(k)  += d2lw_m(h)(k) * m_Fa(h);
-
-				// per recruit yield
-				phiq(k)   +=  lz(h) * qa_m(h)(k);
+				for( j = m_sage; j <= m_nage; j++ )
+				{
+					dphif(k)  += dlz(k,j)  * m_Fa(h,j);
+					d2phif(k) += d2lz(k,j) * m_Fa(h,j);
+					
+					// per recruit yield
+					phiq(k)   += lz(j) * qa(k,j);
+				}
 
 				for( kk = 1; kk <= m_nGear; kk++ )
-				{	
-					/*				
-					// changed back to ngear==1 to be consistent with spreadsheet.
-					if(m_nGear==1)  // was (if ngear==1), changed during debugging of nfleet>1
+				{
+					// dphiq = wa*oa*va*dlz/za + lz*wa*va*sa/za - lz*wa*va*oa/za^2
+					// d2phiq (nasty), see the vector form in msy.cpp.
+					for( j = m_sage; j <= m_nage; j++ )
 					{
-						// dphiq = wa*oa*va*dlz/za + lz*wa*va^2*sa/za - lz*wa*va^2*oa/za^2
-						t1 = elem_div(elem_prod(elem_prod(lz(h),m_Wa(h)),square(m_Va(h)(k))),za(h));
+						T Vk  = m_Va(h,k,j);
+						T Vkk = m_Va(h,kk,j);
+						T t0  = oa(j)/za(j);
+						T t5  = m_Wa(h,j)*Vk*Vkk/za(j);
+						T t13 = lz(j)*t5;
+
+						dphiq(k,kk)  += qa(k,j)*dlz(kk,j) + t13*(sa(j)-t0);
+
+						d2phiq(k,kk) += d2lz(kk,j)*qa(k,j)
+						              + 2.*dlz(kk,j)*t5*sa(j)
+						              - 2.*dlz(kk,j)*t5*t0
+						              - t13*Vkk*sa(j)
+						              - 2.*t13*Vkk*sa(j)/za(j)
+						              + 2.*t13*Vkk*t0/za(j);
 					}
-					else
-					{
-						// dphiq = wa*oa*va*dlz/za + lz*wa*va*sa/za - lz*wa*va*oa/za^2
-						t1 = elem_div(elem_prod(elem_prod(lz(h),m_Wa(h)),m_Va(h)(k)),za(h));
-
-						// djphiq = wa*oa*va(i)/dlz/za + lz*wa*va(i)*va(j)*sa/za - lz*wa*va(i)*va(j)*oa/za^2
-					}*/
-					// dphiq = wa*oa*va*dlz/za + lz*wa*va*sa/za - lz*wa*va*oa/za^2
-					T1 va2 = elem_prod(m_Va(h)(k),m_Va(h)(kk));
-					T1 t0  = elem_div(oa(h),za(h));
-					T1 t1  = elem_div(elem_prod(elem_prod(lz(h),m_Wa(h)),va2),za(h));
-					T1 t3  = sa(h)-t0;
-					dphiq(k)(kk)  += qa_m(h)(k)*dlz_m(h)(kk) + t1 * t3;
-
-					// 2nd derivative for per recruit yield (nasty)
-					T1 t2  = 2. * dlz_m(h)(kk);
-					T1 V2  = elem_prod(m_Va(h)(k),m_Va(h)(kk));
-					T1 t5  = elem_div(elem_prod(m_Wa(h),V2),za(h));
-					T1 t7  = elem_div(m_Va(h)(kk),za(h));
-					T1 t9  = elem_prod(t5,sa(h));
-					T1 t11 = elem_prod(t5,t0);
-					T1 t13 = elem_prod(lz(h),t5);
-					T1 t14 = elem_prod(m_Va(h)(kk),sa(h));
-					T1 t15 = elem_prod(t7,sa(h));
-					T1 t17 = elem_prod(m_Va(h)(kk),t0);
-					T1 t18 = elem_div(t17,za(h));
-					d2phiq(k)(kk)  += d2lz_m(h)(kk)*qa_m(h)(k) 
-								+ t2*t9 - t2*t11 - t13*t14 -2.*t13*t15 
-								+ 2.*t13*t18;
 				} // m_nGear kk loop
 			} // m_nGear k loop
 		} // m_nGrp
-		m_phiq  = phiq;
-		m_dphiq = diagonal(dphiq);
 		
 
 		// 1st & 2nd partial derivatives for recruitment
@@ -558,28 +535,20 @@ namespace rfp {
 			d2re(k)     = -2.*m_ro*m_phie*dphif(k)*dphif(k)/(phif2*phif*km1) 
 						+ m_ro*m_phie*d2phif(k)/(phif2*km1);		
 		}	
-		m_dre = dre;
-
-		// Equilibrium calculations
-		T    re;
-		T    be;
-		T1    ye(1,m_nGear);
-		T1  fstp(1,m_nGear);
-		T1   dye(1,m_nGear);
-		T2 d2ye(1,m_nGear,1,m_nGear);
-		T2 invJ(1,m_nGear,1,m_nGear);
 
 		// Equilibrium recruits, yield and first derivative of ye
+		T re;
+		T be;
 		re   = m_ro*(kappa-m_phie/phif) / km1;
 		re<0?re=0.01:re=re;
-		ye   = re*elem_prod(fe,phiq);
 		be   = re * phif;
-		dye  = re*phiq 
-			  + elem_prod(elem_prod(fe,phiq),dre) 
-			  + re*elem_prod(fe,diagonal(dphiq));
-			  
-
-		// LOG<<"dye "<<dye<<'\n';
+		for( k = 1; k <= m_nGear; k++ )
+		{
+			ye(k)  = re*fe(k)*phiq(k);
+			dye(k) = re*phiq(k) 
+			       + fe(k)*phiq(k)*dre(k) 
+			       + re*fe(k)*dphiq(k,k);
+		}
 
 		// Jacobian matrix (2nd derivative of the catch equations)
 		for(j=1; j<=m_nGear; j++)
@@ -596,70 +565,74 @@ namespace rfp {
 			} 
 		}
 
-		// Inverse of the Jacobi
-		invJ = -inv(d2ye);
-		fstp = dye * invJ;
+		// Newton step: fstp = dye * -inv(d2ye), i.e., solve trans(d2ye) x = dye
+		T trace = 0;
+		for(j=1; j<=m_nGear; j++)
+		{
+			trace += d2ye(j,j);
+			for(k=1; k<=m_nGear; k++)
+			{
+				m_ws.A(j,k) = d2ye(k,j);
+			}
+		}
+		const T1 &x = m_ws.solve(dye);
+
 		// Set private member variables
-		m_fstp = fstp;
-		m_ye   = ye;
+		T dYe = 0;
+		for( k = 1; k <= m_nGear; k++ )
+		{
+			m_fstp(k)  = -x(k);
+			m_ye(k)    = ye(k);
+			m_dye(k)   = dye(k);
+			m_phiq(k)  = phiq(k);
+			m_dphiq(k) = dphiq(k,k);
+			m_dre(k)   = dre(k);
+			dYe       += dye(k);
+		}
 		m_be   = be;
 		m_re   = re;
 		m_rmsy = m_re;
-		m_dye  = dye;
-		m_dYe  = sum(dye);
-		m_d2Ye = sum(diagonal(d2ye));
+		m_dYe  = dYe;
+		m_d2Ye = trace;
 		m_spr  = m_phif/m_phie;
 
 		// Derivative based on fixed allocations
 		// dye_ak = ak*dre*∑(fk*phik) + ak*re*(∑phik + Fi*dphi[i]/dFi + Fj*dphi[j]/dFi)
-		T1 dye_ak(1,m_nGear);
-		T2 d2ye_ak(1,m_nGear,1,m_nGear);
+		// Only the diagonal of the 2nd derivative is required for the step.
 		if(allocated(m_ak)) 
 		{	
-			//LOG<<"Allocated"<<'\n';
+			T fphiq  = 0;
+			T sphiq  = 0;
+			T tdphiq = 0;
 			for( k = 1; k <= m_nGear; k++ )
 			{
+				fphiq  += fe(k)*phiq(k);
+				sphiq  += phiq(k);
+				tdphiq += dphiq(k,k);
+			}
 
-				dye_ak(k) = m_ak(k)*dre(k)*(fe*phiq)
-				          + m_ak(k)*re * (sum(phiq) + fe*dphiq(k));
-
-				          // The above may also be fe*column(dphiq,k)?? 
-				// Now the second derivative
+			T sdye  = 0;
+			T sd2ye = 0;
+			for( k = 1; k <= m_nGear; k++ )
+			{
+				T fdphiq  = 0;
+				T fd2phiq = 0;
 				for( kk = 1; kk <= m_nGear; kk++ )
 				{
-					d2ye_ak(k)(kk) = m_ak(k)*d2re(kk)*(fe*phiq)
-					               + 2.0*m_ak(k)*dre(kk)*( sum(phiq)+fe*dphiq(kk) ) 
-					               + m_ak(k)*re*( 2.0*sum(diagonal(dphiq))+fe*d2phiq(kk) );
+					fdphiq  += fe(kk)*dphiq(k,kk);
+					fd2phiq += fe(kk)*d2phiq(k,kk);
 				}
-
-			}	
-			m_fbar_stp = sum(dye_ak)/sum(diagonal(d2ye_ak));
-			m_dye      = dye_ak;
-			m_dYe      = sum(dye_ak);
-			m_d2Ye     = sum(diagonal(d2ye_ak));
-			// LOG<<sum(dye_ak)/sum(diagonal(d2ye_ak))<<'\n';
+				m_dye(k) = m_ak(k)*dre(k)*fphiq
+				         + m_ak(k)*re * (sphiq + fdphiq);
+				sdye    += m_dye(k);
+				sd2ye   += m_ak(k)*d2re(k)*fphiq
+				         + 2.0*m_ak(k)*dre(k)*( sphiq+fdphiq ) 
+				         + m_ak(k)*re*( 2.0*tdphiq+fd2phiq );
+			}
+			m_fbar_stp = sdye/sd2ye;
+			m_dYe      = sdye;
+			m_d2Ye     = sd2ye;
 		}
-
-		// Uncomment for debugging.
-		// LOG<<setprecision(8)<<'\n';
-		// LOG<<"Re     = "<<re<<'\n';
-		// LOG<<"phie   = "<<m_phie<<'\n';
-		// LOG<<"phif   = "<<m_phif<<'\n';
-		// LOG<<"fe     = "<<fe<<'\n';
-		// LOG<<"dphif  = "<<dphif<<'\n';
-		// LOG<<"ddphif = "<<d2phif<<'\n';  	// minor diff  FIXED
-		// LOG<<"ye     = "<<ye<<'\n';
-		// LOG<<"phiq   = "<<phiq<<'\n';
-		// LOG<<"dphiq  = "<<dphiq<<'\n';   	// Bug: FIXED for ngear > 1
-		// LOG<<"d2phiq = "<<d2phiq<<'\n';  	// OK
-		// LOG<<"dre    = "<<dre<<'\n';		// OK
-		// LOG<<"dye    = "<<dye<<'\n';     	// Bug -> FIXED.
-		// LOG<<"Jacobi\n "<<d2ye<<'\n';
-		// LOG<<"invJ \n  "<<invJ<<'\n';
-		// LOG<<"fstp   = "<<fstp<<'\n';		// Bug -> FIXED.
-		//LOG<<"d2lz_m = "<<d2lz_m<<'\n';  // plus group is different.
-		//LOG<<"Newton step\n"<<fstp<<'\n';
-		//LOG<<"End of CalcSurvivorship"<<'\n';
 	}
 
 	/**
@@ -702,13 +675,314 @@ namespace rfp {
 
 
 
-	// template<class Type>
-	// class spr : public referencePoints<Type>
-	// {
-	// public:
-	// 	spr();
-	// 	~spr();
-	// };
+	/**
+	 * @brief SPR-based reference points
+	 * @details Class object for computing a family of spawning potential ratio
+	 * reference points (F_x%, B_x%) for a vector of target ratios x.  All of the
+	 * targets are solved together; each Newton iteration makes a single pass over
+	 * groups and ages and updates the survivorship of every target at once.
+	 * 
+	 * Fishing mortality is distributed among fleets in proportion to the 
+	 * allocation vector ak, such that F_x% is the total fishing mortality rate
+	 * and the fleet specific rates are F_x% * ak/sum(ak).  Survivorship and
+	 * spawning biomass per recruit follow the same conventions as the Msy
+	 * class: a fraction rho of the total mortality occurs before spawning, so
+	 * SPR = 1 at F = 0 and Bo agrees with Msy::getBo.  Equilibrium recruitment
+	 * uses the Beverton-Holt (rectype 1) or Ricker (rectype 2) model, as in
+	 * calcStockRecruitment.
+	 * 
+	 * @tparam T variable
+	 * @tparam T1 vector
+	 * @tparam T2 matrix
+	 * @tparam T3 3d_array
+	 */
+	template<class T, class T1, class T2, class T3>
+	class spr
+	{
+	private:
+		// Indexes for dimensions
+		int m_sage;
+		int m_nage;
+		int m_nGear;
+		int m_nGrp;
+		int m_nTarget;
+
+		T m_ro;
+		T m_h;
+		T m_rho;		/// Fraction of mortality that occurs before spawning.
+		int m_rectype;	/// Recruitment model: 1 Beverton-Holt, 2 Ricker.
+		T m_bo;
+		T m_phie;		/// Spawning biomass per recruit in unfished conditions.
+
+		T1 m_target;	/// Target spawning potential ratios.
+		T1 m_pk;		/// Proportion of the total F for each fleet.
+		T1 m_fspr;		/// Total fishing mortality rate at each target.
+		T1 m_phif;		/// Spawning biomass per recruit at each target.
+		T1 m_dphif;		/// Derivative of phif with respect to total F.
+		T1 m_spr;		/// Spawning potential ratio achieved at each target.
+		T1 m_bspr;		/// Equilibrium spawning biomass at each target.
+		T1 m_rspr;		/// Equilibrium recruitment at each target.
+		T1 m_yspr;		/// Equilibrium yield (all fleets) at each target.
+		T1 m_lz;		/// Survivorship for each target (workspace).
+		T1 m_dlz;		/// Derivative of survivorship (workspace).
+
+		T2 m_Ma;		/// Natural mortality rate matrix.
+		T2 m_Wa;		/// Weight-at-age matrix.
+		T2 m_Fa;		/// Fecundity-at-age matrix.
+		T2 m_va;		/// Allocation weighted selectivity for each group.
+
+		T3 m_Va;		/// Selectivity-at-age.
+
+		void calcPhif(const T1 &fbar);
+		void calcEquilibrium();
+
+	public:
+		spr(const T  ro ,
+		    const T  h  ,
+		    const T  rho,
+		    const int rectype,
+		    const T2 ma ,
+		    const T2 wa ,
+		    const T2 fa ,
+		    const T3 V )
+		:m_ro(ro),m_h(h),m_rho(rho),m_rectype(rectype),m_Ma(ma),m_Wa(wa),m_Fa(fa),m_Va(V)
+		{
+			if(m_Ma.indexmin() != m_Fa.indexmin() || m_Ma.indexmax() != m_Fa.indexmax())
+			{
+        cerr<<"Indexes do not match in spr\n";
+        exit(1);
+			}
+			if(m_rectype != 1 && m_rectype != 2)
+			{
+        cerr<<"Recruitment model must be 1 (Beverton-Holt) or 2 (Ricker) in spr\n";
+        exit(1);
+			}
+
+			m_nGrp  = m_Ma.rowmax() - m_Ma.rowmin() + 1;
+			m_nGear = m_Va(1).rowmax();
+			m_sage  = m_Ma.colmin();
+			m_nage  = m_Ma.colmax();
+
+			m_va.allocate(1,m_nGrp,m_sage,m_nage);
+			m_va.initialize();
+
+			// Unfished spawning biomass per recruit (F = 0).
+			m_nTarget = 1;
+			m_lz.allocate(1,1);
+			m_dlz.allocate(1,1);
+			m_phif.allocate(1,1);
+			m_dphif.allocate(1,1);
+			T1 fzero(1,1);
+			fzero.initialize();
+			calcPhif(fzero);
+			m_phie = m_phif(1);
+			m_bo   = m_ro * m_phie;
+		}
+
+		const T1 getFspr(const T1 &target, const T1 &ak);
+
+		// Getters
+		const T  getBo()   {return m_bo;   }
+		const T  getPhie() {return m_phie; }
+		const T1 getFspr() {return m_fspr; }
+		const T1 getBspr() {return m_bspr; }
+		const T1 getRspr() {return m_rspr; }
+		const T1 getYspr() {return m_yspr; }
+		const T1 getSpr()  {return m_spr;  }
+		const T1 getFe(const int &i) {return m_fspr(i) * m_pk; }
+	};
+
+	/**
+	 * @brief Solve for F_x% for a vector of target ratios.
+	 * @details Newton-Raphson iterations on phif(F)/phie - x = 0 for all targets
+	 * simultaneously.  Steps that would leave the feasible region (F > 0) are 
+	 * halved towards the current iterate.  On exit the equilibrium spawning
+	 * biomass, recruitment and yield at each F_x% are available via the getters.
+	 * 
+	 * @param target vector of target spawning potential ratios (0 < x < 1).
+	 * @param ak allocation of the total fishing mortality to each fleet.
+	 * @return Returns the total fishing mortality rate for each target.
+	 */
+	template<class T, class T1, class T2, class T3>
+	const T1 spr<T,T1,T2,T3>::getFspr(const T1 &target, const T1 &ak)
+	{
+		int i,j,h,k;
+		const int    maxiter = 50;
+		const double tol     = 1.0e-10;
+
+		m_nTarget = target.indexmax() - target.indexmin() + 1;
+		m_target.deallocate(); m_target.allocate(1,m_nTarget);
+		for( i = 1; i <= m_nTarget; i++ )
+		{
+			m_target(i) = target(target.indexmin()+i-1);
+			if( m_target(i) <= 0.0 || m_target(i) >= 1.0 )
+			{
+				cerr<<"Target spawning potential ratio must be between 0 and 1\n";
+				exit(1);
+			}
+		}
+
+		// Allocation weighted selectivity.
+		m_pk = ak / sum(ak);
+		m_va.initialize();
+		for( h = 1; h <= m_nGrp; h++ )
+		{
+			for( k = 1; k <= m_nGear; k++ )
+			{
+				for( j = m_sage; j <= m_nage; j++ )
+				{
+					m_va(h,j) += m_pk(k) * m_Va(h)(k)(j);
+				}
+			}
+		}
+
+		// Workspace for all targets.
+		m_lz.deallocate();     m_lz.allocate(1,m_nTarget);
+		m_dlz.deallocate();    m_dlz.allocate(1,m_nTarget);
+		m_phif.deallocate();   m_phif.allocate(1,m_nTarget);
+		m_dphif.deallocate();  m_dphif.allocate(1,m_nTarget);
+		
+		// Initial guess: F_x% scales with -log(x) times the average M.
+		T mbar = 0;
+		for( h = 1; h <= m_nGrp; h++ )
+		{
+			mbar += mean(m_Ma(h));
+		}
+		mbar /= m_nGrp;
+		T1 fbar(1,m_nTarget);
+		for( i = 1; i <= m_nTarget; i++ )
+		{
+			fbar(i) = -log(m_target(i)) * mbar;
+		}
+
+		for(int iter = 1; iter <= maxiter; iter++ )
+		{
+			calcPhif(fbar);
+			
+			bool converged = true;
+			for( i = 1; i <= m_nTarget; i++ )
+			{
+				T fx   = m_phif(i)/m_phie - m_target(i);
+				T fstp = fx / (m_dphif(i)/m_phie);
+				T ftry = fbar(i) - fstp;
+				
+				// Backtrack if outside boundary conditions
+				if( ftry <= 0.0 ) ftry = 0.5 * fbar(i);
+				if( fabs(fx) > tol ) converged = false;
+				fbar(i) = ftry;
+			}
+			if( converged ) break;
+		}
+		calcPhif(fbar);
+		m_fspr.deallocate();   m_fspr.allocate(1,m_nTarget);
+		m_fspr = fbar;
+		calcEquilibrium();
+		return m_fspr;
+	}
+
+	/**
+	 * @brief Spawning biomass per recruit for a vector of total F values.
+	 * @details Computes phif and its derivative with respect to the total 
+	 * fishing mortality for every element of fbar in a single pass over groups
+	 * and ages.  Spawning survivorship is lz*exp(-rho*za), with the plus group
+	 * of the Msy class.
+	 * 
+	 * @param fbar vector of total fishing mortality rates.
+	 */
+	template<class T, class T1, class T2, class T3>
+	void spr<T,T1,T2,T3>::calcPhif(const T1 &fbar)
+	{
+		int i,j,h;
+		T za,sa,oa,psa;
+
+		m_phif.initialize();
+		m_dphif.initialize();
+		for( h = 1; h <= m_nGrp; h++ )
+		{
+			for( i = 1; i <= m_nTarget; i++ )
+			{
+				m_lz(i)  = 1.0/m_nGrp;
+				m_dlz(i) = 0;
+			}
+			for( j = m_sage; j <= m_nage; j++ )
+			{
+				for( i = 1; i <= m_nTarget; i++ )
+				{
+					za  = m_Ma(h,j) + fbar(i) * m_va(h,j);
+					sa  = exp(-za);
+					psa = exp(-m_rho*za);
+					if( j == m_nage )  // + group
+					{
+						oa = 1.0 - sa;
+						m_phif(i)  += m_lz(i)*psa/oa * m_Fa(h,j);
+						m_dphif(i) += ( m_dlz(i)*psa/oa 
+						              - m_lz(i)*m_rho*m_va(h,j)*psa/oa
+						              - m_lz(i)*psa*m_va(h,j)*sa/(oa*oa) ) * m_Fa(h,j);
+					}
+					else
+					{
+						m_phif(i)  += m_lz(i)*psa * m_Fa(h,j);
+						m_dphif(i) += ( m_dlz(i)*psa 
+						              - m_lz(i)*m_rho*m_va(h,j)*psa ) * m_Fa(h,j);
+						m_dlz(i)    = sa * (m_dlz(i) - m_lz(i)*m_va(h,j));
+						m_lz(i)     = sa * m_lz(i);
+					}
+				}
+			}
+		}
+	}
+
+	/**
+	 * @brief Equilibrium quantities at each F_x%.
+	 * @details Beverton-Holt or Ricker equilibrium recruitment, spawning
+	 * biomass and the total yield over all fleets at the fishing mortality
+	 * rates in m_fspr.
+	 */
+	template<class T, class T1, class T2, class T3>
+	void spr<T,T1,T2,T3>::calcEquilibrium()
+	{
+		int i,j,h;
+		T za,sa,oa,lz,phiq;
+		T kappa = m_rectype == 1 ? 4.0*m_h/(1.-m_h) : pow(5.0*m_h,1.25);
+		T km1   = kappa - 1.0;
+
+		m_spr.deallocate();   m_spr.allocate(1,m_nTarget);
+		m_rspr.deallocate();  m_rspr.allocate(1,m_nTarget);
+		m_bspr.deallocate();  m_bspr.allocate(1,m_nTarget);
+		m_yspr.deallocate();  m_yspr.allocate(1,m_nTarget);
+		for( i = 1; i <= m_nTarget; i++ )
+		{
+			// Yield per recruit for the combined fleets.
+			phiq = 0;
+			for( h = 1; h <= m_nGrp; h++ )
+			{
+				lz = 1.0/m_nGrp;
+				for( j = m_sage; j <= m_nage; j++ )
+				{
+					za = m_Ma(h,j) + m_fspr(i) * m_va(h,j);
+					sa = exp(-za);
+					oa = 1.0 - sa;
+					if( j == m_nage ) lz /= oa;
+					phiq += lz * m_Wa(h,j) * m_fspr(i) * m_va(h,j) * oa / za;
+					lz   *= sa;
+				}
+			}
+
+			m_spr(i)  = m_phif(i)/m_phie;
+			switch( m_rectype )
+			{
+				case 1:  // Beverton-Holt
+					m_rspr(i) = m_ro*(kappa-m_phie/m_phif(i)) / km1;
+				break;
+				case 2:  // Ricker
+					m_rspr(i) = m_ro*m_phie*log(kappa*m_spr(i)) / (log(kappa)*m_phif(i));
+				break;
+			}
+			if( m_rspr(i) < 0 ) m_rspr(i) = 0;
+			m_bspr(i) = m_rspr(i) * m_phif(i);
+			m_yspr(i) = m_rspr(i) * phiq;
+		}
+	}
 } //rfp
 
 
@@ -0,0 +1,267 @@
+#ifndef _MSY_FRONTIER_H
+#define _MSY_FRONTIER_H
+
+#include <vector>
+#include <admodel.h>
+#include "msy.hpp"
+#include "parallel.h"
+
+namespace rfp {
+	/**
+	 * @brief Allocation trade-off frontier for multiple fleets.
+	 * @details Solves msy::getFmsy(fe,ak) for a set of catch allocations ak
+	 * and keeps Fmsy, MSY by fleet, total MSY and Bmsy for each one.  By
+	 * default the allocations are the points of a regular simplex lattice
+	 * with nStep divisions, ordered as a boustrophedon path so that
+	 * successive points differ by moving 1/nStep of the catch between two
+	 * fleets.  The path is cut into contiguous blocks that are solved on
+	 * separate threads; inside a block every solve is started from the Fmsy
+	 * of the previous point and stops once the Newton step is below tol.
+	 *
+	 * One msy object is built per block in the calling thread, so only use
+	 * the double types (double, dvector, dmatrix, d3_array) with this class.
+	 *
+	 * @tparam T variable
+	 * @tparam T1 vector
+	 * @tparam T2 matrix
+	 * @tparam T3 3d_array
+	 */
+	template<class T, class T1, class T2, class T3>
+	class msyFrontier
+	{
+	private:
+		int m_nGear;
+		int m_nPts;
+
+		T m_ro;
+		T m_h;
+		T m_rho;
+		T m_tol;		/// Newton tolerance for each solve.
+
+		T2 m_Ma;		/// Natural mortality rate matrix.
+		T2 m_Wa;		/// Weight-at-age matrix.
+		T2 m_Fa;		/// Fecundity-at-age matrix.
+		T3 m_Va;		/// Selectivity-at-age.
+
+		T2 m_ak;		/// Allocations (nPts, nGear).
+		T2 m_fmsy;		/// Fmsy for each allocation (nPts, nGear).
+		T2 m_msy;		/// MSY by fleet for each allocation (nPts, nGear).
+		T1 m_ytot;		/// Total MSY for each allocation.
+		T1 m_bmsy;		/// Spawning biomass at MSY for each allocation.
+		ivector m_iter;	/// Newton iterations used for each allocation.
+
+		void lattice(const int k, const int rem, std::vector<int> &c,
+		             std::vector<bool> &up, std::vector<int> &path) const;
+
+	public:
+		msyFrontier(const T  ro ,
+		            const T  h  ,
+		            const T  rho,
+		            const T2 ma ,
+		            const T2 wa ,
+		            const T2 fa ,
+		            const T3 V  ,
+		            const T  tol = 1.e-8)
+		:m_ro(ro),m_h(h),m_rho(rho),m_tol(tol),m_Ma(ma),m_Wa(wa),m_Fa(fa),m_Va(V)
+		{
+			m_nGear = m_Va(m_Va.indexmin()).rowmax();
+			m_nPts  = 0;
+		}
+
+		void simplex(const int nStep, const T floor = 1.e-6);
+		void setAllocations(const T2 &ak);
+		void solve(const T1 &fe);
+
+		// Getters
+		int getPoints()      const {return m_nPts;  }
+		const T2 &getAllocation()  {return m_ak;    }
+		const T2 &getFmsy()        {return m_fmsy;  }
+		const T2 &getMsy()         {return m_msy;   }
+		const T1 &getTotalMsy()    {return m_ytot;  }
+		const T1 &getBmsy()        {return m_bmsy;  }
+		const ivector &getIterations() {return m_iter;}
+
+		void write(ofstream &ofs, const int group);
+	};
+
+	/**
+	 * @brief Recursive boustrophedon walk over the simplex lattice.
+	 * @details Fleet k takes rem..0 or 0..rem units, alternating direction
+	 * after each sweep so that neighbouring points on the path are also
+	 * neighbours on the lattice.  The last fleet takes what is left.
+	 */
+	template<class T, class T1, class T2, class T3>
+	void msyFrontier<T,T1,T2,T3>::lattice(const int k, const int rem,
+	                                      std::vector<int> &c,
+	                                      std::vector<bool> &up,
+	                                      std::vector<int> &path) const
+	{
+		if( k == m_nGear )
+		{
+			c[k-1] = rem;
+			path.insert(path.end(),c.begin(),c.end());
+			return;
+		}
+		for(int i = 0; i <= rem; i++ )
+		{
+			int v  = up[k-1] ? i : rem-i;
+			c[k-1] = v;
+			lattice(k+1,rem-v,c,up,path);
+		}
+		up[k-1] = !up[k-1];
+	}
+
+	/**
+	 * @brief Allocations on a regular simplex lattice.
+	 * @details Builds all allocations with shares in steps of 1/nStep that sum
+	 * to one.  Zero shares are replaced by floor and the row renormalized so
+	 * that the allocation solver never divides by a zero yield.
+	 *
+	 * @param nStep number of divisions of the unit interval.
+	 * @param floor smallest share given to a fleet.
+	 */
+	template<class T, class T1, class T2, class T3>
+	void msyFrontier<T,T1,T2,T3>::simplex(const int nStep, const T floor)
+	{
+		std::vector<int>  c(m_nGear,0);
+		std::vector<bool> up(m_nGear,false);
+		std::vector<int>  path;
+		lattice(1,nStep,c,up,path);
+
+		T2 ak(1,int(path.size())/m_nGear,1,m_nGear);
+		for(int i = ak.rowmin(); i <= ak.rowmax(); i++ )
+		{
+			for(int k = 1; k <= m_nGear; k++ )
+			{
+				T pk = T(path[(i-1)*m_nGear+k-1])/nStep;
+				ak(i,k) = pk > floor ? pk : floor;
+			}
+			ak(i) /= sum(ak(i));
+		}
+		setAllocations(ak);
+	}
+
+	/**
+	 * @brief Use a user supplied set of allocations.
+	 * @param ak matrix of allocations (nPts, nGear); each row is normalized.
+	 */
+	template<class T, class T1, class T2, class T3>
+	void msyFrontier<T,T1,T2,T3>::setAllocations(const T2 &ak)
+	{
+		m_nPts = ak.rowmax() - ak.rowmin() + 1;
+		m_ak.deallocate();
+		m_ak.allocate(1,m_nPts,1,m_nGear);
+		for(int i = 1; i <= m_nPts; i++ )
+		{
+			for(int k = 1; k <= m_nGear; k++ )
+			{
+				m_ak(i,k) = ak(ak.rowmin()+i-1,k);
+			}
+			m_ak(i) /= sum(m_ak(i));
+		}
+
+		m_fmsy.deallocate();
+		m_msy.deallocate();
+		m_ytot.deallocate();
+		m_bmsy.deallocate();
+		m_iter.deallocate();
+		m_fmsy.allocate(1,m_nPts,1,m_nGear);
+		m_msy.allocate(1,m_nPts,1,m_nGear);
+		m_ytot.allocate(1,m_nPts);
+		m_bmsy.allocate(1,m_nPts);
+		m_iter.allocate(1,m_nPts);
+	}
+
+	/**
+	 * @brief Solve for Fmsy at every allocation on the frontier.
+	 * @details The points are split into one contiguous block per thread.
+	 * The msy objects and the per-block work vectors are created here, in
+	 * the calling thread; the threads only read the shared life history
+	 * arrays and write to their own rows of the output matrices.
+	 *
+	 * @param fe starting values of F for the first point of each block.
+	 */
+	template<class T, class T1, class T2, class T3>
+	void msyFrontier<T,T1,T2,T3>::solve(const T1 &fe)
+	{
+		if( m_nPts < 1 ) return;
+
+		int nBlk = parallel::getThreadCount();
+		if( nBlk > m_nPts ) nBlk = m_nPts;
+
+		typedef msy<T,T1,T2,T3> msy_t;
+		std::vector<msy_t*> pMsy(nBlk);
+		T2 fk(1,nBlk,1,m_nGear);
+		T2 ak(1,nBlk,1,m_nGear);
+		for(int b = 1; b <= nBlk; b++ )
+		{
+			pMsy[b-1] = new msy_t(m_ro,m_h,m_rho,m_Ma,m_Wa,m_Fa,m_Va);
+			pMsy[b-1]->setTolerance(m_tol);
+			for(int k = 1; k <= m_nGear; k++ )
+			{
+				fk(b,k) = fe(fe.indexmin()+k-1);
+			}
+		}
+
+		parallel::for_each(1,nBlk,[&](int b)
+		{
+			msy_t &c_msy = *pMsy[b-1];
+			int i1 = (b-1) * m_nPts / nBlk + 1;
+			int i2 =  b    * m_nPts / nBlk;
+			for(int i = i1; i <= i2; i++ )
+			{
+				for(int k = 1; k <= m_nGear; k++ )
+				{
+					ak(b,k) = m_ak(i,k);
+				}
+				T1 fmsy = c_msy.getFmsy(fk(b),ak(b));
+				T1 ye   = c_msy.getMsy();
+				m_ytot(i) = 0;
+				for(int k = 1; k <= m_nGear; k++ )
+				{
+					m_fmsy(i,k) = fmsy(k);
+					m_msy(i,k)  = ye(k);
+					m_ytot(i)  += ye(k);
+					// warm start for the neighbouring allocation
+					fk(b,k) = fmsy(k);
+				}
+				m_bmsy(i) = c_msy.getBmsy();
+				m_iter(i) = c_msy.getIterations();
+			}
+		});
+
+		for(int b = 1; b <= nBlk; b++ )
+		{
+			delete pMsy[b-1];
+		}
+	}
+
+	/**
+	 * @brief Write the frontier as comma separated rows.
+	 * @details One row per allocation: group, ak_k, fmsy_k, msy_k, total msy
+	 * and bmsy.  Writes a header when the stream is at the start of the file.
+	 */
+	template<class T, class T1, class T2, class T3>
+	void msyFrontier<T,T1,T2,T3>::write(ofstream &ofs, const int group)
+	{
+		int k;
+		if( ofs.tellp() == 0 )
+		{
+			ofs<<"group";
+			for( k = 1; k <= m_nGear; k++ ) ofs<<",ak"<<k;
+			for( k = 1; k <= m_nGear; k++ ) ofs<<",fmsy"<<k;
+			for( k = 1; k <= m_nGear; k++ ) ofs<<",msy"<<k;
+			ofs<<",msy,bmsy\n";
+		}
+		for(int i = 1; i <= m_nPts; i++ )
+		{
+			ofs<<group;
+			for( k = 1; k <= m_nGear; k++ ) ofs<<","<<m_ak(i,k);
+			for( k = 1; k <= m_nGear; k++ ) ofs<<","<<m_fmsy(i,k);
+			for( k = 1; k <= m_nGear; k++ ) ofs<<","<<m_msy(i,k);
+			ofs<<","<<m_ytot(i)<<","<<m_bmsy(i)<<'\n';
+		}
+	}
+} //rfp
+
+#endif
@@ -0,0 +1,133 @@
+#ifndef _MSY_WORKSPACE_H
+#define _MSY_WORKSPACE_H
+
+#include <admodel.h>
+
+namespace rfp {
+	/**
+	 * @brief Work arrays for the equilibrium calculations.
+	 * @details Survivorship, per-recruit yield and derivative terms used by
+	 * msy::calcEquilibrium and Msy::calcEquilibrium.  The arrays are sized
+	 * once from (nGrp, nGear, sage..nage) when the reference point object is
+	 * constructed, so the Newton iterations do not allocate any memory.
+	 *
+	 * @tparam T variable
+	 * @tparam T1 vector
+	 * @tparam T2 matrix
+	 * @tparam T3 3d_array
+	 */
+	template<class T, class T1, class T2, class T3>
+	struct msyWorkspace
+	{
+		T2 za;		/// Total mortality (nGrp, age)
+		T2 sa;		/// Survival rate (nGrp, age)
+		T2 oa;		/// 1 - survival rate (nGrp, age)
+		T2 lz;		/// Survivorship under fished conditions (nGrp, age)
+
+		T3 qa;		/// Per recruit yield-at-age (nGrp, nGear, age)
+		T3 dlz;		/// 1st derivative of survivorship (nGrp, nGear, age)
+		T3 d2lz;	/// 2nd derivative of survivorship (nGrp, nGear, age)
+
+		T1 phiq;	/// Per recruit yield (nGear)
+		T1 dphif;	/// 1st derivative of phif (nGear)
+		T1 d2phif;	/// 2nd derivative of phif (nGear)
+		T1 dre;		/// 1st derivative of recruitment (nGear)
+		T1 d2re;	/// 2nd derivative of recruitment (nGear)
+		T1 ye;		/// Equilibrium yield (nGear)
+		T1 dye;		/// 1st derivative of yield (nGear)
+		T1 x;		/// Solution of the Newton system (nGear)
+
+		T2 dphiq;	/// 1st derivative of phiq (nGear, nGear)
+		T2 d2phiq;	/// 2nd derivative of phiq (nGear, nGear)
+		T2 d2ye;	/// Jacobian of dye (nGear, nGear)
+		T2 A;		/// Factorization workspace (nGear, nGear)
+
+		void allocate(const int nGrp, const int nGear, const int sage, const int nage)
+		{
+			za.allocate(1,nGrp,sage,nage);
+			sa.allocate(1,nGrp,sage,nage);
+			oa.allocate(1,nGrp,sage,nage);
+			lz.allocate(1,nGrp,sage,nage);
+
+			qa.allocate(1,nGrp,1,nGear,sage,nage);
+			dlz.allocate(1,nGrp,1,nGear,sage,nage);
+			d2lz.allocate(1,nGrp,1,nGear,sage,nage);
+
+			phiq.allocate(1,nGear);
+			dphif.allocate(1,nGear);
+			d2phif.allocate(1,nGear);
+			dre.allocate(1,nGear);
+			d2re.allocate(1,nGear);
+			ye.allocate(1,nGear);
+			dye.allocate(1,nGear);
+			x.allocate(1,nGear);
+
+			dphiq.allocate(1,nGear,1,nGear);
+			d2phiq.allocate(1,nGear,1,nGear);
+			d2ye.allocate(1,nGear,1,nGear);
+			A.allocate(1,nGear,1,nGear);
+		}
+
+		/**
+		 * @brief Solve A x = b in place.
+		 * @details Gaussian elimination with partial pivoting on the
+		 * workspace matrix A (overwritten); b is copied into x and replaced by
+		 * the solution.  Replaces inv() for the small nGear x nGear systems.
+		 *
+		 * @param b right hand side vector.
+		 * @return Reference to the solution vector x.
+		 */
+		const T1& solve(const T1 &b)
+		{
+			int i,j,k,p;
+			int n = A.rowmax();
+			for( i = 1; i <= n; i++ ) x(i) = b(i);
+
+			for( k = 1; k <= n; k++ )
+			{
+				// pivot
+				p = k;
+				for( i = k+1; i <= n; i++ )
+				{
+					if( fabs(A(i,k)) > fabs(A(p,k)) ) p = i;
+				}
+				if( p != k )
+				{
+					for( j = 1; j <= n; j++ )
+					{
+						T tmp  = A(k,j);
+						A(k,j) = A(p,j);
+						A(p,j) = tmp;
+					}
+					T tmp = x(k);
+					x(k)  = x(p);
+					x(p)  = tmp;
+				}
+
+				// eliminate
+				for( i = k+1; i <= n; i++ )
+				{
+					T lik = A(i,k)/A(k,k);
+					for( j = k+1; j <= n; j++ )
+					{
+						A(i,j) -= lik * A(k,j);
+					}
+					x(i) -= lik * x(k);
+				}
+			}
+
+			// back substitution
+			for( i = n; i >= 1; i-- )
+			{
+				for( j = i+1; j <= n; j++ )
+				{
+					x(i) -= A(i,j) * x(j);
+				}
+				x(i) /= A(i,i);
+			}
+			return x;
+		}
+	};
+} //rfp
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef _OUTPUT_MANIFEST_H
+#define _OUTPUT_MANIFEST_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+/** \brief  Which mceval outputs to write (-manifest file)
+
+	Without a manifest every series is written.  A manifest file lists the
+	series to keep, one per line, and everything else is skipped:
+
+	  # name   groups   years
+	  sbt      all      all
+	  rt       1        1990:2015
+	  mcmc
+
+	name is one of mcmc (iscam_mcmc.csv, parameters and reference points),
+	sbt, rt, ft, rdev, vbt, ut (the derived time series of mcmc_output) or
+	proj (the projections and decision table).  groups is "all" or a comma
+	separated list of indices of the first dimension of the series (group,
+	or area-group-sex for ft and ut); years is "all" or first:last.  Both
+	default to all, and are ignored for mcmc and proj.  Text after # is a
+	comment.
+**/
+class OutputManifest
+{
+public:
+	/** Selection for one series */
+	struct Series
+	{
+		bool on;
+		std::vector<int> groups;	//!< Empty for all groups
+		int  syr;					//!< First year (0 for all years)
+		int  nyr;					//!< Last year (0 for all years)
+
+		Series(const bool& on_ = true):on(on_),syr(0),nyr(0) {}
+
+		bool hasGroup(const int& g) const
+		{
+			if( !on ) return false;
+			if( groups.empty() ) return true;
+			for( size_t i = 0; i < groups.size(); i++ ) if( groups[i] == g ) return true;
+			return false;
+		}
+		bool has(const int& g, const int& yr) const
+		{
+			return hasGroup(g) && (syr == 0 || (yr >= syr && yr <= nyr));
+		}
+	};
+
+	OutputManifest();
+
+	bool read(const std::string& filename);
+	const Series& get(const std::string& name) const;
+	bool wants(const std::string& name) const { return get(name).on; }
+
+private:
+	std::map<std::string, Series> m_series;
+};
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef _PARALLEL_H
+#define _PARALLEL_H
+
+#include <functional>
+
+/**
+ * @brief Simple work sharing across threads.
+ * @details Runs independent pieces of work on a small pool of std::threads.
+ * The ADMB vector and matrix classes use shallow, reference counted copies
+ * and the dvariable types share a global gradient stack, so the rules are:
+ *   - only double types (dvector, dmatrix, d3_array) inside the body,
+ *   - construct the objects in the calling thread, one per work item,
+ *   - do not copy or assign ADMB objects that are shared between items,
+ *   - do not write to the LOG from inside the body.
+ *
+ * The number of threads defaults to the number of hardware cores and can
+ * be changed with the -nthreads command line option.
+ */
+namespace parallel
+{
+	/// Number of worker threads used by parallel::for_each.
+	int  getThreadCount();
+
+	/// Set the number of worker threads (n < 1 resets to the number of cores).
+	void setThreadCount(const int n);
+
+	/**
+	 * @brief Call body(i) for i = first..last.
+	 * @details Indexes are handed out dynamically so work items of uneven
+	 * cost are balanced over the threads.  Runs serially in the calling
+	 * thread when there is one thread or a single work item.
+	 *
+	 * @param first first index (inclusive)
+	 * @param last last index (inclusive)
+	 * @param body work item
+	 */
+	void for_each(const int first, const int last, const std::function<void(int)> &body);
+}
+
+#endif
@@ -0,0 +1,141 @@
+#ifndef _POSTERIOR_TABLE_H
+#define _POSTERIOR_TABLE_H
+
+#include <string>
+#include <sstream>
+#include <vector>
+#include "buffered_ofstream.h"
+#include "decision_table.h"
+
+/** \brief  Header of a binary posterior file (.ipost)
+
+	Layout of the file, all numbers little-endian:
+
+	  char[8]  magic "IPOST\0\0\0"
+	  int32    version (1)
+	  int32    layout, 0 = row-major (one draw after the other, as written
+	           during mceval), 1 = column-major (all draws of a column)
+	  int64    ndraw, number of draws (0 in a row-major file that is still
+	           being written: the data length gives the number of draws)
+	  int64    ncol, number of columns
+	  int64    offset, byte offset of the data from the start of the file
+	  int32    length and characters of the dimension string, e.g.
+	           "ngroup=1 n_ags=1 ngear=5 syr=1956 nyr=2014 sage=2 nage=20"
+	  ncol x   int32 length and characters of the column name
+	  zero padding to a multiple of 8 bytes
+	  doubles  the data from offset on
+
+	In a column-major file column c is the ndraw doubles starting at
+	offset + 8 * c * ndraw, so a file can be mapped and each column used
+	as an array.
+**/
+struct PosteriorHeader
+{
+	int    version;
+	int    layout;
+	long long ndraw;
+	long long ncol;
+	long long offset;
+	std::string dims;
+	std::vector<std::string> names;
+
+	PosteriorHeader();
+	void write(std::ostream& os);
+	bool read(std::istream& is);
+};
+
+
+/** \brief  Running posterior summaries of the columns of a table
+
+	Mean and standard deviation with Welford's updates and the 2.5%, 50%
+	and 97.5% quantiles with P2Quantile, so a summary of every column is
+	kept in fixed memory while the draws stream past.
+**/
+class PosteriorSummary
+{
+private:
+	static const int NPROB = 3;
+	std::vector<std::string> m_names;
+	long long m_count;
+	std::vector<double> m_mean;
+	std::vector<double> m_m2;		//!< Sum of squared deviations from the mean
+	std::vector<P2Quantile> m_quant;	//!< NPROB per column
+
+public:
+	PosteriorSummary();
+
+	void allocate(const std::vector<std::string>& names);
+	void add(const double* x);
+	void write(std::ostream& os, const std::string& series) const;
+	static void writeHeader(std::ostream& os);
+
+	long long getCount() const { return m_count; }
+};
+
+
+/** \brief  One posterior output file, written a draw at a time
+
+	Replaces a hand-written CSV file of mcmc_output: the columns are named
+	once with name(), then each draw is a sequence of add() calls closed
+	by endRow() (repeatRow() writes the previous draw again).  With
+	binary = false the file is basename.csv in the existing layout
+	(header line, comma separated values); with
+	binary = true the draws are streamed row-major to basename.ipost.part
+	and close() transposes them to the column-major basename.ipost.
+
+	Both use a BufferedOfstream, so the files stay open for the whole
+	mceval.  With setSummary(true) every draw is also added to a
+	PosteriorSummary of the columns, and with setRowMajor(true) a binary
+	file is left as the row-major basename.ipost.part (the -pmceval
+	workers, whose draws are appended with posterior_append).
+
+	\sa PosteriorHeader, posterior_to_csv
+**/
+class PosteriorTable
+{
+private:
+	bool        m_binary;
+	std::string m_basename;
+	std::string m_dims;
+	BufferedOfstream m_ofs;
+	std::vector<std::string> m_names;
+	std::ostringstream m_name;	//!< Name being written by name()
+	bool        m_naming;
+	std::vector<double> m_row;
+	std::vector<double> m_last;	//!< Previous row, for repeatRow()
+	long long   m_rows;
+	long long   m_offset;		//!< Data offset of the row-major file
+	bool        m_summarize;
+	bool        m_rowMajor;		//!< Do not transpose on close()
+	PosteriorSummary m_summary;
+
+	void commitName();
+	void writeHeader();
+	void transpose();
+
+public:
+	PosteriorTable();
+	~PosteriorTable();
+
+	void open(const std::string& basename, const bool& binary, const std::string& dims = "");
+	bool is_open() const { return m_ofs.is_open(); }
+	void close();
+
+	std::ostream& name();
+	void add(const double& x) { m_row.push_back(x); }
+	void endRow();
+	void repeatRow();
+
+	void setSummary(const bool& on) { m_summarize = on; }
+	void setRowMajor(const bool& on) { m_rowMajor = on; }
+	const PosteriorSummary& getSummary() const { return m_summary; }
+
+	int       getColumns() const { return m_names.size(); }
+	long long getRows() const { return m_rows; }
+};
+
+
+bool posterior_to_csv(const std::string& binfile, const std::string& csvfile);
+bool posterior_append(const std::string& binfile, PosteriorTable& table);
+
+#endif
@@ -0,0 +1,165 @@
+#ifndef _PROJECTION_MODEL_H
+#define _PROJECTION_MODEL_H
+
+#include <iostream>
+#include <admodel.h>
+#include "baranov_batch.h"
+
+/// Raw binary reads and writes for the projection state files.
+namespace state_io
+{
+	void putInt(std::ostream& os, const int& x);
+	void putDouble(std::ostream& os, const double& x);
+	void putVector(std::ostream& os, const dvector& x);
+	bool getInt(std::istream& is, int& x);
+	bool getDouble(std::istream& is, double& x);
+	bool getVector(std::istream& is, dvector& x);
+}
+
+/** \brief  Header of a saved projection state file
+
+	The fitted model writes the projection inputs of the MPD or of every
+	mceval draw to a binary file so the projections can be rerun with a new
+	projection control file (-projonly) without refitting.  The header
+	records the model type and dimensions the records were written with.
+**/
+struct ProjectionStateHeader
+{
+	int type;	//!< 0 = age-structured (ProjectionDraw), 1 = delay difference (DDProjectionDraw)
+	int sage;
+	int nage;
+	int ngear;
+	int syr;
+	int nyr;
+
+	void write(std::ostream& os) const;
+	bool read(std::istream& is);
+};
+
+/** \brief  Inputs for projecting one posterior draw
+
+	Everything the projection needs from a fitted model, so that a draw can
+	be kept after the model state has moved on (e.g. to project all draws
+	together at the end of mceval).  N and Z hold rows nyr-1 and nyr, sbt
+	holds syr..nyr and xx the recruitment deviates (already scaled by tau)
+	for nyr-1..pyr.  xx is not saved with the state (write/read), the
+	deviates are regenerated from the draw number so that a rerun can use a
+	different projection horizon.
+**/
+struct ProjectionDraw
+{
+	int     draw;	//!< mceval draw number (0 for the MPD)
+	dvector M;		//!< Average natural mortality at age
+	dvector fa;		//!< Average fecundity at age
+	dvector wa;		//!< Average weight at age
+	dmatrix va;		//!< Selectivity (gear, age) in the terminal year
+	double  so;		//!< Recruitment parameter
+	double  beta;	//!< Recruitment parameter
+	double  tau;	//!< Recruitment standard deviation
+	dmatrix N;		//!< Numbers-at-age in nyr-1 and nyr
+	dmatrix Z;		//!< Total mortality in nyr-1 and nyr
+	dvector sbt;	//!< Spawning biomass syr..nyr
+	dvector xx;		//!< Recruitment deviates nyr-1..pyr
+	double  bo;		//!< Unfished spawning biomass
+	double  bmsy;	//!< Spawning biomass at MSY
+	double  fmsy;	//!< Fmsy for the first gear
+	double  ftnyr;	//!< Fishing mortality of the first gear in nyr
+
+	void write(std::ostream& os) const;
+	bool read(std::istream& is, const ProjectionStateHeader& h);
+};
+
+/** \brief  Batched age-structured projections
+
+	Projects many independent problems forward from the historical
+	numbers-at-age in a single pass.  A problem is a TAC option of one draw
+	(decision tables) or one draw under a harvest control rule.  The state
+	is a (problem, age) matrix of numbers advanced one year at a time, and
+	the fishing mortality rates of all problems in a year come from one
+	BaranovBatch solve.
+
+	Catch in each projection year is either a constant TAC (setTac) or
+	given by a hockey-stick harvest control rule (setHarvestControlRule):
+	with B the spawning biomass in the previous year and Bref = Bo or Bmsy,
+
+	  u = 0                                   B/Bref <= lrp
+	  u = hmax (B/Bref - lrp) / (usr - lrp)   lrp < B/Bref < usr
+	  u = hmax                                B/Bref >= usr
+	  TAC = u * B
+
+	Year loop (same as the former per-TAC projection_model in iscam.tpl):
+	  - from nyr-1, so that N(nyr) gets a stock-recruitment recruit rather
+	    than the estimated (uncertain) recruitment in nyr;
+	  - ft is solved from the allocated TAC for years after nyr;
+	  - sbt is recomputed from nyr with the fraction of Z before spawning;
+	  - recruits use the lagged sbt and the deviate xx(i) with a
+	    -0.5 tau^2 bias correction.
+
+	Only double types are used (single area, group and sex).
+
+	\sa BaranovBatch, projection_model in iscam.tpl
+**/
+class ProjectionModel
+{
+private:
+	int     m_nprob;	//!< Number of problems
+	int     m_ngear;	//!< Number of gears
+	int     m_sage;		//!< Youngest age
+	int     m_nage;		//!< Oldest age
+	int     m_syr;		//!< First year of the historical arrays
+	int     m_nyr;		//!< Last year of the historical arrays
+	int     m_pyr;		//!< Last projection year
+	int     m_srr;		//!< Stock-recruitment model 1 = Beverton-Holt, 2 = Ricker
+	double  m_zfrac;	//!< Fraction of total mortality before spawning
+	dvector m_alloc;	//!< Allocation of the TAC to each gear
+
+	int     m_hcr;		//!< Harvest control rule reference 0 = off, 1 = Bo, 2 = Bmsy
+	double  m_lrp;		//!< Limit reference point (fraction of Bref)
+	double  m_usr;		//!< Upper stock reference (fraction of Bref)
+	double  m_hmax;		//!< Maximum harvest rate
+
+	// Inputs by problem
+	dmatrix  m_M;		//!< Natural mortality (problem, age)
+	dmatrix  m_fa;		//!< Fecundity (problem, age)
+	dmatrix  m_wa;		//!< Weight (problem, age)
+	d3_array m_va;		//!< Selectivity (problem, gear, age)
+	dvector  m_so;		//!< Recruitment parameter
+	dvector  m_beta;	//!< Recruitment parameter
+	dvector  m_tau;		//!< Recruitment standard deviation
+	dvector  m_bref;	//!< Reference biomass for the harvest control rule
+	d3_array m_hN;		//!< Numbers-at-age (problem, nyr-1..nyr, age)
+	d3_array m_hZ;		//!< Total mortality (problem, nyr-1..nyr, age)
+	dmatrix  m_xx;		//!< Recruitment deviates (problem, nyr-1..pyr)
+
+	// Results by problem
+	dmatrix  m_tac;		//!< Catch taken (problem, nyr+1..pyr)
+	dmatrix  m_sbt;		//!< Spawning biomass (problem, syr..pyr)
+	d3_array m_ft;		//!< Fishing mortality (problem, nyr..pyr, gear)
+	imatrix  m_clip;	//!< Projection years with ft at MAXF (problem, nyr..pyr)
+
+	BaranovBatch m_baranov;
+
+public:
+	ProjectionModel(const int& nprob, const dvector& allocation,
+	                const int& sage, const int& nage,
+	                const int& syr, const int& nyr, const int& nproj,
+	                const int& srr, const double& zfrac);
+
+	void setProblem(const int& p, const ProjectionDraw& d);
+	void setTac(const int& p, const double& tac);
+	void setHarvestControlRule(const int& ref, const double& lrp,
+	                           const double& usr, const double& hmax);
+
+	void run(const bool& threaded = false);
+
+	// Getters
+	int     getProblems()   const { return m_nprob; }
+	int     getLastYear()   const { return m_pyr;   }
+	dvector getTac(const int& p) const { return m_tac(p); } /**< Catch taken nyr+1..pyr for problem p*/
+	dvector getSbt(const int& p) const { return m_sbt(p); } /**< Spawning biomass syr..pyr for problem p*/
+	dmatrix getFt(const int& p)  const { return m_ft(p);  } /**< Fishing mortality (year, gear) nyr..pyr for problem p*/
+	ivector getClipped(const int& p) const { return m_clip(p); } /**< 1 for years nyr..pyr where the TAC could not be taken*/
+	bool    getClipped(const int& p, const int& i) const { return m_clip(p,i); }
+};
+
+#endif
@@ -4,7 +4,9 @@
 #include <admodel.h>
 adstring stripExtension(adstring fileName);
 ivector getIndex(const dvector& a, const dvector& b);
-void write_proj_headers(ofstream &ofsP, int syr, int nyr, bool include_msy);
-void write_proj_output(ofstream &ofsP, int syr, int nyr, double tac, int pyr, dvector p_sbt, dmatrix p_ft, dvar_matrix ft, double bo, dmatrix fmsy, dvector bmsy, bool include_msy);
+void write_proj_headers(ostream &ofsP, int syr, int nyr, bool include_msy);
+void write_proj_output(ostream &ofsP, int syr, int nyr, double tac, int pyr, const dvector& p_sbt, const dmatrix& p_ft, double ftnyr, double bo, double fmsy, double bmsy, bool include_msy);
+void write_proj_year_headers(ostream &ofsP, int ngear, bool include_msy);
+void write_proj_years(ostream &ofsP, int iter, const dvector& p_tac, int nyr, int pyr, const dvector& p_sbt, const dmatrix& p_ft, const ivector& p_clip, double bo, double bmsy, bool include_msy);
 
 #endif
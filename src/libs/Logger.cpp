@@ -11,6 +11,19 @@ Logger::Logger(){
   m_stream<<"ISCAM runtime log - "<<ctime(&m_start_time)<<'\n';
 }
 
+// Drop what was logged so far (the parent process writes it) and log to filename.
+void Logger::redirect(const std::string& filename){
+  m_out.close();
+  m_filename = filename;
+  if(file_exists(m_filename)){
+    remove(m_filename.c_str());
+  }
+  m_out.open(m_filename.c_str(), std::ios::out | std::ios::app);
+  m_stream.str("");
+  m_start_time = time(0);
+  m_stream<<"ISCAM runtime log - "<<ctime(&m_start_time)<<'\n';
+}
+
 bool Logger::file_exists(const std::string& filename){
  struct stat buf;
  if (stat(filename.c_str(), &buf) != -1){
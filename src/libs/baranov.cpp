@@ -1,9 +1,20 @@
+#include <mutex>
 #include "../../include/baranov.h"
 #include "../../include/Logger.h"
 
+namespace
+{
+	std::mutex   statsMutex;
+	BaranovStats stats;
+}
+
 BaranovCatchEquation::BaranovCatchEquation()
 {
 	// Constructor
+	m_result.iterations = 0;
+	m_result.fnorm      = 0;
+	m_result.converged  = false;
+	m_result.clipped    = false;
 }
 BaranovCatchEquation::~BaranovCatchEquation()
 {
@@ -11,95 +22,460 @@ BaranovCatchEquation::~BaranovCatchEquation()
 }
 
 
+// Accessors that give the Newton solver a common (sex, gear, age) view of
+// the different argument shapes.  Single sex problems have nsex = 1.
+namespace
+{
+	// Natural mortality rate
+	struct ScalarM
+	{
+		const double &m;
+		double operator()(const int &h, const int &j) const { return m; }
+	};
+	struct VectorM
+	{
+		const dvector &m;
+		double operator()(const int &h, const int &j) const { return m(j); }
+	};
+	struct MatrixM
+	{
+		const dmatrix &m;
+		double operator()(const int &h, const int &j) const { return m(h,j); }
+	};
 
-/** \brief Baranov catch equation solution for 1 or more fleets.
-	
-		The following function solves the Baranov catch equation for multiple fleets using
-		a Newton-Raphson alogrithm to find a vector of fishing mortlity rates (ft) that 
-		predicts the total catch for each fleet.  The Jacobian matrix is computed and 
-		subsequently inverted to compute the Newton step for each fishing rate.
-		
-		BARANOV CATCH EQUATION:
-		\f$ C = \frac{FN(1-exp(-Z))}{Z} \f$
+	// Selectivity, pope() is the weight given to selectivity in the
+	// initial guess (the single sex versions have always ignored it).
+	struct GearV
+	{
+		const dmatrix &V;
+		double operator()(const int &h, const int &k, const int &j) const { return V(k,j); }
+		double pope(const int &h, const int &k, const int &j) const { return 1.0; }
+	};
+	struct SexGearV
+	{
+		const d3_array &V;
+		double operator()(const int &h, const int &k, const int &j) const { return V(h,k,j); }
+		double pope(const int &h, const int &k, const int &j) const { return V(h,k,j); }
+	};
 
-	\author Martell IPHC
-	\date 2012-08-05
-	\param  ct a vector of observed catches, 1 element for each gear.
-	\param  m instananeous natural mortality rate.
-	\param  V a matrix of selectivities (row for each gear, col for each age)
-	\param  na a vector of numbers-at-age at the start of each year
+	// Numbers-at-age
+	struct VectorN
+	{
+		const dvector &n;
+		int nsex() const { return 1; }
+		int sage() const { return n.indexmin(); }
+		int nage() const { return n.indexmax(); }
+		double operator()(const int &h, const int &j) const { return n(j); }
+	};
+	struct MatrixN
+	{
+		const dmatrix &n;
+		int nsex() const { return n.rowmax() - n.rowmin() + 1; }
+		int sage() const { return n.colmin(); }
+		int nage() const { return n.colmax(); }
+		double operator()(const int &h, const int &j) const { return n(h,j); }
+	};
+
+	// Weight-at-age (catch in numbers when there is no weight)
+	struct NoW
+	{
+		double operator()(const int &h, const int &j) const { return 1.0; }
+	};
+	struct VectorW
+	{
+		const dvector &w;
+		double operator()(const int &h, const int &j) const { return w(j); }
+	};
+	struct MatrixW
+	{
+		const dmatrix &w;
+		double operator()(const int &h, const int &j) const { return w(h,j); }
+	};
+}
+
+
+/** \brief Size the work arrays for the Newton iterations.
 	
-	\return Returns a vector of instantaneous fishing mortality rates.
-	\sa
+	Nothing is reallocated if the problem has the same dimensions as the
+	previous call.
+	
+	\param  ngear number of gears with catch
+	\param  nsex number of sexes
+	\param  sage youngest age
+	\param  nage oldest age
 **/
-dvector BaranovCatchEquation::getFishingMortality(const dvector &ct, const double &m, const dmatrix &V, const dvector &na)
+void BaranovCatchEquation::allocateWorkspace(const int& ngear, const int& nsex, const int& sage, const int& nage)
 {
-	
-	int i,j,its;
-	int ngear = V.rowmax()-V.rowmin()+1;
+	if( allocated(m_ft) && m_ft.indexmax() == ngear
+		&& m_ba.rowmax() == nsex && m_ba.colmin() == sage && m_ba.colmax() == nage )
+	{
+		return;
+	}
+	m_ft.deallocate();
+	m_chat.deallocate();
+	m_fx.deallocate();
+	m_G.deallocate();
+	m_ba.deallocate();
+	m_hCt.deallocate();
+
+	m_ft.allocate(1,ngear);
+	m_chat.allocate(1,ngear);
+	m_fx.allocate(1,ngear);
+	m_G.allocate(1,ngear,1,ngear);
+	m_ba.allocate(1,nsex,sage,nage);
+	m_hCt.allocate(1,nsex,1,ngear);
+}
 
-	dvector   ft(1,ngear);
-	dvector chat(1,ngear);
-	dvector ctmp(1,ngear);
-	dvector   fx(1,ngear);
-	dmatrix    J(1,ngear,1,ngear);
-	dmatrix invJ(1,ngear,1,ngear);
-	dvector   ba(na.indexmin(),na.indexmax());
-	dmatrix    F(1,ngear,V.colmin(),V.colmax());
-	
+
+/** \brief Solve m_G x = m_fx in place.
 	
+	LU decomposition with partial pivoting of the Jacobian (m_G is
+	overwritten by the factors), the solution is returned in m_fx.
+	Replaces the explicit inv(J) in the Newton step.
+**/
+void BaranovCatchEquation::luSolve()
+{
+	int i,j,k,p;
+	int n = m_G.rowmax();
+	for( k = 1; k <= n; k++ )
+	{
+		p = k;
+		for( i = k+1; i <= n; i++ )
+		{
+			if( fabs(m_G(i,k)) > fabs(m_G(p,k)) ) p = i;
+		}
+		if( p != k )
+		{
+			for( j = 1; j <= n; j++ )
+			{
+				double tmp = m_G(k,j);
+				m_G(k,j)   = m_G(p,j);
+				m_G(p,j)   = tmp;
+			}
+			double tmp = m_fx(k);
+			m_fx(k)    = m_fx(p);
+			m_fx(p)    = tmp;
+		}
+		for( i = k+1; i <= n; i++ )
+		{
+			double lik = m_G(i,k) / m_G(k,k);
+			for( j = k+1; j <= n; j++ )
+			{
+				m_G(i,j) -= lik * m_G(k,j);
+			}
+			m_fx(i) -= lik * m_fx(k);
+		}
+	}
+	for( i = n; i >= 1; i-- )
+	{
+		for( j = i+1; j <= n; j++ )
+		{
+			m_fx(i) -= m_G(i,j) * m_fx(j);
+		}
+		m_fx(i) /= m_G(i,i);
+	}
+}
+
+
+/** \brief Newton-Raphson solution of the Baranov catch equation.
 	
-	// Initial guess for fishing mortality rates;
-	ba        = na; //elem_prod(na,wa);
-	double bt = sum(na * exp(-0.5*m));
-	ft        = ct / bt;
+		Finds the vector of fishing mortality rates (ft) that predicts the
+		catch for each gear, summed over sexes:
 		
-	// Iterative soln for catch equation using Newton-Raphson
-	for(its=1; its<=MAXITS; its++)
-	{
-		for(i=1;i<=ngear;i++) F(i) =ft(i)*V(i);
+		\f$ C_k = \sum_h \sum_a \frac{F_k V_{hka} B_{ha} (1-exp(-Z_{ha}))}{Z_{ha}} \f$
 		
-		dvector za = m + colsum(F);
-		dvector sa = exp(-za);
-		dvector oa = (1.-sa);
+		where B = N (catch in numbers) or B = N*W (catch in weight).  With
+		fx = ct - chat and G(k,l) = d(fx_k)/d(F_l) the Newton step is
+		F -= G^{-1} fx, computed with an LU solve.  Each age contributes
 		
-		for(i=1;i<=ngear;i++)
+		  G(k,k) -= B V_k (1-S)/Z
+		  G(k,l) += F_k B V_k V_l ((1-S)/Z - S)/Z
+		
+		Iterations stop when norm(fx) < TOL or max(ft) > MAXF; ft is then
+		truncated at MAXF.  The catch by sex and gear from the last
+		iteration is kept in m_hCt, and the iterations, residual norm and
+		clipping are kept in m_result and added to the global counters.
+	
+	\param  ct a vector of catches, 1 element for each gear.
+	\param  ma natural mortality accessor ma(h,a).
+	\param  V selectivity accessor V(h,k,a).
+	\param  na numbers-at-age accessor na(h,a).
+	\param  wa weight-at-age accessor wa(h,a).
+	\return Returns a vector of instantaneous fishing mortality rates.
+**/
+template<class M_t, class V_t, class N_t, class W_t>
+dvector BaranovCatchEquation::solve(const dvector &ct, const M_t &ma, const V_t &V, const N_t &na, const W_t &wa)
+{
+	int h,j,k,l,its;
+	int ngear = size_count(ct);
+	int nsex  = na.nsex();
+	int sage  = na.sage();
+	int nage  = na.nage();
+	int c0    = ct.indexmin() - 1;
+
+	allocateWorkspace(ngear,nsex,sage,nage);
+
+	// Initial guess for fishing mortality rates based on Pope's approximation;
+	m_ft.initialize();
+	for( h = 1; h <= nsex; h++ )
+	{
+		for( j = sage; j <= nage; j++ )
 		{
-			for(j=1;j<=ngear;j++)
+			m_ba(h,j) = na(h,j) * wa(h,j);
+			double bt = m_ba(h,j) * exp(-0.5*ma(h,j));
+			for( k = 1; k <= ngear; k++ )
 			{
-				if(i==j)
+				m_ft(k) += V.pope(h,k,j) * bt;
+			}
+		}
+	}
+	for( k = 1; k <= ngear; k++ )
+	{
+		m_ft(k) = ct(c0+k) / m_ft(k);
+	}
+
+	// Iterative soln for catch equation using Newton-Raphson
+	double fnorm = 0;
+	for( its = 1; its <= MAXITS; its++ )
+	{
+		m_G.initialize();
+		m_chat.initialize();
+		m_hCt.initialize();
+		for( h = 1; h <= nsex; h++ )
+		{
+			for( j = sage; j <= nage; j++ )
+			{
+				double z = ma(h,j);
+				for( k = 1; k <= ngear; k++ )
 				{
-					dvector k1   =  elem_prod(ba,elem_div(V(i),za));
-					dvector k2   =  elem_prod(k1,V(i));
-					dvector k3   =  elem_div(k2,za);
-					double dCdF  = -(k1*oa) - ft(i)*(k2*sa) + ft(i)*(k3*oa);
-					J(i)(j)      = dCdF;
-					chat(i)      = (ft(i)*k1) * oa;
+					z += m_ft(k) * V(h,k,j);
 				}
-				else
+				double s = exp(-z);
+				double o = 1.0 - s;
+				double b = m_ba(h,j) / z;
+				double e = (o/z - s);
+				for( k = 1; k <= ngear; k++ )
 				{
-					dvector t1   = elem_div(elem_prod(ft(i)*ba,V(i)),za);
-					dvector t2   = elem_prod(t1,V(j));
-					dvector t3   = elem_div(t2,za);
-					double dCdF  = -(t2*sa) + (t3*oa);
-					J(j)(i)      = dCdF;
+					double gk   = b * V(h,k,j);
+					double ck   = m_ft(k) * gk * o;
+					m_hCt(h,k) += ck;
+					m_chat(k)  += ck;
+					m_G(k,k)   -= gk * o;
+					double fge  = m_ft(k) * gk * e;
+					for( l = 1; l <= ngear; l++ )
+					{
+						m_G(k,l) += fge * V(h,l,j);
+					}
 				}
-			}	
+			}
+		}  // end of sex
+
+		fnorm = 0;
+		for( k = 1; k <= ngear; k++ )
+		{
+			m_fx(k) = ct(c0+k) - m_chat(k);
+			fnorm  += m_fx(k) * m_fx(k);
 		}
-		fx   = ct - chat;
-		//The following couts were used to debug the transpose error in the Jacobian.
+		fnorm = sqrt(fnorm);
+
+		luSolve();
+		double fmax = m_ft(1) - m_fx(1);
+		for( k = 1; k <= ngear; k++ )
+		{
+			m_ft(k) -= m_fx(k);
+			if( m_ft(k) > fmax ) fmax = m_ft(k);
+		}
+
+		if( fnorm < TOL || fmax > MAXF ) break;
+	}
+
+	m_result.iterations = its > MAXITS ? MAXITS : its;
+	m_result.fnorm      = fnorm;
+	m_result.converged  = fnorm < TOL;
+	m_result.clipped    = false;
+	dvector ft(1,ngear);
+	for( k = 1; k <= ngear; k++ )
+	{
+		if( m_ft(k) > MAXF ) m_result.clipped = true;
+		ft(k) = m_ft(k) > MAXF ? MAXF : m_ft(k);
+	}
+	record(m_result);
+	return (ft);
+}
+
+
+
+/** \brief Jacobian of the predicted catch with respect to ft.
+	
+		J(k,l) = dC_k/dF_l evaluated at ft, using the same terms as the Newton
+		iterations in solve (J = -G):
 		
-		//LOG<<"fx = "<<fx<<'\n';
-		// LOG<<"Jacobian\t"<<"its = "<<its<<'\n'<<J<<'\n';
-		invJ = -inv(J);
-		ft  += fx*invJ;
+		  J(k,k) += B V_k (1-S)/Z
+		  J(k,l) -= F_k B V_k V_l ((1-S)/Z - S)/Z
 		
-		if( norm(fx) < TOL || max(ft) > MAXF ) break;
+		If ft solves C(ft) = ct, then by the implicit function theorem
+		dft/dtheta = -J^{-1} d(C - ct)/dtheta for any other model parameter.
+	
+	\param  ft fishing mortality rate for each gear.
+	\param  ma natural mortality accessor ma(h,a).
+	\param  V selectivity accessor V(h,k,a).
+	\param  na numbers-at-age accessor na(h,a).
+	\param  wa weight-at-age accessor wa(h,a).
+	\return (ngear, ngear) matrix of dC_k/dF_l.
+**/
+template<class M_t, class V_t, class N_t, class W_t>
+dmatrix BaranovCatchEquation::jacobian(const dvector &ft, const M_t &ma, const V_t &V, const N_t &na, const W_t &wa)
+{
+	int h,j,k,l;
+	int ngear = size_count(ft);
+	int f0    = ft.indexmin() - 1;
+	dmatrix J(1,ngear,1,ngear);
+	J.initialize();
+	for( h = 1; h <= na.nsex(); h++ )
+	{
+		for( j = na.sage(); j <= na.nage(); j++ )
+		{
+			double z = ma(h,j);
+			for( k = 1; k <= ngear; k++ )
+			{
+				z += ft(f0+k) * V(h,k,j);
+			}
+			double s = exp(-z);
+			double o = 1.0 - s;
+			double b = na(h,j) * wa(h,j) / z;
+			double e = (o/z - s);
+			for( k = 1; k <= ngear; k++ )
+			{
+				double gk  = b * V(h,k,j);
+				J(k,k)    += gk * o;
+				double fge = ft(f0+k) * gk * e;
+				for( l = 1; l <= ngear; l++ )
+				{
+					J(k,l) -= fge * V(h,l,j);
+				}
+			}
+		}
+	}
+	return J;
+}
+
+void BaranovStats::reset()
+{
+	calls         = 0;
+	iterations    = 0;
+	maxIterations = 0;
+	unconverged   = 0;
+	clipped       = 0;
+	maxFnorm      = 0;
+	for( int i = 0; i <= MAXITS; i++ ) histogram[i] = 0;
+}
+
+void BaranovStats::add(const BaranovResult& r)
+{
+	calls++;
+	iterations += r.iterations;
+	if( r.iterations > maxIterations ) maxIterations = r.iterations;
+	if( !r.converged ) unconverged++;
+	if( r.clipped ) clipped++;
+	if( r.fnorm > maxFnorm ) maxFnorm = r.fnorm;
+	histogram[r.iterations]++;
+}
+
+void BaranovStats::add(const BaranovStats& s)
+{
+	calls       += s.calls;
+	iterations  += s.iterations;
+	unconverged += s.unconverged;
+	clipped     += s.clipped;
+	if( s.maxIterations > maxIterations ) maxIterations = s.maxIterations;
+	if( s.maxFnorm > maxFnorm ) maxFnorm = s.maxFnorm;
+	for( int i = 0; i <= MAXITS; i++ ) histogram[i] += s.histogram[i];
+}
+
+/** \brief Write the counters as a short report.
+
+	The histogram lists only the iteration counts that occurred.  Solves
+	at MAXITS without convergence, and clipped solves, point to poor
+	starting values or to catches the population cannot support.
+**/
+void BaranovStats::write(ostream& os) const
+{
+	os<<"# Baranov catch equation solver diagnostics\n";
+	os<<"# TOL = "<<TOL<<", MAXITS = "<<MAXITS<<", MAXF = "<<MAXF<<'\n';
+	os<<"calls          "<<calls<<'\n';
+	os<<"iterations     "<<iterations<<'\n';
+	os<<"mean_iter      "<<(calls ? double(iterations)/calls : 0.0)<<'\n';
+	os<<"max_iter       "<<maxIterations<<'\n';
+	os<<"unconverged    "<<unconverged<<'\n';
+	os<<"clipped        "<<clipped<<'\n';
+	os<<"max_fnorm      "<<maxFnorm<<'\n';
+	os<<"# iterations  count\n";
+	for( int i = 0; i <= MAXITS; i++ )
+	{
+		if( histogram[i] ) os<<i<<"  "<<histogram[i]<<'\n';
 	}
+}
+
+
+/** \brief Add one solve to the process-wide counters. **/
+void BaranovCatchEquation::record(const BaranovResult& r)
+{
+	std::lock_guard<std::mutex> lock(statsMutex);
+	stats.add(r);
+}
+
+/** \brief Add the counters from a batch of solves to the process-wide counters. **/
+void BaranovCatchEquation::record(const BaranovStats& s)
+{
+	std::lock_guard<std::mutex> lock(statsMutex);
+	stats.add(s);
+}
+
+BaranovStats BaranovCatchEquation::getStats()
+{
+	std::lock_guard<std::mutex> lock(statsMutex);
+	return stats;
+}
+
+void BaranovCatchEquation::resetStats()
+{
+	std::lock_guard<std::mutex> lock(statsMutex);
+	stats.reset();
+}
+
+void BaranovCatchEquation::writeStats(ostream& os)
+{
+	getStats().write(os);
+}
+
+
+
+/** \brief Baranov catch equation solution for 1 or more fleets.
 	
-	for(i=1;i<=ngear;i++) if(ft(i)>MAXF) ft(i) = MAXF;
+		The following function solves the Baranov catch equation for multiple fleets using
+		a Newton-Raphson alogrithm to find a vector of fishing mortlity rates (ft) that 
+		predicts the total catch for each fleet.
+		
+		BARANOV CATCH EQUATION:
+		\f$ C = \frac{FN(1-exp(-Z))}{Z} \f$
+
+	\author Martell IPHC
+	\date 2012-08-05
+	\param  ct a vector of observed catches, 1 element for each gear.
+	\param  m instananeous natural mortality rate.
+	\param  V a matrix of selectivities (row for each gear, col for each age)
+	\param  na a vector of numbers-at-age at the start of each year
 	
-	return (ft);
+	\return Returns a vector of instantaneous fishing mortality rates.
+	\sa solve
+**/
+dvector BaranovCatchEquation::getFishingMortality(const dvector &ct, const double &m, const dmatrix &V, const dvector &na)
+{
+	ScalarM M = {m};
+	GearV   S = {V};
+	VectorN N = {na};
+	NoW     W;
+	return solve(ct,M,S,N,W);
 }
 
 
@@ -108,8 +484,7 @@ dvector BaranovCatchEquation::getFishingMortality(const dvector &ct, const doubl
 	
 		The following function solves the Baranov catch equation for multiple fleets using
 		a Newton-Raphson alogrithm to find a vector of fishing mortlity rates (ft) that 
-		predicts the total catch for each fleet.  The Jacobian matrix is computed and 
-		subsequently inverted to compute the Newton step for each fishing rate.
+		predicts the total catch for each fleet.
 	
 	\author Martell IPHC
 	\date 2012-08-05
@@ -119,75 +494,15 @@ dvector BaranovCatchEquation::getFishingMortality(const dvector &ct, const doubl
 	\param  na a vector of numbers-at-age at the start of each year
 	\param  wa a vector of mean weight-at-age.
 	\return Returns a vector of instantaneous fishing mortality rates.
-	\sa
+	\sa solve
 **/
 dvector BaranovCatchEquation::getFishingMortality(const dvector &ct, const double &m, const dmatrix &V, const dvector &na, const dvector &wa)
 {
-	
-	int i,j,its;
-	int ngear = V.rowmax()-V.rowmin()+1;
-
-	dvector   ft(1,ngear);
-	dvector chat(1,ngear);
-	dvector ctmp(1,ngear);
-	dvector   fx(1,ngear);
-	dmatrix    J(1,ngear,1,ngear);
-	dmatrix invJ(1,ngear,1,ngear);
-	dvector   ba(na.indexmin(),na.indexmax());
-	dmatrix    F(1,ngear,V.colmin(),V.colmax());
-	
-	
-	
-	// Initial guess for fishing mortality rates;
-	ba        = elem_prod(na,wa);
-	double bt = (na * exp(-0.5*m)) * wa;
-	ft        = ct / bt;
-		
-	// Iterative soln for catch equation using Newton-Raphson
-	for(its=1; its<=MAXITS; its++)
-	{
-		for(i=1;i<=ngear;i++) F(i) =ft(i)*V(i);
-		
-		dvector za = m + colsum(F);
-		dvector sa = exp(-za);
-		dvector oa = (1.-sa);
-		
-		for(i=1;i<=ngear;i++)
-		{
-			for(j=1;j<=ngear;j++)
-			{
-				if(i==j)
-				{
-					dvector k1   =  elem_prod(ba,elem_div(V(i),za));
-					dvector k2   =  elem_prod(k1,V(i));
-					dvector k3   =  elem_div(k2,za);
-					double dCdF  = -(k1*oa) - ft(i)*(k2*sa) + ft(i)*(k3*oa);
-					J(i)(j)      = dCdF;
-					chat(i)      = (ft(i)*k1) * oa;
-				}
-				else
-				{
-					dvector t1   = elem_div(elem_prod(ft(i)*ba,V(i)),za);
-					dvector t2   = elem_prod(t1,V(j));
-					dvector t3   = elem_div(t2,za);
-					double dCdF  = -(t2*sa) + (t3*oa);
-					J(j)(i)      = dCdF;
-				}
-			}	
-		}
-		fx   = ct - chat;
-		//The following couts were used to debug the transpose error in the Jacobian.
-		//LOG<<"fx = "<<fx<<'\n';
-		//LOG<<"Jacobian\t"<<"its = "<<its<<'\n'<<J<<'\n';
-		invJ = -inv(J);
-		ft  += fx*invJ;
-		
-		if( norm(fx) < TOL || max(ft) > MAXF ) break;
-	}
-	
-	for(i=1;i<=ngear;i++) if(ft(i)>MAXF) ft(i) = MAXF;
-	
-	return (ft);
+	ScalarM M = {m};
+	GearV   S = {V};
+	VectorN N = {na};
+	VectorW W = {wa};
+	return solve(ct,M,S,N,W);
 }
 
 
@@ -196,8 +511,7 @@ dvector BaranovCatchEquation::getFishingMortality(const dvector &ct, const doubl
 	
 		The following function solves the Baranov catch equation for multiple fleets using
 		a Newton-Raphson alogrithm to find a vector of fishing mortlity rates (ft) that 
-		predicts the total catch for each fleet.  The Jacobian matrix is computed and 
-		subsequently inverted to compute the Newton step for each fishing rate.
+		predicts the total catch for each fleet.
 	
 	\author Martell IPHC
 	\date 2012-08-05
@@ -207,76 +521,15 @@ dvector BaranovCatchEquation::getFishingMortality(const dvector &ct, const doubl
 	\param  na a vector of numbers-at-age at the start of each year
 	
 	\return Returns a vector of instantaneous fishing mortality rates.
-	\sa
+	\sa solve
 **/
-
 dvector BaranovCatchEquation::getFishingMortality(const dvector &ct, const dvector &ma, const dmatrix &V, const dvector &na)
 {
-	
-	int i,j,its;
-	int ngear = V.rowmax()-V.rowmin()+1;
-
-	dvector   ft(1,ngear);
-	dvector chat(1,ngear);
-	dvector ctmp(1,ngear);
-	dvector   fx(1,ngear);
-	dmatrix    J(1,ngear,1,ngear);
-	dmatrix invJ(1,ngear,1,ngear);
-	dvector   ba(na.indexmin(),na.indexmax());
-	dmatrix    F(1,ngear,V.colmin(),V.colmax());
-	
-	
-	
-	// Initial guess for fishing mortality rates;
-	ba        = na; //elem_prod(na,wa);
-	double bt = sum(elem_prod(na , exp(-0.5*ma)));
-	ft        = ct / bt;
-		
-	// Iterative soln for catch equation using Newton-Raphson
-	for(its=1; its<=MAXITS; its++)
-	{
-		for(i=1;i<=ngear;i++) F(i) =ft(i)*V(i);
-		
-		dvector za = ma + colsum(F);
-		dvector sa = exp(-za);
-		dvector oa = (1.-sa);
-		
-		for(i=1;i<=ngear;i++)
-		{
-			for(j=1;j<=ngear;j++)
-			{
-				if(i==j)
-				{
-					dvector k1   =  elem_prod(ba,elem_div(V(i),za));
-					dvector k2   =  elem_prod(k1,V(i));
-					dvector k3   =  elem_div(k2,za);
-					double dCdF  = -(k1*oa) - ft(i)*(k2*sa) + ft(i)*(k3*oa);
-					J(i)(j)      = dCdF;
-					chat(i)      = (ft(i)*k1) * oa;
-				}
-				else
-				{
-					dvector t1   = elem_div(elem_prod(ft(i)*ba,V(i)),za);
-					dvector t2   = elem_prod(t1,V(j));
-					dvector t3   = elem_div(t2,za);
-					double dCdF  = -(t2*sa) + (t3*oa);
-					J(j)(i)      = dCdF;
-				}
-			}	
-		}
-		fx   = ct - chat;
-		//The following couts were used to debug the transpose error in the Jacobian.
-		//LOG<<"fx = "<<fx<<'\n';
-		//LOG<<"Jacobian\t"<<"its = "<<its<<'\n'<<J<<'\n';
-		invJ = -inv(J);
-		ft  += fx*invJ;
-		
-		if( norm(fx) < TOL || max(ft) > MAXF ) break;
-	}
-	
-	for(i=1;i<=ngear;i++) if(ft(i)>MAXF) ft(i) = MAXF;
-	
-	return (ft);
+	VectorM M = {ma};
+	GearV   S = {V};
+	VectorN N = {na};
+	NoW     W;
+	return solve(ct,M,S,N,W);
 }
 
 
@@ -286,8 +539,7 @@ dvector BaranovCatchEquation::getFishingMortality(const dvector &ct, const dvect
 	
 		The following function solves the Baranov catch equation for multiple fleets using
 		a Newton-Raphson alogrithm to find a vector of fishing mortlity rates (ft) that 
-		predicts the total catch for each fleet.  The Jacobian matrix is computed and 
-		subsequently inverted to compute the Newton step for each fishing rate.
+		predicts the total catch for each fleet.
 	
 	\author Martell IPHC
 	\date 2012-08-05
@@ -297,75 +549,15 @@ dvector BaranovCatchEquation::getFishingMortality(const dvector &ct, const dvect
 	\param  na a vector of numbers-at-age at the start of each year
 	\param  wa a vector of mean weight-at-age.
 	\return Returns a vector of instantaneous fishing mortality rates.
-	\sa
+	\sa solve
 **/
 dvector BaranovCatchEquation::getFishingMortality(const dvector &ct, const dvector &ma, const dmatrix &V, const dvector &na, const dvector &wa)
 {
-	
-	int i,j,its;
-	int ngear = V.rowmax()-V.rowmin()+1;
-
-	dvector   ft(1,ngear);
-	dvector chat(1,ngear);
-	dvector ctmp(1,ngear);
-	dvector   fx(1,ngear);
-	dmatrix    J(1,ngear,1,ngear);
-	dmatrix invJ(1,ngear,1,ngear);
-	dvector   ba(na.indexmin(),na.indexmax());
-	dmatrix    F(1,ngear,V.colmin(),V.colmax());
-	
-	
-	
-	// Initial guess for fishing mortality rates;
-	ba        = elem_prod(na,wa);
-	double bt = elem_prod(na , exp(-0.5*ma)) * wa;
-	ft        = ct / bt;
-		
-	// Iterative soln for catch equation using Newton-Raphson
-	for(its=1; its<=MAXITS; its++)
-	{
-		for(i=1;i<=ngear;i++) F(i) =ft(i)*V(i);
-		
-		dvector za = ma + colsum(F);
-		dvector sa = exp(-za);
-		dvector oa = (1.-sa);
-		
-		for(i=1;i<=ngear;i++)
-		{
-			for(j=1;j<=ngear;j++)
-			{
-				if(i==j)
-				{
-					dvector k1   =  elem_prod(ba,elem_div(V(i),za));
-					dvector k2   =  elem_prod(k1,V(i));
-					dvector k3   =  elem_div(k2,za);
-					double dCdF  = -(k1*oa) - ft(i)*(k2*sa) + ft(i)*(k3*oa);
-					J(i)(j)      = dCdF;
-					chat(i)      = (ft(i)*k1) * oa;
-				}
-				else
-				{
-					dvector t1   = elem_div(elem_prod(ft(i)*ba,V(i)),za);
-					dvector t2   = elem_prod(t1,V(j));
-					dvector t3   = elem_div(t2,za);
-					double dCdF  = -(t2*sa) + (t3*oa);
-					J(j)(i)      = dCdF;
-				}
-			}	
-		}
-		fx   = ct - chat;
-		//The following couts were used to debug the transpose error in the Jacobian.
-		//LOG<<"fx = "<<fx<<'\n';
-		//LOG<<"Jacobian\t"<<"its = "<<its<<'\n'<<J<<'\n';
-		invJ = -inv(J);
-		ft  += fx*invJ;
-		
-		if( norm(fx) < TOL || max(ft) > MAXF ) break;
-	}
-	// | DO NOT DO THE FOLLOWING FOR DIFFERENTIABLE PROBLEMS.
-	for(i=1;i<=ngear;i++) if(ft(i)>MAXF) ft(i) = MAXF;
-	
-	return (ft);
+	VectorM M = {ma};
+	GearV   S = {V};
+	VectorN N = {na};
+	VectorW W = {wa};
+	return solve(ct,M,S,N,W);
 }
 
 
@@ -386,10 +578,11 @@ dvector BaranovCatchEquation::getFishingMortality(const dvector &ct, const dvect
 double BaranovCatchEquation::get_ft(const double& ct, const double& m, const dvector& va, const dvector& ba)
 {
 	double ft;
+	int its;
 	//initial guess for ft
 	ft=ct/(va*(ba*exp(-m/2.)));
 	
-	for(int i=1;i<=50;i++)
+	for(its=1;its<=50;its++)
 	{
 		dvector f = ft*va;
 		dvector z = m+f;
@@ -408,10 +601,15 @@ double BaranovCatchEquation::get_ft(const double& ct, const double& m, const dve
 			- elem_div(elem_prod(f,t3),square(z))
 			+ elem_prod(elem_prod(t1,s),ba));
 		
+		m_result.fnorm = fabs(pct-ct);
+		if(m_result.fnorm<TOL) break;
 		ft -= (pct-ct)/dct;  //newton step
-		//if(fabs(pct-ct)<1.e-9) break; //do not use for dvariables
 	}
 	
+	m_result.iterations = its>50 ? 50 : its;
+	m_result.converged  = m_result.fnorm < TOL;
+	m_result.clipped    = false;
+	record(m_result);
 	return(ft);
 }
 
@@ -419,13 +617,14 @@ double BaranovCatchEquation::get_ft(const double& ct, const double& m, const dve
 double BaranovCatchEquation::get_ftdd(const double& ct, const double& m, const double& b)
 {
 	double ft;
+	int its;
 	//initial guess for ft
 	if(ct<b){
 		//initial guess for ft
 		ft=ct/(b*exp(-m/2.));
 
 	
-		for(int i=1;i<=50;i++)
+		for(its=1;its<=50;its++)
 		{
 			double f = ft;
 			double z = m+f;
@@ -445,11 +644,21 @@ double BaranovCatchEquation::get_ftdd(const double& ct, const double& m, const d
 			//	- elem_div(elem_prod(f,t3),square(z))
 			//	+ elem_prod(elem_prod(t1,s),ba));
 			
+			m_result.fnorm = fabs(pct-ct);
+			if(m_result.fnorm<TOL) break;
 			ft -= (pct-ct)/dct;  //newton step
-			//if(fabs(pct-ct)<1.e-9) break; //do not use for dvariables
 		}
-	} else	ft = 20.0;  //Set F very high if tac predicted greater than biomass  - prevents
-
+		m_result.iterations = its>50 ? 50 : its;
+		m_result.converged  = m_result.fnorm < TOL;
+		m_result.clipped    = false;
+	} else{
+		ft = 20.0;  //Set F very high if tac predicted greater than biomass  - prevents
+		m_result.iterations = 0;
+		m_result.fnorm      = ct - b;
+		m_result.converged  = false;
+		m_result.clipped    = true;
+	}
+	record(m_result);
 	
 	return(ft);
 }
@@ -468,97 +677,15 @@ double BaranovCatchEquation::get_ftdd(const double& ct, const double& m, const d
 	\param  _V a pointer to a d3_array for age-gear-sex-specific selectivity.
 	\param  na a matrix of numbers-at-age.
 	\return description of return value
-	\sa
+	\sa solve
 **/
 dvector BaranovCatchEquation::getFishingMortality(const dvector &ct, const dmatrix &ma, const d3_array *_V, const dmatrix &na)
 {
-
-	int h,i,j,k,its;
-	d3_array V;
-	V.allocate(*_V); //V(1,nsex,1,ngear,1,nage)
-	V = *_V;
-
-	int ngear = size_count(ct);
-	int nsex  = ma.rowmax() - ma.rowmin() + 1;
-
-	dvector   ft(1,ngear);
-	dvector chat(1,ngear);
-	// dvector ctmp(1,ngear);
-	dvector   fx(1,ngear);
-	dmatrix    J(1,ngear,1,ngear);
-	dmatrix invJ(1,ngear,1,ngear);
-	dvector ntmp(1,ngear);
-	dmatrix   ba(1,nsex,na.colmin(),na.colmax());
-	d3_array   F(1,nsex,1,ngear,na.colmin(),na.colmax());
-	m_hCt.allocate(1,nsex,1,ngear);
-	m_hCt.initialize();
-	
-	
-	// Initial guess for fishing mortality rates based on Pope's approximation;
-	ntmp.initialize();
-	for( k = 1; k <= ngear; k++ )
-	{
-		for( h = 1; h <= nsex; h++ )
-		{
-			ntmp(k) +=  elem_prod(na(h),V(h)(k)) * ( exp(-0.5*ma(h)) );
-		}
-	}
-	ft = elem_div(ct,ntmp);
-	ba = na; //elem_prod(na,wa);
-		
-	// Iterative soln for catch equation using Newton-Raphson
-	for(its=1; its<=MAXITS; its++)
-	{
-		J.initialize();
-		chat.initialize();
-		for( h = 1; h <= nsex; h++ )
-		{
-			 
-			for(i=1;i<=ngear;i++) F(h)(i) =ft(i)*V(h)(i);
-			
-			dvector za = ma(h) + colsum(F(h));
-			dvector sa = exp(-za);
-			dvector oa = (1.-sa);
-			
-			for(i=1;i<=ngear;i++)
-			{
-				for(j=1;j<=ngear;j++)
-				{
-					if(i==j)
-					{
-						dvector k1   =  elem_prod(ba(h),elem_div(V(h)(i),za));
-						dvector k2   =  elem_prod(k1,V(h)(i));
-						dvector k3   =  elem_div(k2,za);
-						double dCdF  = -(k1*oa) - ft(i)*(k2*sa) + ft(i)*(k3*oa);
-						J(i)(j)     += dCdF;
-						chat(i)     += (ft(i)*k1) * oa;
-						m_hCt(h)(i)  = (ft(i)*k1) * oa;
-					}
-					else
-					{
-						dvector t1   = elem_div(elem_prod(ft(i)*ba(h),V(h)(i)),za);
-						dvector t2   = elem_prod(t1,V(h)(j));
-						dvector t3   = elem_div(t2,za);
-						double dCdF  = -(t2*sa) + (t3*oa);
-						J(j)(i)     += dCdF;
-					}
-				}	
-			}
-		}  // end of sex
-		fx   = ct - chat;
-		//The following couts were used to debug the transpose error in the Jacobian.
-		//LOG<<"fx = "<<fx<<'\n';
-		//LOG<<"Jacobian\t"<<"its = "<<its<<'\n'<<J<<'\n';
-		invJ = -inv(J);
-		ft  += fx*invJ;
-		
-		if( norm(fx) < TOL || max(ft) > MAXF ) break;
-	}
-	
-	for(i=1;i<=ngear;i++) if(ft(i)>MAXF) ft(i) = MAXF;
-	
-	return (ft);
-
+	MatrixM  M = {ma};
+	SexGearV S = {*_V};
+	MatrixN  N = {na};
+	NoW      W;
+	return solve(ct,M,S,N,W);
 }
 
 
@@ -576,98 +703,15 @@ dvector BaranovCatchEquation::getFishingMortality(const dvector &ct, const dmatr
 	\param  na a matrix of numbers-at-age.
 	\param  wa a matrix of weight-at-age.
 	\return description of return value
-	\sa
+	\sa solve
 **/
 dvector BaranovCatchEquation::getFishingMortality(const dvector &ct, const dmatrix &ma, const d3_array *_V, const dmatrix &na, const dmatrix &wa)
 {
-
-	int h,i,j,k,its;
-	d3_array V;
-	V.allocate(*_V); //V(1,nsex,1,ngear,1,nage)
-	V = *_V;
-
-	int ngear = size_count(ct);
-	int nsex  = ma.rowmax() - ma.rowmin() + 1;
-
-	dvector   ft(1,ngear);
-	dvector chat(1,ngear);
-	// dvector ctmp(1,ngear);
-	dvector   fx(1,ngear);
-	dmatrix    J(1,ngear,1,ngear);
-	dmatrix invJ(1,ngear,1,ngear);
-	dvector ntmp(1,ngear);
-	dmatrix   ba(1,nsex,na.colmin(),na.colmax());
-	d3_array   F(1,nsex,1,ngear,na.colmin(),na.colmax());
-	m_hCt.allocate(1,nsex,1,ngear);
-	m_hCt.initialize();
-	
-	
-	// Initial guess for fishing mortality rates based on Pope's approximation;
-	ba = elem_prod(na,wa);
-	ntmp.initialize();
-	for( k = 1; k <= ngear; k++ )
-	{
-		for( h = 1; h <= nsex; h++ )
-		{
-			ntmp(k) +=  elem_prod(na(h),V(h)(k)) * elem_prod(wa(h), exp(-0.5*ma(h)) );
-		}
-	}
-	ft = elem_div(ct,ntmp);
-		
-	// Iterative soln for catch equation using Newton-Raphson
-	for(its=1; its<=MAXITS; its++)
-	{
-		J.initialize();
-		chat.initialize();
-		for( h = 1; h <= nsex; h++ )
-		{
-			 
-			for(i=1;i<=ngear;i++) F(h)(i) =ft(i)*V(h)(i);
-			
-			dvector za = ma(h) + colsum(F(h));
-			dvector sa = exp(-za);
-			dvector oa = (1.-sa);
-			
-			for(i=1;i<=ngear;i++)
-			{
-				for(j=1;j<=ngear;j++)
-				{
-					if(i==j)
-					{
-						dvector k1   =  elem_prod(ba(h),elem_div(V(h)(i),za));
-						dvector k2   =  elem_prod(k1,V(h)(i));
-						dvector k3   =  elem_div(k2,za);
-						double dCdF  = -(k1*oa) - ft(i)*(k2*sa) + ft(i)*(k3*oa);
-						J(i)(j)     += dCdF;
-						chat(i)     += (ft(i)*k1) * oa;
-						// cout<<"CT = "<<(ft(i)*k1) * oa<<endl;
-						m_hCt(h)(i)  = (ft(i)*k1) * oa;
-					}
-					else
-					{
-						dvector t1   = elem_div(elem_prod(ft(i)*ba(h),V(h)(i)),za);
-						dvector t2   = elem_prod(t1,V(h)(j));
-						dvector t3   = elem_div(t2,za);
-						double dCdF  = -(t2*sa) + (t3*oa);
-						J(j)(i)     += dCdF;
-					}
-				}	
-			}
-		}  // end of sex
-		fx   = ct - chat;
-		//The following couts were used to debug the transpose error in the Jacobian.
-		//LOG<<"fx = "<<fx<<'\n';
-		//LOG<<"Jacobian\t"<<"its = "<<its<<'\n'<<J<<'\n';
-		invJ = -inv(J);
-		ft  += fx*invJ;
-		
-		if( norm(fx) < TOL || max(ft) > MAXF ) break;
-	}
-	
-	for(i=1;i<=ngear;i++) if(ft(i)>MAXF) ft(i) = MAXF;
-	
-	return (ft);
-
+	MatrixM  M = {ma};
+	SexGearV S = {*_V};
+	MatrixN  N = {na};
+	MatrixW  W = {wa};
+	return solve(ct,M,S,N,W);
 }
 
 
@@ -690,6 +734,7 @@ dvector BaranovCatchEquation::getFishingMortality(const dvector &ct, const dmatr
 dvector BaranovCatchEquation::getFishingMortality(const dvector &ct, const dmatrix &ma, const d3_array *p_V, const dmatrix &na, dmatrix &_hCt)
 {
 	dvector ft = getFishingMortality(ct,ma,p_V,na);
+	if( !allocated(_hCt) ) _hCt.allocate(m_hCt);
 	_hCt = m_hCt;
 	return(ft);
 }
@@ -715,11 +760,48 @@ dvector BaranovCatchEquation::getFishingMortality(const dvector &ct, const dmatr
 dvector BaranovCatchEquation::getFishingMortality(const dvector &ct, const dmatrix &ma, const d3_array *p_V, const dmatrix &na, const dmatrix &wa, dmatrix &_hCt)
 {
 	dvector ft = getFishingMortality(ct,ma,p_V,na,wa);
+	if( !allocated(_hCt) ) _hCt.allocate(m_hCt);
 	_hCt = m_hCt;
 	return(ft);
 }
 
 
+/** \brief dC/dF for the 2-sex catch equation with catch in numbers.
+	\param  ft fishing mortality rate for each gear.
+	\param  ma a matrix of age-specific natural mortality rates by sex.
+	\param  p_V a pointer to a d3_array of selectivity (sex, gear, age).
+	\param  na a matrix of numbers-at-age by sex.
+	\return (ngear, ngear) matrix of dC_k/dF_l.
+	\sa jacobian
+**/
+dmatrix BaranovCatchEquation::getCatchJacobian(const dvector &ft, const dmatrix &ma, const d3_array *p_V, const dmatrix &na)
+{
+	MatrixM  M = {ma};
+	SexGearV S = {*p_V};
+	MatrixN  N = {na};
+	NoW      W;
+	return jacobian(ft,M,S,N,W);
+}
+
+/** \brief dC/dF for the 2-sex catch equation with catch in weight.
+	\param  ft fishing mortality rate for each gear.
+	\param  ma a matrix of age-specific natural mortality rates by sex.
+	\param  p_V a pointer to a d3_array of selectivity (sex, gear, age).
+	\param  na a matrix of numbers-at-age by sex.
+	\param  wa a matrix of weight-at-age by sex.
+	\return (ngear, ngear) matrix of dC_k/dF_l.
+	\sa jacobian
+**/
+dmatrix BaranovCatchEquation::getCatchJacobian(const dvector &ft, const dmatrix &ma, const d3_array *p_V, const dmatrix &na, const dmatrix &wa)
+{
+	MatrixM  M = {ma};
+	SexGearV S = {*p_V};
+	MatrixN  N = {na};
+	MatrixW  W = {wa};
+	return jacobian(ft,M,S,N,W);
+}
+
+
 
 
 
@@ -0,0 +1,342 @@
+#include <cmath>
+#include "../../include/baranov_batch.h"
+#include "../../include/parallel.h"
+#include "../../include/Logger.h"
+
+/// Constructor, sizes the problem arrays; weights default to 1 (catch in numbers)
+BaranovBatch::BaranovBatch(const int& nprob, const int& ngear, const int& sage, const int& nage)
+:m_nprob(nprob),m_ngear(ngear),m_sage(sage),m_nage(nage),m_nages(nage-sage+1)
+{
+	m_ct.assign(m_ngear*m_nprob,0.0);
+	m_M.assign(m_nages*m_nprob,0.0);
+	m_V.assign(m_ngear*m_nages*m_nprob,0.0);
+	m_N.assign(m_nages*m_nprob,0.0);
+	m_W.assign(m_nages*m_nprob,1.0);
+	m_F.assign(m_ngear*m_nprob,0.0);
+	m_its.assign(m_nprob,0);
+	m_fail.assign(m_nprob,0);
+	m_fnorm.assign(m_nprob,0.0);
+	m_clip.assign(m_nprob,0);
+}
+
+
+/** \brief Fill problem p with catch in weight and age-dependent M.
+
+	\param  p problem index (1..nprob)
+	\param  ct catch for each gear
+	\param  ma natural mortality at age
+	\param  V selectivity (row for each gear, col for each age)
+	\param  na numbers-at-age
+	\param  wa weight-at-age
+**/
+void BaranovBatch::setProblem(const int& p, const dvector &ct, const dvector &ma, const dmatrix &V, const dvector &na, const dvector &wa)
+{
+	int a,k;
+	int c0 = ct.indexmin() - 1;
+	int v0 = V.rowmin() - 1;
+	for( k = 1; k <= m_ngear; k++ )
+	{
+		this->ct(p,k) = ct(c0+k);
+		for( a = m_sage; a <= m_nage; a++ )
+		{
+			this->V(p,k,a) = V(v0+k,a);
+		}
+	}
+	for( a = m_sage; a <= m_nage; a++ )
+	{
+		this->M(p,a) = ma(a);
+		this->N(p,a) = na(a);
+		this->W(p,a) = wa(a);
+	}
+}
+
+/// Fill problem p with catch in numbers and age-dependent M.
+void BaranovBatch::setProblem(const int& p, const dvector &ct, const dvector &ma, const dmatrix &V, const dvector &na)
+{
+	setProblem(p,ct,ma,V,na,na);
+	for( int a = m_sage; a <= m_nage; a++ )
+	{
+		W(p,a) = 1.0;
+	}
+}
+
+/// Fill problem p with catch in weight and age-independent M.
+void BaranovBatch::setProblem(const int& p, const dvector &ct, const double &m, const dmatrix &V, const dvector &na, const dvector &wa)
+{
+	setProblem(p,ct,na,V,na,wa);
+	for( int a = m_sage; a <= m_nage; a++ )
+	{
+		M(p,a) = m;
+	}
+}
+
+
+/** \brief Solve every problem in the batch.
+
+	\param  threaded share the blocks of problems out over threads.
+**/
+void BaranovBatch::solve(const bool& threaded)
+{
+	int nblock = (m_nprob + BLOCK - 1) / BLOCK;
+	if( threaded )
+	{
+		parallel::for_each(0,nblock-1,[&](int b)
+		{
+			int p0 = b*BLOCK;
+			solveBlock(p0, p0+BLOCK < m_nprob ? p0+BLOCK : m_nprob);
+		});
+	}
+	else
+	{
+		for( int b = 0; b < nblock; b++ )
+		{
+			int p0 = b*BLOCK;
+			solveBlock(p0, p0+BLOCK < m_nprob ? p0+BLOCK : m_nprob);
+		}
+	}
+}
+
+
+/** \brief Newton-Raphson iterations for problems p0..p1-1 (0-based).
+
+	Same algebra as BaranovCatchEquation::solve, with each scalar replaced
+	by a row over the problems in the block.  The Jacobian is stored as
+	G[(k*ngear+l)*nb + b].  A problem stops updating once norm(fx) < TOL or
+	max(ft) > MAXF; the block stops when every problem has stopped.
+**/
+void BaranovBatch::solveBlock(const int& p0, const int& p1)
+{
+	const int nb = p1 - p0;
+	const int ng = m_ngear;
+	const int P  = m_nprob;
+	int a,b,i,j,k,l,its;
+
+	std::vector<double> chat(ng*nb), fx(ng*nb), G(ng*ng*nb);
+	std::vector<double> ba(m_nages*nb), z(nb), o(nb), bz(nb), e(nb), fge(nb), lik(nb);
+	std::vector<double> fnorm(nb), fmax(nb), gmax(nb);
+	std::vector<int>    piv(nb);
+	std::vector<char>   done(nb,0);
+
+	double *F = &m_F[p0];
+	for( b = 0; b < nb; b++ )
+	{
+		m_its[p0+b]  = 0;
+		m_fail[p0+b] = 0;
+	}
+
+	// Initial guess for fishing mortality rates;
+	for( k = 0; k < ng; k++ )
+	{
+		for( b = 0; b < nb; b++ ) F[k*P+b] = 0;
+	}
+	for( a = 0; a < m_nages; a++ )
+	{
+		const double *Na = &m_N[a*P+p0];
+		const double *Wa = &m_W[a*P+p0];
+		const double *Ma = &m_M[a*P+p0];
+		double *bA = &ba[a*nb];
+		for( b = 0; b < nb; b++ )
+		{
+			bA[b] = Na[b] * Wa[b];
+			z[b]  = bA[b] * exp(-0.5*Ma[b]);
+		}
+		for( k = 0; k < ng; k++ )
+		{
+			for( b = 0; b < nb; b++ ) F[k*P+b] += z[b];
+		}
+	}
+	for( k = 0; k < ng; k++ )
+	{
+		const double *ck = &m_ct[k*P+p0];
+		for( b = 0; b < nb; b++ ) F[k*P+b] = ck[b] / F[k*P+b];
+	}
+
+	// Iterative soln for catch equation using Newton-Raphson
+	for( its = 1; its <= MAXITS; its++ )
+	{
+		for( i = 0; i < ng*nb; i++ )    chat[i] = 0;
+		for( i = 0; i < ng*ng*nb; i++ ) G[i]    = 0;
+
+		for( a = 0; a < m_nages; a++ )
+		{
+			const double *Ma = &m_M[a*P+p0];
+			const double *bA = &ba[a*nb];
+			for( b = 0; b < nb; b++ ) z[b] = Ma[b];
+			for( k = 0; k < ng; k++ )
+			{
+				const double *Vk = &m_V[(k*m_nages+a)*P+p0];
+				for( b = 0; b < nb; b++ ) z[b] += F[k*P+b] * Vk[b];
+			}
+			for( b = 0; b < nb; b++ )
+			{
+				double s = exp(-z[b]);
+				o[b]  = 1.0 - s;
+				bz[b] = bA[b] / z[b];
+				e[b]  = o[b]/z[b] - s;
+			}
+			for( k = 0; k < ng; k++ )
+			{
+				const double *Vk = &m_V[(k*m_nages+a)*P+p0];
+				double *Gkk = &G[(k*ng+k)*nb];
+				double *ck  = &chat[k*nb];
+				for( b = 0; b < nb; b++ )
+				{
+					double gk = bz[b] * Vk[b];
+					ck[b]    += F[k*P+b] * gk * o[b];
+					Gkk[b]   -= gk * o[b];
+					fge[b]    = F[k*P+b] * gk * e[b];
+				}
+				for( l = 0; l < ng; l++ )
+				{
+					const double *Vl = &m_V[(l*m_nages+a)*P+p0];
+					double *Gkl = &G[(k*ng+l)*nb];
+					for( b = 0; b < nb; b++ ) Gkl[b] += fge[b] * Vl[b];
+				}
+			}
+		}
+
+		for( b = 0; b < nb; b++ ) fnorm[b] = 0;
+		for( k = 0; k < ng; k++ )
+		{
+			const double *ck = &m_ct[k*P+p0];
+			for( b = 0; b < nb; b++ )
+			{
+				fx[k*nb+b] = ck[b] - chat[k*nb+b];
+				fnorm[b]  += fx[k*nb+b] * fx[k*nb+b];
+			}
+		}
+
+		// Gaussian elimination with partial pivoting (as luSolve): G dx = fx
+		for( k = 0; k < ng; k++ )
+		{
+			double *Gkk = &G[(k*ng+k)*nb];
+			for( b = 0; b < nb; b++ )
+			{
+				piv[b]  = k;
+				gmax[b] = fabs(Gkk[b]);
+			}
+			for( i = k+1; i < ng; i++ )
+			{
+				const double *Gik = &G[(i*ng+k)*nb];
+				for( b = 0; b < nb; b++ )
+				{
+					if( fabs(Gik[b]) > gmax[b] )
+					{
+						piv[b]  = i;
+						gmax[b] = fabs(Gik[b]);
+					}
+				}
+			}
+			for( b = 0; b < nb; b++ )
+			{
+				if( piv[b] == k ) continue;
+				for( j = k; j < ng; j++ )
+				{
+					double tmp = G[(k*ng+j)*nb+b];
+					G[(k*ng+j)*nb+b]      = G[(piv[b]*ng+j)*nb+b];
+					G[(piv[b]*ng+j)*nb+b] = tmp;
+				}
+				double tmp = fx[k*nb+b];
+				fx[k*nb+b]      = fx[piv[b]*nb+b];
+				fx[piv[b]*nb+b] = tmp;
+			}
+			for( b = 0; b < nb; b++ )
+			{
+				if( Gkk[b] == 0 )
+				{
+					Gkk[b] = 1.0;
+					m_fail[p0+b] = 1;
+				}
+			}
+			for( i = k+1; i < ng; i++ )
+			{
+				double *Gik = &G[(i*ng+k)*nb];
+				for( b = 0; b < nb; b++ ) lik[b] = Gik[b] / Gkk[b];
+				for( j = k+1; j < ng; j++ )
+				{
+					double *Gij = &G[(i*ng+j)*nb];
+					double *Gkj = &G[(k*ng+j)*nb];
+					for( b = 0; b < nb; b++ ) Gij[b] -= lik[b] * Gkj[b];
+				}
+				for( b = 0; b < nb; b++ ) fx[i*nb+b] -= lik[b] * fx[k*nb+b];
+			}
+		}
+		for( i = ng-1; i >= 0; i-- )
+		{
+			for( j = i+1; j < ng; j++ )
+			{
+				double *Gij = &G[(i*ng+j)*nb];
+				for( b = 0; b < nb; b++ ) fx[i*nb+b] -= Gij[b] * fx[j*nb+b];
+			}
+			double *Gii = &G[(i*ng+i)*nb];
+			for( b = 0; b < nb; b++ ) fx[i*nb+b] /= Gii[b];
+		}
+
+		// Newton update for the problems that are still iterating; a problem
+		// with a zero pivot keeps its last valid iterate.
+		int nleft = 0;
+		for( b = 0; b < nb; b++ ) fmax[b] = F[b] - fx[b];
+		for( k = 0; k < ng; k++ )
+		{
+			for( b = 0; b < nb; b++ )
+			{
+				double fk = F[k*P+b] - fx[k*nb+b];
+				F[k*P+b]  = done[b] || m_fail[p0+b] ? F[k*P+b] : fk;
+				fmax[b]   = fk > fmax[b] ? fk : fmax[b];
+			}
+		}
+		for( b = 0; b < nb; b++ )
+		{
+			if( done[b] ) continue;
+			m_its[p0+b]   = its;
+			m_fnorm[p0+b] = sqrt(fnorm[b]);
+			if( sqrt(fnorm[b]) < TOL || fmax[b] > MAXF || m_fail[p0+b] ) done[b] = 1;
+			else nleft++;
+		}
+		if( !nleft ) break;
+	}
+
+	for( b = 0; b < nb; b++ ) m_clip[p0+b] = 0;
+	for( k = 0; k < ng; k++ )
+	{
+		for( b = 0; b < nb; b++ )
+		{
+			if( F[k*P+b] > MAXF )
+			{
+				F[k*P+b] = MAXF;
+				m_clip[p0+b] = 1;
+			}
+		}
+	}
+
+	BaranovStats bs;
+	for( b = 0; b < nb; b++ ) bs.add(getResult(p0+b+1));
+	BaranovCatchEquation::record(bs);
+}
+
+
+/** \brief Fishing mortality rates for problem p.
+	\param  p problem index (1..nprob)
+	\return vector of fishing mortality rates for each gear.
+**/
+dvector BaranovBatch::getFishingMortality(const int& p) const
+{
+	dvector ft(1,m_ngear);
+	for( int k = 1; k <= m_ngear; k++ )
+	{
+		ft(k) = getF(p,k);
+	}
+	return ft;
+}
+
+
+/** \brief Convergence record for problem p (1..nprob). **/
+BaranovResult BaranovBatch::getResult(const int& p) const
+{
+	BaranovResult r;
+	r.iterations = m_its[p-1];
+	r.fnorm      = m_fnorm[p-1];
+	r.converged  = !m_fail[p-1] && m_fnorm[p-1] < TOL;
+	r.clipped    = m_clip[p-1];
+	return r;
+}
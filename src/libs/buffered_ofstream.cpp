@@ -0,0 +1,328 @@
+#include <algorithm>
+#include <condition_variable>
+#include <csignal>
+#include <deque>
+#include <mutex>
+#include <thread>
+#ifndef _WIN32
+#include <pthread.h>
+#include <signal.h>
+#endif
+#include "../../include/buffered_ofstream.h"
+#include "../../include/Logger.h"
+
+/** \brief  Bounded single-producer/single-consumer queue of buffers to write
+
+	The producer is the main thread (AsyncBuf::submit), the consumer a
+	writer thread that is started with the first buffer.  At most
+	BufferedOfstream::QUEUESIZE buffers wait in the queue; written buffers
+	are kept for reuse so the producer does not allocate a new one each
+	time.
+**/
+class WriteQueue
+{
+private:
+	struct Job
+	{
+		std::filebuf*     file;
+		bool*             failed;
+		std::vector<char> data;
+		size_t            n;
+	};
+
+	std::mutex              m_mutex;
+	std::condition_variable m_ready;	//!< A job was queued, or m_stop
+	std::condition_variable m_done;		//!< A job was taken or written
+	std::deque<Job>         m_jobs;
+	std::vector< std::vector<char> > m_free;
+	bool                    m_busy;		//!< The writer is writing a job
+	bool                    m_stop;
+	std::thread             m_thread;
+
+	void run();
+
+public:
+	WriteQueue():m_busy(false),m_stop(false) {}
+	~WriteQueue();
+
+	void push(std::filebuf* file, bool* failed, std::vector<char>& data, const size_t& n);
+	void drain();
+};
+
+
+/// The queue shared by all BufferedOfstreams.
+static WriteQueue& writeQueue()
+{
+	static WriteQueue queue;
+	return queue;
+}
+
+
+/// Destructor, writes what is left in the queue and stops the writer.
+WriteQueue::~WriteQueue()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_ready.notify_one();
+	if( m_thread.joinable() ) m_thread.join();
+}
+
+
+/** \brief Queue the first n bytes of data for writing to file.
+
+	data is swapped with a free buffer (or an empty vector), so the caller
+	gets a buffer back to fill.  Waits while the queue is full.
+**/
+void WriteQueue::push(std::filebuf* file, bool* failed, std::vector<char>& data, const size_t& n)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	if( !m_thread.joinable() ) m_thread = std::thread(&WriteQueue::run, this);
+	while( m_jobs.size() >= BufferedOfstream::QUEUESIZE ) m_done.wait(lock);
+
+	m_jobs.push_back(Job());
+	Job& job  = m_jobs.back();
+	job.file   = file;
+	job.failed = failed;
+	job.n      = n;
+	job.data.swap(data);
+	if( !m_free.empty() )
+	{
+		data.swap(m_free.back());
+		m_free.pop_back();
+	}
+	lock.unlock();
+	m_ready.notify_one();
+}
+
+
+/** \brief Wait until every queued buffer has been written. **/
+void WriteQueue::drain()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while( !m_jobs.empty() || m_busy ) m_done.wait(lock);
+}
+
+
+/** \brief The writer thread: write the jobs in the order they were queued.
+
+	Signals are blocked in this thread so that SIGINT and SIGTERM are
+	handled by the other threads (BufferedOfstream::onSignal).
+**/
+void WriteQueue::run()
+{
+#ifndef _WIN32
+	sigset_t all;
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, 0);
+#endif
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for( ;; )
+	{
+		while( m_jobs.empty() && !m_stop ) m_ready.wait(lock);
+		if( m_jobs.empty() ) break;
+
+		Job job;
+		job.data.swap(m_jobs.front().data);
+		job.file   = m_jobs.front().file;
+		job.failed = m_jobs.front().failed;
+		job.n      = m_jobs.front().n;
+		m_jobs.pop_front();
+		m_busy = true;
+		lock.unlock();
+		m_done.notify_all();
+
+		std::streamsize n = static_cast<std::streamsize>(job.n);
+		bool ok = job.file->sputn(&job.data[0], n) == n;
+
+		lock.lock();
+		if( !ok ) *job.failed = true;
+		if( m_free.size() < BufferedOfstream::QUEUESIZE )
+		{
+			m_free.push_back(std::vector<char>());
+			m_free.back().swap(job.data);
+		}
+		m_busy = false;
+		m_done.notify_all();
+	}
+}
+
+
+/// Constructor, no file and no buffer.
+BufferedOfstream::AsyncBuf::AsyncBuf():m_failed(false)
+{
+}
+
+
+/** \brief Open the file unbuffered (the writes come in BUFSIZE blocks). **/
+bool BufferedOfstream::AsyncBuf::open(const char* filename, std::ios_base::openmode mode)
+{
+	if( m_buf.size() < BUFSIZE ) m_buf.resize(BUFSIZE);
+	m_failed = false;
+	m_file.pubsetbuf(0, 0);
+	if( !m_file.open(filename, mode | std::ios_base::out) ) return false;
+	setp(&m_buf[0], &m_buf[0] + m_buf.size());
+	return true;
+}
+
+
+/** \brief Queue the buffered characters for the writer thread. **/
+bool BufferedOfstream::AsyncBuf::submit()
+{
+	size_t n = pptr() - pbase();
+	if( !is_open() || n == 0 ) return true;
+	writeQueue().push(&m_file, &m_failed, m_buf, n);
+	if( m_buf.size() < BUFSIZE ) m_buf.resize(BUFSIZE);
+	setp(&m_buf[0], &m_buf[0] + m_buf.size());
+	return true;
+}
+
+
+/** \brief Close the file once its buffers are written, false on write errors. **/
+bool BufferedOfstream::AsyncBuf::close()
+{
+	if( !is_open() ) return true;
+	submit();
+	writeQueue().drain();
+	setp(0, 0);
+	bool ok = m_file.close() != 0;
+	return ok && !m_failed;
+}
+
+
+/// The buffer is full: queue it and start a new one with c.
+BufferedOfstream::AsyncBuf::int_type BufferedOfstream::AsyncBuf::overflow(int_type c)
+{
+	if( !is_open() ) return traits_type::eof();
+	submit();
+	if( traits_type::eq_int_type(c, traits_type::eof()) ) return traits_type::not_eof(c);
+	*pptr() = traits_type::to_char_type(c);
+	pbump(1);
+	return c;
+}
+
+
+/** \brief flush() queues the buffer, it does not wait for the write.
+
+	Callers flush at the end of a row, so a recorded signal is handled
+	here too (pollSignal).
+**/
+int BufferedOfstream::AsyncBuf::sync()
+{
+	submit();
+	pollSignal();
+	return 0;
+}
+
+
+volatile std::sig_atomic_t BufferedOfstream::s_signal = 0;
+volatile std::sig_atomic_t BufferedOfstream::s_open   = 0;
+
+
+/// Every BufferedOfstream, in the order they were constructed.
+std::vector<BufferedOfstream*>& BufferedOfstream::registry()
+{
+	static std::vector<BufferedOfstream*> files;
+	return files;
+}
+
+
+/** \brief Constructor, the buffer is allocated when a file is opened.
+
+	The write queue is created first so that it outlives every stream,
+	static ones included.
+**/
+BufferedOfstream::BufferedOfstream():std::ostream(0)
+{
+	writeQueue();
+	rdbuf(&m_sbuf);
+	registry().push_back(this);
+}
+
+
+/// Destructor, closing the file writes out the buffer.
+BufferedOfstream::~BufferedOfstream()
+{
+	std::vector<BufferedOfstream*>& r = registry();
+	r.erase(std::remove(r.begin(), r.end(), this), r.end());
+	if( is_open() ) close();
+}
+
+
+/** \brief Open filename, closing the file that was open before (if any). **/
+void BufferedOfstream::open(const char* filename, std::ios_base::openmode mode)
+{
+	if( is_open() ) close();
+	clear();
+	if( !m_sbuf.open(filename, mode) ) setstate(std::ios_base::failbit);
+	else s_open = s_open + 1;
+}
+
+
+/** \brief Close the file after the writer thread has written all of it. **/
+void BufferedOfstream::close()
+{
+	if( !is_open() ) return;
+	bool ok = m_sbuf.close();
+	s_open = s_open - 1;
+	if( !ok )
+	{
+		LOG<<"Error writing a BufferedOfstream file, the output is incomplete\n";
+		setstate(std::ios_base::failbit);
+	}
+}
+
+
+/** \brief Write out every open BufferedOfstream and wait for the writes. **/
+void BufferedOfstream::flushAll()
+{
+	std::vector<BufferedOfstream*>& r = registry();
+	for( size_t i = 0; i < r.size(); i++ )
+	{
+		if( r[i]->is_open() ) r[i]->m_sbuf.submit();
+	}
+	writeQueue().drain();
+}
+
+
+/** \brief Record SIGINT or SIGTERM for pollSignal().
+
+	Only async-signal-safe calls: the default action is restored, and the
+	signal is either raised again right away (no file open, nothing to
+	lose) or left in s_signal for the main thread.
+**/
+void BufferedOfstream::onSignal(int sig)
+{
+	std::signal(sig, SIG_DFL);
+	if( s_open == 0 )
+	{
+		std::raise(sig);
+		return;
+	}
+	s_signal = sig;
+}
+
+
+/** \brief Flush the open files when the run is interrupted (SIGINT, SIGTERM). **/
+void BufferedOfstream::flushOnSignal()
+{
+	std::signal(SIGINT, onSignal);
+	std::signal(SIGTERM, onSignal);
+}
+
+
+/** \brief After a recorded signal, write out the buffers and raise it again.
+
+	Called from the main thread only, between records: once per mceval
+	draw and on flush().  Never from overflow(), which can be in the
+	middle of a row.
+**/
+void BufferedOfstream::pollSignal()
+{
+	if( !s_signal ) return;
+	int sig = s_signal;
+	s_signal = 0;
+	flushAll();
+	std::raise(sig);
+}
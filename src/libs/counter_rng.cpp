@@ -0,0 +1,66 @@
+#include <cmath>
+#include "../../include/counter_rng.h"
+
+/// Constructor, the key is the seed and the stream identifier.
+CounterRng::CounterRng(const long& seed, const int& stream)
+{
+	m_key[0] = uint32_t(seed);
+	m_key[1] = uint32_t(stream);
+}
+
+
+/** \brief Philox4x32 with 10 rounds, ctr is replaced by the random block.
+
+	Constants from the Random123 reference implementation.
+**/
+void CounterRng::philox(uint32_t ctr[4], const uint32_t key[2])
+{
+	const uint32_t M0 = 0xD2511F53;
+	const uint32_t M1 = 0xCD9E8D57;
+	const uint32_t W0 = 0x9E3779B9;
+	const uint32_t W1 = 0xBB67AE85;
+	uint32_t k0 = key[0];
+	uint32_t k1 = key[1];
+
+	for( int r = 0; r < 10; r++ )
+	{
+		uint64_t p0 = uint64_t(M0) * ctr[0];
+		uint64_t p1 = uint64_t(M1) * ctr[2];
+		uint32_t hi0 = uint32_t(p0 >> 32), lo0 = uint32_t(p0);
+		uint32_t hi1 = uint32_t(p1 >> 32), lo1 = uint32_t(p1);
+		ctr[0] = hi1 ^ ctr[1] ^ k0;
+		ctr[1] = lo1;
+		ctr[2] = hi0 ^ ctr[3] ^ k1;
+		ctr[3] = lo0;
+		k0 += W0;
+		k1 += W1;
+	}
+}
+
+
+/// 53-bit uniform in (0,1) from two 32-bit words.
+static inline double toUniform(const uint32_t& a, const uint32_t& b)
+{
+	uint64_t r = ((uint64_t(a) << 32) | b) >> 11;
+	return (r + 0.5) / 9007199254740992.0;
+}
+
+
+/** \brief Uniform random number in (0,1) for counter (c0,c1,c2,c3). **/
+double CounterRng::uniform(const int& c0, const int& c1, const int& c2, const int& c3) const
+{
+	uint32_t ctr[4] = {uint32_t(c0), uint32_t(c1), uint32_t(c2), uint32_t(c3)};
+	philox(ctr, m_key);
+	return toUniform(ctr[0], ctr[1]);
+}
+
+
+/** \brief Standard normal random number for counter (c0,c1,c2,c3). **/
+double CounterRng::randn(const int& c0, const int& c1, const int& c2, const int& c3) const
+{
+	uint32_t ctr[4] = {uint32_t(c0), uint32_t(c1), uint32_t(c2), uint32_t(c3)};
+	philox(ctr, m_key);
+	double u1 = toUniform(ctr[0], ctr[1]);
+	double u2 = toUniform(ctr[2], ctr[3]);
+	return sqrt(-2.0*log(u1)) * cos(2.0*M_PI*u2);
+}
@@ -0,0 +1,220 @@
+#include <cmath>
+#include "../../include/dd_projection.h"
+#include "../../include/baranov.h"
+#include "../../include/parallel.h"
+#include "../../include/Logger.h"
+
+/** \brief Constructor, sizes the problem arrays.
+
+	\param  nprob number of problems
+	\param  syr first year of the historical arrays
+	\param  nyr last year of the historical arrays
+	\param  kage age at recruitment (lag between biomass and recruits)
+	\param  nproj number of projection years after nyr
+	\param  srr stock-recruitment model 1 = Beverton-Holt, 2 = Ricker
+**/
+DDProjection::DDProjection(const int& nprob, const int& syr, const int& nyr,
+                           const int& kage, const int& nproj, const int& srr)
+:m_nprob(nprob),m_syr(syr),m_nyr(nyr),m_pyr(nyr+nproj),m_kage(kage),m_srr(srr)
+{
+	int nyrs = m_pyr - syr + 1;
+	m_tac.assign(nprob,0.0);
+	m_so.assign(nprob,0.0);
+	m_beta.assign(nprob,0.0);
+	m_tau.assign(nprob,0.0);
+	m_M.assign(nprob,0.0);
+	m_rho.assign(nprob,0.0);
+	m_alpha.assign(nprob,0.0);
+	m_wk.assign(nprob,0.0);
+	m_bt.assign(nyrs*nprob,0.0);
+	m_N.assign(nyrs*nprob,0.0);
+	m_S.assign(nyrs*nprob,0.0);
+	m_ft.assign(nyrs*nprob,0.0);
+	m_xx.assign(nproj*nprob,0.0);
+	m_clip.assign(nproj*nprob,0);
+}
+
+
+/** \brief Fill problem p (1..nprob) with a draw and its TAC. **/
+void DDProjection::setProblem(const int& p, const DDProjectionDraw& d, const double& tac)
+{
+	m_tac[p-1]   = tac;
+	m_so[p-1]    = d.so;
+	m_beta[p-1]  = d.beta;
+	m_tau[p-1]   = d.tau;
+	m_M[p-1]     = d.M;
+	m_rho[p-1]   = d.rho;
+	m_alpha[p-1] = d.alpha;
+	m_wk[p-1]    = d.wk;
+	for( int i = m_syr; i <= m_nyr; i++ )
+	{
+		m_bt[at(i,p)] = d.bt(i);
+		m_N[at(i,p)]  = d.N(i);
+		m_S[at(i,p)]  = d.S(i);
+		m_ft[at(i,p)] = d.ft(i);
+	}
+	for( int i = m_nyr+1; i <= m_pyr; i++ )
+	{
+		m_xx[(i-m_nyr-1)*m_nprob + p-1] = d.xx(i);
+	}
+}
+
+
+/** \brief Project every problem from nyr+1 to pyr.
+	\param  threaded share the blocks of problems out over threads.
+**/
+void DDProjection::run(const bool& threaded)
+{
+	int nblock = (m_nprob + BLOCK - 1) / BLOCK;
+	if( threaded )
+	{
+		parallel::for_each(0,nblock-1,[&](int b)
+		{
+			int p0 = b*BLOCK;
+			runBlock(p0, p0+BLOCK < m_nprob ? p0+BLOCK : m_nprob);
+		});
+	}
+	else
+	{
+		for( int b = 0; b < nblock; b++ )
+		{
+			int p0 = b*BLOCK;
+			runBlock(p0, p0+BLOCK < m_nprob ? p0+BLOCK : m_nprob);
+		}
+	}
+}
+
+
+/** \brief Year loop for problems p0..p1-1 (0-based). **/
+void DDProjection::runBlock(const int& p0, const int& p1)
+{
+	const int nb = p1 - p0;
+	const int P  = m_nprob;
+	int b,i,its;
+
+	std::vector<double> ct(nb), ft(nb), fnorm(nb);
+	std::vector<char>   clip(nb), done(nb);
+	std::vector<int>    nits(nb);
+	BaranovStats bs;
+
+	const double *tac = &m_tac[p0];
+	const double *M   = &m_M[p0];
+	for( i = m_nyr+1; i <= m_pyr; i++ )
+	{
+		const double *bl = &m_bt[(i-m_kage-m_syr)*P + p0];
+		const double *b0 = &m_bt[(i-1-m_syr)*P + p0];
+		const double *n0 = &m_N[(i-1-m_syr)*P + p0];
+		const double *s0 = &m_S[(i-1-m_syr)*P + p0];
+		const double *xx = &m_xx[(i-m_nyr-1)*P + p0];
+		double *bt = &m_bt[(i-m_syr)*P + p0];
+		double *N  = &m_N[(i-m_syr)*P + p0];
+		double *S  = &m_S[(i-m_syr)*P + p0];
+		double *F  = &m_ft[(i-m_syr)*P + p0];
+		char   *C  = &m_clip[(i-m_nyr-1)*P + p0];
+
+		// Recruits, biomass and numbers
+		for( b = 0; b < nb; b++ )
+		{
+			double et  = bl[b];
+			double tau = m_tau[p0+b];
+			double rt  = m_srr == 1 ? m_so[p0+b]*et/(1.+m_beta[p0+b]*et)
+			                        : m_so[p0+b]*et*exp(-m_beta[p0+b]*et);
+			rt   *= exp(xx[b]-0.5*tau*tau);
+			bt[b] = s0[b]*(m_rho[p0+b]*b0[b] + m_alpha[p0+b]*n0[b]) + m_wk[p0+b]*rt;
+			N[b]  = s0[b]*n0[b] + rt;
+		}
+
+		// Catch equation, a TAC that is not less than the biomass gets F = 20.
+		for( b = 0; b < nb; b++ )
+		{
+			clip[b] = !(tac[b] < bt[b]);
+			ct[b]   = clip[b] ? 0 : tac[b];
+			ft[b]   = ct[b]/(bt[b]*exp(-M[b]/2.));
+			done[b] = clip[b];
+			nits[b] = 0;
+		}
+		for( its = 1; its <= 50; its++ )
+		{
+			int nleft = 0;
+			for( b = 0; b < nb; b++ )
+			{
+				if( done[b] ) continue;
+				double f   = ft[b];
+				double z   = M[b]+f;
+				double s   = exp(-z);
+				double o   = 1.-s;
+				double t1  = f/z;
+				double t3  = o*bt[b];
+				double pct = t1*o*bt[b];
+				double dct = t3/z - f*t3/(z*z) + t1*s*bt[b];
+				double r   = fabs(pct-ct[b]);
+				fnorm[b] = r;
+				nits[b]  = its;
+				if( r < TOL ) done[b] = 1;
+				else
+				{
+					ft[b] -= (pct-ct[b])/dct;
+					nleft++;
+				}
+			}
+			if( !nleft ) break;
+		}
+		for( b = 0; b < nb; b++ )
+		{
+			F[b] = clip[b] ? 20.0 : ft[b];
+			S[b] = exp(-(M[b]+F[b]));
+			C[b] = clip[b];
+
+			BaranovResult r;
+			r.iterations = nits[b];
+			r.fnorm      = clip[b] ? tac[b]-bt[b] : fnorm[b];
+			r.converged  = !clip[b] && fnorm[b] < TOL;
+			r.clipped    = clip[b];
+			bs.add(r);
+		}
+	}
+	BaranovCatchEquation::record(bs);
+}
+
+
+using namespace state_io;
+
+/** \brief Append the draw to a projection state file. **/
+void DDProjectionDraw::write(std::ostream& os) const
+{
+	putInt(os, draw);
+	putDouble(os, so);
+	putDouble(os, beta);
+	putDouble(os, tau);
+	putDouble(os, M);
+	putDouble(os, rho);
+	putDouble(os, alpha);
+	putDouble(os, wk);
+	putVector(os, bt);
+	putVector(os, N);
+	putVector(os, S);
+	putVector(os, ft);
+	putDouble(os, bo);
+	putDouble(os, bmsy);
+	putDouble(os, fmsy);
+}
+
+/** \brief Read the next draw, false at the end of the file. **/
+bool DDProjectionDraw::read(std::istream& is, const ProjectionStateHeader& h)
+{
+	if( !getInt(is, draw) ) return false;
+	bt.allocate(h.syr,h.nyr);
+	N.allocate(h.syr,h.nyr);
+	S.allocate(h.syr,h.nyr);
+	ft.allocate(h.syr,h.nyr);
+
+	bool ok = getDouble(is, so) && getDouble(is, beta) && getDouble(is, tau)
+	       && getDouble(is, M) && getDouble(is, rho) && getDouble(is, alpha) && getDouble(is, wk)
+	       && getVector(is, bt) && getVector(is, N) && getVector(is, S) && getVector(is, ft)
+	       && getDouble(is, bo) && getDouble(is, bmsy) && getDouble(is, fmsy);
+	if( !ok )
+	{
+		LOG<<"Projection state file ends in the middle of draw "<<draw<<'\n';
+	}
+	return ok;
+}
@@ -0,0 +1,185 @@
+#include <cmath>
+#include "../../include/ddmsy.h"
+#include "../../include/parallel.h"
+#include "../../include/Logger.h"
+
+static const int    DDMSY_MAXIT = 50;     //!< Maximum number of Newton/bisection steps
+static const double DDMSY_TOL   = 1.0e-10; //!< Convergence tolerance on F
+static const int    DDMSY_NSCAN = 20;     //!< Intervals used to bracket the maximum
+
+/// Constructor with delay difference growth and stock-recruitment parameters
+DDMsy::DDMsy(const double& a, const double& b, const double& m,
+             const double& alpha, const double& rho, const double& wk,
+             const int& srr)
+{
+	m_a     = a;
+	m_b     = b;
+	m_M     = m;
+	m_alpha = alpha;
+	m_rho   = rho;
+	m_wk    = wk;
+	m_srr   = srr;
+
+	m_FAIL  = false;
+	m_iter  = 0;
+	m_fmsy  = 0;
+	m_msy   = 0;
+	m_bmsy  = 0;
+	m_ye    = 0;
+	m_be    = 0;
+	m_dye   = 0;
+	m_d2ye  = 0;
+}
+
+/** \brief Equilibrium biomass, yield and derivatives of yield for a given F
+
+	Each quantity x is carried with its first (x1) and second (x2)
+	derivatives with respect to F, starting from s1 = -s and s2 = s.
+
+	\param  fe fishing mortality rate
+	\sa get_fmsy
+**/
+void DDMsy::calcEquilibrium(const double& fe)
+{
+	// Survival
+	double s  = exp(-m_M-fe);
+	double s1 = -s;
+	double s2 = s;
+
+	// Numerator of the equilibrium mean weight
+	double n  = m_wk + s*(m_alpha-m_wk);
+	double n1 = s1*(m_alpha-m_wk);
+	double n2 = s2*(m_alpha-m_wk);
+
+	// (1-rho*s)*(1-s), so that phi = n/u is biomass per recruit.
+	double du = -(1.0+m_rho) + 2.0*m_rho*s;
+	double u  = (1.0-m_rho*s)*(1.0-s);
+	double u1 = du*s1;
+	double u2 = du*s2 + 2.0*m_rho*s1*s1;
+
+	double phi  = n/u;
+	double phi1 = (n1 - phi*u1)/u;
+	double phi2 = (n2 - 2.0*phi1*u1 - phi*u2)/u;
+
+	// Equilibrium biomass
+	double be, be1, be2;
+	switch(m_srr)
+	{
+		case 2: // Ricker
+			be  = log(m_a*phi)/m_b;
+			be1 = phi1/(m_b*phi);
+			be2 = (phi2/phi - (phi1/phi)*(phi1/phi))/m_b;
+		break;
+
+		default: // Beverton-Holt
+			be  = (m_a*phi - 1.0)/m_b;
+			be1 = m_a*phi1/m_b;
+			be2 = m_a*phi2/m_b;
+		break;
+	}
+
+	// Fraction of the biomass caught: q = (1-s)*F/(F+M)
+	double z  = fe+m_M;
+	double r  = fe/z;
+	double r1 = m_M/(z*z);
+	double r2 = -2.0*m_M/(z*z*z);
+	double c  = 1.0-s;
+	double c1 = -s1;
+	double c2 = -s2;
+	double q  = c*r;
+	double q1 = c1*r + c*r1;
+	double q2 = c2*r + 2.0*c1*r1 + c*r2;
+
+	m_be   = be;
+	m_ye   = be*q;
+	m_dye  = be1*q + be*q1;
+	m_d2ye = be2*q + 2.0*be1*q1 + be*q2;
+}
+
+/** \brief Solve dYe/dF = 0 for Fmsy
+
+	Ye(F) is not always unimodal in the delay difference model (at high F
+	the catch tends to the biomass of the new recruits), so [0, fmax] is
+	first split into DDMSY_NSCAN intervals and the interval where dYe/dF
+	changes sign with the largest yield is kept as the bracket [lo, hi].
+	Newton-Raphson on dYe/dF then refines Fmsy inside the bracket, taking a
+	bisection step whenever the Newton step leaves the bracket or Ye is not
+	concave.
+
+	If the largest yield is at fmax, Fmsy = fmax and the fail flag is set.
+
+	\param  finit starting value for F (used if it is inside the bracket)
+	\param  fmax  upper bound for F
+	\return Fmsy
+**/
+double DDMsy::get_fmsy(const double& finit, const double& fmax)
+{
+	double lo = 0;
+	double hi = 0;
+	double fe = 0;
+	double ybest = -1;
+
+	m_FAIL = false;
+	m_iter = 0;
+
+	// Bracket the maximum
+	double df = fmax/DDMSY_NSCAN;
+	calcEquilibrium(0);
+	double ylast = m_ye;
+	double dlast = m_dye;
+	for( int k = 1; k <= DDMSY_NSCAN; k++ )
+	{
+		calcEquilibrium(k*df);
+		if( dlast > 0 && m_dye <= 0 && ylast > ybest )
+		{
+			ybest = ylast;
+			lo    = (k-1)*df;
+			hi    = k*df;
+		}
+		ylast = m_ye;
+		dlast = m_dye;
+	}
+	if( dlast > 0 && ylast > ybest )
+	{
+		fe     = fmax;
+		m_FAIL = true;
+	}
+	else if( hi > lo )
+	{
+		fe = (finit > lo && finit < hi) ? finit : 0.5*(lo+hi);
+		for( m_iter = 1; m_iter <= DDMSY_MAXIT; m_iter++ )
+		{
+			calcEquilibrium(fe);
+			if( m_dye > 0 ) lo = fe; else hi = fe;
+
+			double fn = m_d2ye < 0 ? fe - m_dye/m_d2ye : lo-1.0;
+			if( fn <= lo || fn >= hi ) fn = 0.5*(lo+hi);
+
+			double dx = fabs(fn-fe);
+			fe = fn;
+			if( dx < DDMSY_TOL*(1.0+fe) ) break;
+		}
+		if( m_iter > DDMSY_MAXIT ) m_FAIL = true;
+	}
+
+	calcEquilibrium(fe);
+	m_fmsy = fe;
+	m_msy  = m_ye > 0 ? m_ye : 0;
+	m_bmsy = m_be > 0 ? m_be : 0;
+	return m_fmsy;
+}
+
+/** \brief Solve a set of independent problems concurrently
+
+	Used for multiple stocks (or posterior samples); each problem only
+	touches its own members so the solves are run with parallel::for_each.
+
+	\param  problems vector of DDMsy objects, solved in place
+**/
+void DDMsy::solve(std::vector<DDMsy>& problems)
+{
+	parallel::for_each(0,int(problems.size())-1,[&](int i)
+	{
+		problems[i].get_fmsy();
+	});
+}
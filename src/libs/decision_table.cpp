@@ -0,0 +1,226 @@
+#include <algorithm>
+#include "../../include/decision_table.h"
+#include "../../include/Logger.h"
+
+/// Constructor, p is the probability of the quantile to estimate.
+P2Quantile::P2Quantile(const double& p)
+:m_p(p),m_count(0)
+{
+	for( int i = 0; i < 5; i++ )
+	{
+		m_q[i] = 0;
+		m_n[i] = i + 1;
+	}
+	m_np[0] = 1;
+	m_np[1] = 1 + 2*p;
+	m_np[2] = 1 + 4*p;
+	m_np[3] = 3 + 2*p;
+	m_np[4] = 5;
+	m_dn[0] = 0;
+	m_dn[1] = p/2;
+	m_dn[2] = p;
+	m_dn[3] = (1+p)/2;
+	m_dn[4] = 1;
+}
+
+
+/// Piecewise-parabolic prediction of marker i moved by d (+1 or -1).
+double P2Quantile::parabolic(const int& i, const double& d) const
+{
+	return m_q[i] + d / (m_n[i+1]-m_n[i-1])
+	       * ( (m_n[i]-m_n[i-1]+d) * (m_q[i+1]-m_q[i]) / (m_n[i+1]-m_n[i])
+	         + (m_n[i+1]-m_n[i]-d) * (m_q[i]-m_q[i-1]) / (m_n[i]-m_n[i-1]) );
+}
+
+/// Linear prediction of marker i moved by d (+1 or -1).
+double P2Quantile::linear(const int& i, const int& d) const
+{
+	return m_q[i] + d * (m_q[i+d]-m_q[i]) / (m_n[i+d]-m_n[i]);
+}
+
+
+/** \brief Add one value to the stream. **/
+void P2Quantile::add(const double& x)
+{
+	int i,k;
+	if( m_count < 5 )
+	{
+		m_q[m_count++] = x;
+		if( m_count == 5 ) std::sort(m_q, m_q+5);
+		return;
+	}
+	m_count++;
+
+	// Cell k containing x, extending the extreme markers if needed.
+	if( x < m_q[0] )
+	{
+		m_q[0] = x;
+		k = 0;
+	}
+	else if( x >= m_q[4] )
+	{
+		m_q[4] = std::max(m_q[4], x);
+		k = 3;
+	}
+	else
+	{
+		for( k = 0; k < 3; k++ )
+		{
+			if( x < m_q[k+1] ) break;
+		}
+	}
+
+	for( i = k+1; i < 5; i++ ) m_n[i]  += 1;
+	for( i = 0;   i < 5; i++ ) m_np[i] += m_dn[i];
+
+	// Adjust the heights of the middle markers.
+	for( i = 1; i <= 3; i++ )
+	{
+		double d = m_np[i] - m_n[i];
+		if( (d >= 1 && m_n[i+1]-m_n[i] > 1) || (d <= -1 && m_n[i-1]-m_n[i] < -1) )
+		{
+			int s = d > 0 ? 1 : -1;
+			double q = parabolic(i, s);
+			if( m_q[i-1] < q && q < m_q[i+1] ) m_q[i] = q;
+			else m_q[i] = linear(i, s);
+			m_n[i] += s;
+		}
+	}
+}
+
+
+/** \brief Current estimate of the quantile (0 before any value is added). **/
+double P2Quantile::getQuantile() const
+{
+	if( m_count >= 5 ) return m_q[2];
+	if( m_count == 0 ) return 0;
+
+	// Fewer than 5 values: interpolate between them, sorted (insertion sort).
+	double v[5];
+	const int n = m_count < 5 ? m_count : 5;
+	for( int i = 0; i < n; i++ )
+	{
+		double x = m_q[i];
+		int    k = i;
+		for( ; k > 0 && v[k-1] > x; k-- ) v[k] = v[k-1];
+		v[k] = x;
+	}
+	double h = m_p * (n-1);
+	int    j = int(h);
+	if( j >= n-1 ) return v[n-1];
+	return v[j] + (h-j) * (v[j+1]-v[j]);
+}
+
+
+/** \brief Size the table for the TAC options.
+
+	\param  tac TAC options, one row of the table each
+	\param  syr first model year
+	\param  nyr last model year, the table is for B(nyr+2) and F(nyr+1)
+	\param  include_msy add the MSY based indicators
+**/
+void DecisionTable::allocate(const dvector& tac, const int& syr, const int& nyr, const bool& include_msy)
+{
+	int ntac = tac.indexmax() - tac.indexmin() + 1;
+	m_syr = syr;
+	m_nyr = nyr;
+	m_msy = include_msy;
+	m_tac.allocate(1,ntac);
+	for( int t = 1; t <= ntac; t++ )
+	{
+		m_tac(t) = tac(tac.indexmin()+t-1);
+	}
+
+	const double prob[NPROB] = {0.025, 0.5, 0.975};
+	m_count.assign(ntac, 0);
+	m_hits.assign(ntac*nIndicators(), 0);
+	m_quant.clear();
+	for( int t = 0; t < ntac; t++ )
+	{
+		for( int v = 0; v < NVAR; v++ )
+		{
+			for( int q = 0; q < NPROB; q++ )
+			{
+				m_quant.push_back(P2Quantile(prob[q]));
+			}
+		}
+	}
+}
+
+
+/** \brief Add the projection of one draw for TAC option t (1..ntac).
+
+	Arguments are as for write_proj_output with pyr = nyr+1.
+**/
+void DecisionTable::add(const int& t, const dvector& p_sbt, const dmatrix& p_ft,
+                        const double& ftnyr, const double& bo, const double& fmsy, const double& bmsy)
+{
+	int pyr   = m_nyr+1;
+	double b1 = p_sbt(pyr);
+	double b2 = p_sbt(pyr+1);
+	double f1 = p_ft(pyr,1);
+
+	int *hits = &m_hits[(t-1)*nIndicators()];
+	hits[0] += b2 < b1;
+	hits[1] += b2 < 0.4*bo;
+	hits[2] += b2 < 0.2*bo;
+	hits[3] += b2 < p_sbt(m_syr);
+	hits[4] += f1 > ftnyr;
+	if( m_msy )
+	{
+		hits[5] += b2 < bmsy;
+		hits[6] += b2 < 0.8*bmsy;
+		hits[7] += b2 < 0.4*bmsy;
+		hits[8] += f1 > fmsy;
+	}
+
+	const double x[NVAR] = {b2, b2/bo, f1};
+	P2Quantile *pq = &m_quant[(t-1)*NVAR*NPROB];
+	for( int v = 0; v < NVAR; v++ )
+	{
+		for( int q = 0; q < NPROB; q++ )
+		{
+			pq[v*NPROB+q].add(x[v]);
+		}
+	}
+	m_count[t-1]++;
+}
+
+
+/** \brief Write the table, one row per TAC option. **/
+void DecisionTable::write(ostream& ofs) const
+{
+	int b1 = m_nyr+1;
+	int b2 = m_nyr+2;
+	const char* qname[NPROB] = {"q025", "q50", "q975"};
+
+	ofs<<"TAC,n";
+	ofs<<",P_B"<<b2<<"B"<<b1<<",P_B"<<b2<<"04B0"<<",P_B"<<b2<<"02B0";
+	ofs<<",P_B"<<b2<<"B"<<m_syr<<",P_F"<<b1<<"F"<<m_nyr;
+	if( m_msy )
+	{
+		ofs<<",P_B"<<b2<<"BMSY"<<",P_B"<<b2<<"08BMSY"<<",P_B"<<b2<<"04BMSY";
+		ofs<<",P_F"<<b1<<"FMSY";
+	}
+	for( int q = 0; q < NPROB; q++ ) ofs<<",B"<<b2<<"_"<<qname[q];
+	for( int q = 0; q < NPROB; q++ ) ofs<<",B"<<b2<<"B0_"<<qname[q];
+	for( int q = 0; q < NPROB; q++ ) ofs<<",F"<<b1<<"_"<<qname[q];
+	ofs<<'\n';
+
+	for( int t = 1; t <= m_tac.indexmax(); t++ )
+	{
+		int n = m_count[t-1];
+		const int *hits = &m_hits[(t-1)*nIndicators()];
+		ofs<<m_tac(t)<<","<<n;
+		for( int i = 0; i < nIndicators(); i++ )
+		{
+			ofs<<","<<(n ? double(hits[i])/n : 0);
+		}
+		const P2Quantile *pq = &m_quant[(t-1)*NVAR*NPROB];
+		for( int i = 0; i < NVAR*NPROB; i++ )
+		{
+			ofs<<","<<pq[i].getQuantile();
+		}
+		ofs<<'\n';
+	}
+}
@@ -0,0 +1,45 @@
+#include <cstring>
+#include "../../include/draw_memo.h"
+
+/// Constructor, no previous draw.
+DrawMemo::DrawMemo():m_hash(0),m_draws(0),m_repeats(0)
+{
+}
+
+
+/// FNV-1a hash of the bytes of x.
+uint64_t DrawMemo::hash(const double* x, const size_t& n)
+{
+	const unsigned char* p = reinterpret_cast<const unsigned char*>(x);
+	uint64_t h = 14695981039346656037ULL;
+	for( size_t i = 0; i < n * sizeof(double); i++ )
+	{
+		h ^= p[i];
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+
+/** \brief True if x is the parameter vector of the previous draw.
+
+	x becomes the previous draw for the next call.
+**/
+bool DrawMemo::repeat(const dvector& x)
+{
+	std::vector<double> v(x.indexmax() - x.indexmin() + 1);
+	for( size_t i = 0; i < v.size(); i++ ) v[i] = x(x.indexmin() + int(i));
+	uint64_t h = v.empty() ? hash(0, 0) : hash(&v[0], v.size());
+
+	bool same = m_draws > 0 && h == m_hash && v.size() == m_last.size()
+	         && (v.empty() || !memcmp(&v[0], &m_last[0], v.size() * sizeof(double)));
+	m_draws++;
+	if( same )
+	{
+		m_repeats++;
+		return true;
+	}
+	m_last.swap(v);
+	m_hash = h;
+	return false;
+}
@@ -0,0 +1,139 @@
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include "../../include/mcmc_chains.h"
+#include "../../include/Logger.h"
+
+/** \brief Read the first nvar rows of an ADMB .cor file, false on errors.
+
+	The file has two header lines (determinant of the hessian, column
+	names), then for row i: index, name, value, std.dev and the i
+	correlations with rows 1 to i.
+**/
+bool ParameterCorrelations::read(const std::string& filename, const int& nvar)
+{
+	std::ifstream ifs(filename.c_str());
+	std::string line;
+	if( !ifs || !std::getline(ifs, line) || !std::getline(ifs, line) )
+	{
+		LOG<<"Cannot read "<<filename<<", fit the model first\n";
+		return false;
+	}
+	names.assign(nvar, "");
+	value.assign(nvar, 0);
+	sd.assign(nvar, 0);
+	cor.assign(nvar * nvar, 0);
+	for( int i = 0; i < nvar; i++ )
+	{
+		int index;
+		if( !std::getline(ifs, line) )
+		{
+			LOG<<filename<<" has "<<i<<" rows, the model has "<<nvar<<" active parameters\n";
+			return false;
+		}
+		std::istringstream iss(line);
+		iss>>index>>names[i]>>value[i]>>sd[i];
+		for( int j = 0; j <= i; j++ ) iss>>cor[i*nvar + j];
+		if( !iss || index != i + 1 )
+		{
+			LOG<<filename<<": cannot read row "<<i+1<<'\n';
+			return false;
+		}
+		for( int j = 0; j < i; j++ ) cor[j*nvar + i] = cor[i*nvar + j];
+	}
+	return true;
+}
+
+
+/** \brief Parameter names with [k] for the k-th element of a vector. **/
+std::vector<std::string> ParameterCorrelations::columnNames() const
+{
+	std::map<std::string, int> count, seen;
+	for( size_t i = 0; i < names.size(); i++ ) count[names[i]]++;
+	std::vector<std::string> cols(names.size());
+	for( size_t i = 0; i < names.size(); i++ )
+	{
+		std::ostringstream os;
+		os<<names[i];
+		if( count[names[i]] > 1 ) os<<"["<<++seen[names[i]]<<"]";
+		cols[i] = os.str();
+	}
+	return cols;
+}
+
+
+/** \brief In-place Cholesky factor (lower triangle) of the n x n row-major a.
+
+	The upper triangle is set to zero.  False if a is not positive
+	definite, e.g. when the correlations of the .cor file are rounded.
+**/
+bool cholesky(std::vector<double>& a, const int& n)
+{
+	for( int j = 0; j < n; j++ )
+	{
+		double d = a[j*n + j];
+		for( int k = 0; k < j; k++ ) d -= a[j*n + k] * a[j*n + k];
+		if( !(d > 0) ) return false;
+		d = sqrt(d);
+		a[j*n + j] = d;
+		for( int i = j + 1; i < n; i++ )
+		{
+			double s = a[i*n + j];
+			for( int k = 0; k < j; k++ ) s -= a[i*n + k] * a[j*n + k];
+			a[i*n + j] = s / d;
+		}
+		for( int i = 0; i < j; i++ ) a[i*n + j] = 0;
+	}
+	return true;
+}
+
+
+/** \brief Pool the .psv files of the chains.
+
+	psvfile gets the draws of all chains, chain after chain, so that
+	-mceval evaluates the pooled sample.  csvfile has a row for each draw:
+	chain (its number in chains), draw (within the chain) and the
+	parameter values, for convergence diagnostics.
+**/
+bool merge_chains(const std::vector<std::string>& psvfiles, const std::vector<int>& chains,
+                  const std::vector<std::string>& names,
+                  const std::string& psvfile, const std::string& csvfile)
+{
+	const int nvar = names.size();
+	std::ofstream psv(psvfile.c_str(), std::ios::binary);
+	std::ofstream csv(csvfile.c_str());
+	psv.write(reinterpret_cast<const char*>(&nvar), sizeof(int));
+	csv<<"chain,draw";
+	for( int i = 0; i < nvar; i++ ) csv<<","<<names[i];
+	csv<<'\n';
+
+	std::vector<double> x(nvar);
+	for( size_t c = 0; c < psvfiles.size(); c++ )
+	{
+		std::ifstream ifs(psvfiles[c].c_str(), std::ios::binary);
+		int n = 0;
+		if( !ifs || !ifs.read(reinterpret_cast<char*>(&n), sizeof(int)) || n != nvar )
+		{
+			LOG<<"Cannot read "<<psvfiles[c]<<" or it does not have "<<nvar<<" parameters\n";
+			return false;
+		}
+		long long draw = 0;
+		while( nvar && ifs.read(reinterpret_cast<char*>(&x[0]), nvar * sizeof(double)) )
+		{
+			psv.write(reinterpret_cast<const char*>(&x[0]), nvar * sizeof(double));
+			csv<<chains[c]<<","<<++draw;
+			for( int i = 0; i < nvar; i++ ) csv<<","<<x[i];
+			csv<<'\n';
+		}
+		LOG<<"Chain "<<chains[c]<<": "<<draw<<" draws\n";
+	}
+	psv.close();
+	csv.close();
+	if( !psv || !csv )
+	{
+		LOG<<"Error writing "<<psvfile<<" or "<<csvfile<<'\n';
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,289 @@
+#include <cmath>
+#include <cstring>
+#include "../../include/mcmc_monitor.h"
+#include "../../include/draw_memo.h"
+
+const double ConvergenceMonitor::RHAT_OK   = 1.01;
+const double ConvergenceMonitor::RHAT_FAIL = 1.5;
+const double ConvergenceMonitor::ESS_OK    = 400;
+
+
+DrawCache::DrawCache(const size_t& maxSize):m_maxSize(maxSize > 0 ? maxSize : 1)
+{
+}
+
+
+std::list<DrawCache::Entry>::iterator DrawCache::find(const uint64_t& h, const double* x, const size_t& n)
+{
+	typedef std::multimap<uint64_t, std::list<Entry>::iterator>::iterator Index;
+	std::pair<Index, Index> r = m_index.equal_range(h);
+	for( Index it = r.first; it != r.second; ++it )
+	{
+		const std::vector<double>& y = it->second->x;
+		if( y.size() == n && (n == 0 || !memcmp(&y[0], x, n * sizeof(double))) ) return it->second;
+	}
+	return m_entries.end();
+}
+
+
+/** \brief Keep the values of parameter vector x (n values). **/
+void DrawCache::put(const double* x, const size_t& n, const std::vector<double>& values)
+{
+	uint64_t h = DrawMemo::hash(x, n);
+	std::list<Entry>::iterator it = find(h, x, n);
+	if( it != m_entries.end() )
+	{
+		it->values = values;
+		m_entries.splice(m_entries.end(), m_entries, it);
+		return;
+	}
+	if( m_entries.size() >= m_maxSize )
+	{
+		typedef std::multimap<uint64_t, std::list<Entry>::iterator>::iterator Index;
+		std::pair<Index, Index> r = m_index.equal_range(m_entries.front().hash);
+		for( Index i = r.first; i != r.second; ++i )
+		{
+			if( i->second == m_entries.begin() )
+			{
+				m_index.erase(i);
+				break;
+			}
+		}
+		m_entries.pop_front();
+	}
+	Entry e;
+	e.hash = h;
+	e.x.assign(x, x + n);
+	e.values = values;
+	m_index.insert(std::make_pair(h, m_entries.insert(m_entries.end(), e)));
+}
+
+
+/** \brief Values of parameter vector x, 0 if it is not in the cache. **/
+const std::vector<double>* DrawCache::get(const double* x, const size_t& n)
+{
+	std::list<Entry>::iterator it = find(DrawMemo::hash(x, n), x, n);
+	if( it == m_entries.end() ) return 0;
+	m_entries.splice(m_entries.end(), m_entries, it);
+	return &it->values;
+}
+
+
+ConvergenceMonitor::ConvergenceMonitor():m_count(0),m_batch(1),m_fill(0),m_status(WAITING)
+{
+}
+
+
+void ConvergenceMonitor::allocate(const std::vector<std::string>& names)
+{
+	m_names = names;
+	m_draws.assign(names.size(), std::vector<double>());
+	m_sum.assign(names.size(), 0.0);
+	m_mean.assign(names.size(), 0.0);
+	m_ss.assign(names.size(), 0.0);
+	m_count = 0;
+	m_batch = 1;
+	m_fill  = 0;
+	m_rhat.assign(names.size(), NAN);
+	m_ess.assign(names.size(), NAN);
+	m_status = WAITING;
+}
+
+
+/** \brief Add a saved draw, one value per column. **/
+void ConvergenceMonitor::add(const std::vector<double>& values)
+{
+	if( values.size() < m_draws.size() ) return;
+	m_count++;
+	for( size_t i = 0; i < m_draws.size(); i++ )
+	{
+		double d = values[i] - m_mean[i];
+		m_mean[i] += d / m_count;
+		m_ss[i]   += d * (values[i] - m_mean[i]);
+		m_sum[i]  += values[i];
+	}
+	if( ++m_fill < m_batch ) return;
+
+	for( size_t i = 0; i < m_draws.size(); i++ )
+	{
+		m_draws[i].push_back(m_sum[i] / m_batch);
+		m_sum[i] = 0;
+	}
+	m_fill = 0;
+	if( m_draws.empty() || m_draws[0].size() < MAXBATCH ) return;
+
+	// Store full: merge adjacent batches.
+	for( size_t i = 0; i < m_draws.size(); i++ )
+	{
+		std::vector<double>& x = m_draws[i];
+		for( size_t k = 0; k < MAXBATCH / 2; k++ ) x[k] = 0.5 * (x[2 * k] + x[2 * k + 1]);
+		x.resize(MAXBATCH / 2);
+	}
+	m_batch *= 2;
+}
+
+
+/** \brief Recompute the diagnostics of all columns and the status. **/
+ConvergenceMonitor::Status ConvergenceMonitor::update()
+{
+	const long long n = getCount();
+	if( n < MIN_DRAWS )
+	{
+		m_status = WAITING;
+		return m_status;
+	}
+	double maxRhat = 1;
+	double minEss  = n;
+	for( size_t i = 0; i < m_draws.size(); i++ )
+	{
+		m_rhat[i] = splitRhat(m_draws[i]);
+		m_ess[i]  = splitEss(m_draws[i]);
+		if( m_batch > 1 && std::isfinite(m_ess[i]) )
+		{
+			// Var(mean) = varPlus/ess of the batch means; ess of the draws = var(x)/Var(mean).
+			m_ess[i] *= m_ss[i] / (n - 1) / splitVarPlus(m_draws[i]);
+		}
+		if( m_rhat[i] > maxRhat ) maxRhat = m_rhat[i];
+		if( m_ess[i] < minEss ) minEss = m_ess[i];
+	}
+	if( maxRhat < RHAT_OK && minEss >= ESS_OK ) m_status = CONVERGED;
+	else if( maxRhat > RHAT_FAIL && n >= MIN_FAIL ) m_status = FAILING;
+	else m_status = RUNNING;
+	return m_status;
+}
+
+
+const char* ConvergenceMonitor::statusName(const Status& s)
+{
+	switch( s )
+	{
+		case WAITING:   return "waiting";
+		case RUNNING:   return "running";
+		case CONVERGED: return "converged";
+		case FAILING:   return "not-converging";
+	}
+	return "";
+}
+
+
+/** \brief Table of the diagnostics: name, mean, sd, rhat, ess (NA for constant columns). **/
+void ConvergenceMonitor::write(std::ostream& os) const
+{
+	os<<"name mean sd rhat ess\n";
+	for( size_t i = 0; i < m_names.size(); i++ )
+	{
+		double sd = m_count > 1 ? sqrt(m_ss[i] / (m_count - 1)) : NAN;
+		os<<m_names[i]<<" "<<m_mean[i]<<" "<<sd;
+		if( std::isfinite(m_rhat[i]) ) os<<" "<<m_rhat[i]<<" "<<floor(m_ess[i] + 0.5)<<'\n';
+		else os<<" NA NA\n";
+	}
+}
+
+
+/// Means and variances of the two halves of x (the middle draw of an odd count is dropped).
+static bool halves(const std::vector<double>& x, size_t& n, double mean[2], double var[2])
+{
+	n = x.size() / 2;
+	if( n < 2 ) return false;
+	size_t i = 1;
+	while( i < x.size() && x[i] == x[0] ) i++;
+	if( i == x.size() ) return false;
+	const size_t off[2] = {0, x.size() - n};
+	for( int c = 0; c < 2; c++ )
+	{
+		double m = 0, s = 0;
+		for( size_t i = 0; i < n; i++ ) m += x[off[c] + i];
+		m /= n;
+		for( size_t i = 0; i < n; i++ ) s += (x[off[c] + i] - m) * (x[off[c] + i] - m);
+		mean[c] = m;
+		var[c]  = s / (n - 1);
+	}
+	return true;
+}
+
+
+/// Autocovariance at lag t, averaged over the two halves.
+static double acov(const std::vector<double>& x, const size_t off[2], const double mean[2], const size_t& n, const size_t& t)
+{
+	double s = 0;
+	for( int c = 0; c < 2; c++ )
+	{
+		for( size_t i = 0; i + t < n; i++ )
+			s += (x[off[c] + i] - mean[c]) * (x[off[c] + i + t] - mean[c]);
+	}
+	return 0.5 * s / n;
+}
+
+
+/** \brief Split-R-hat of x, NaN for fewer than 4 draws or a constant x. **/
+double ConvergenceMonitor::splitRhat(const std::vector<double>& x)
+{
+	size_t n;
+	double mean[2], var[2];
+	if( !halves(x, n, mean, var) ) return NAN;
+	double W = 0.5 * (var[0] + var[1]);
+	double B = n * 0.5 * (mean[0] - mean[1]) * (mean[0] - mean[1]);	// n * var(means), m-1 = 1
+	double varPlus = (n - 1.0) / n * W + B / n;
+	return sqrt(varPlus / W);
+}
+
+
+/** \brief Marginal variance estimate (var+) of the split R-hat, NaN as splitRhat. **/
+double ConvergenceMonitor::splitVarPlus(const std::vector<double>& x)
+{
+	size_t n;
+	double mean[2], var[2];
+	if( !halves(x, n, mean, var) ) return NAN;
+	double W = 0.5 * (var[0] + var[1]);
+	double B = n * 0.5 * (mean[0] - mean[1]) * (mean[0] - mean[1]);
+	return (n - 1.0) / n * W + B / n;
+}
+
+
+/** \brief Effective sample size of x from its two halves, NaN as splitRhat. **/
+double ConvergenceMonitor::splitEss(const std::vector<double>& x)
+{
+	size_t n;
+	double mean[2], var[2];
+	if( !halves(x, n, mean, var) ) return NAN;
+	const size_t off[2] = {0, x.size() - n};
+	double W = 0.5 * (var[0] + var[1]);
+	double B = n * 0.5 * (mean[0] - mean[1]) * (mean[0] - mean[1]);
+	double varPlus = (n - 1.0) / n * W + B / n;
+
+	std::vector<double> rho(n + 1, 0.0);
+	double rhoEven = 1;
+	double rhoOdd  = 1 - (W - acov(x, off, mean, n, 1)) / varPlus;
+	rho[0] = rhoEven;
+	rho[1] = rhoOdd;
+	size_t t = 1;
+	while( t + 5 < n && rhoEven + rhoOdd > 0 )
+	{
+		rhoEven = 1 - (W - acov(x, off, mean, n, t + 1)) / varPlus;
+		rhoOdd  = 1 - (W - acov(x, off, mean, n, t + 2)) / varPlus;
+		if( rhoEven + rhoOdd >= 0 )
+		{
+			rho[t + 1] = rhoEven;
+			rho[t + 2] = rhoOdd;
+		}
+		t += 2;
+	}
+	const size_t maxT = t;
+	if( rhoEven > 0 ) rho[maxT + 1] = rhoEven;
+
+	// Geyer's initial monotone sequence (t <= maxT - 3 as in Stan).
+	for( t = 1; t + 3 <= maxT; t += 2 )
+	{
+		if( rho[t + 1] + rho[t + 2] > rho[t - 1] + rho[t] )
+		{
+			rho[t + 1] = 0.5 * (rho[t - 1] + rho[t]);
+			rho[t + 2] = rho[t + 1];
+		}
+	}
+	double ess = 2.0 * n;
+	double tau = -1;
+	for( t = 0; t < maxT; t++ ) tau += 2 * rho[t];
+	tau += rho[maxT + 1];
+	if( tau < 1 / log10(ess) ) tau = 1 / log10(ess);
+	return ess / tau;
+}
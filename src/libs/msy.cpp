@@ -29,6 +29,7 @@ Msy::Msy(double ro, double h, double m, double rho, dvector wa, dvector fa, dmat
 	m_d3_V.allocate(1,1,1,m_ngear,m_sage,m_nage);
 	m_d3_V(1) = V;
 	
+	allocateWorkspace();
 	calc_phie();
 }
 
@@ -46,10 +47,34 @@ Msy::Msy(double ro, double h, dmatrix m, double rho, dmatrix wa, dmatrix fa, con
 	m_d3_V  = *V;
 
 	m_FAIL  = false;
+	m_sage  = m_dWa.colmin();
+	m_nage  = m_dWa.colmax();
+	m_ngear = m_d3_V(1).rowmax();
 
+	allocateWorkspace();
 	calc_phie(m_dM,m_dFa);
 }
 
+/** \brief Allocate the work arrays used by calcEquilibrium
+	
+	Sizes the workspace and the member vectors that are overwritten on
+	each call to calcEquilibrium from (ngrp, ngear, sage..nage), so that
+	the Newton iterations in get_fmsy do not allocate memory.
+	
+	\sa calcEquilibrium
+**/
+void Msy::allocateWorkspace()
+{
+	int ngrp = m_dWa.rowmax();
+	m_ws.allocate(ngrp,m_ngear,m_sage,m_nage);
+	m_lz.allocate(1,ngrp,m_sage,m_nage);
+	m_phiq.allocate(1,m_ngear);
+	m_ye.allocate(1,m_ngear);
+	m_f.allocate(1,m_ngear);
+	m_g.allocate(1,m_ngear);
+	m_p.allocate(1,m_ngear);
+}
+
 /** \brief Use Newton-Raphson method to get Fmsy
 	
 	
@@ -465,7 +490,7 @@ void Msy::calcEquilibrium(const dvector& fe)
 	/*
 
 
-		 July 31, 2013.
+		 July 31, 2013.
 		Created by Steve Martell.  Copied from calc_equilibrium
 		- This routine has been modified from the previous to include sex-spcific 
 		  information in the age-schedules. The basic yield equation for each
@@ -479,198 +504,149 @@ void Msy::calcEquilibrium(const dvector& fe)
 		
 		- [] Bug, with ngear > 1 get much lower Re values than if ngear ==1?
 
+		- All temporaries now live in the workspace m_ws (see allocateWorkspace)
+		  and the Newton system is solved without forming inv(d2ye).  The
+		  spawning survivorship (lw) terms were dropped as phif uses lz.
 
 	*/
 	
 	// Indexes for dimensions
 	int h,j,k;
 	int sage,nage,ngear,ngrp;
-	sage  = m_dWa.colmin();
-	nage  = m_dWa.colmax();
-	ngear = m_d3_V(1).rowmax();
+	sage  = m_sage;
+	nage  = m_nage;
+	ngear = m_ngear;
 	ngrp  = m_dWa.rowmax();
 	
-	m_lz.allocate(1,ngrp,sage,nage);
-
 	double      ro = m_ro;
 	double   kappa = 4.0*m_h/(1.0-m_h);  // Beverton-Holt model
 	double     km1 = kappa-1.0;
 	double    phif = 0;
-	double   phisf = 0;
 	double   phif2 = 0;
 	
-	// Survivorship for fished conditions.
-	dvector   lz(sage,nage);
-	dvector   lw(sage,nage);
-	dvector   za(sage,nage);
-	dvector  pza(sage,nage);
-	dvector   sa(sage,nage);
-	dvector  psa(sage,nage);
-	dvector   oa(sage,nage);
-	dvector  poa(sage,nage);
-
-	dmatrix lz_m(1,ngrp,sage,nage);
-	dmatrix lw_m(1,ngrp,sage,nage);
-	dmatrix za_m(1,ngrp,sage,nage);
-	dmatrix oa_m(1,ngrp,sage,nage);
-	dmatrix sa_m(1,ngrp,sage,nage);
-
-	dmatrix   qa(1,ngear,sage,nage);
-	dmatrix  dlz(1,ngear,sage,nage);
-	dmatrix d2lz(1,ngear,sage,nage);
-	dmatrix  dlw(1,ngear,sage,nage);
-	dmatrix d2lw(1,ngear,sage,nage);
-	dlz.initialize();
-	d2lz.initialize();
-	dlw.initialize();
-	d2lw.initialize();
-
-	d3_array   qa_m(1,ngrp,1,ngear,sage,nage);
-	d3_array  dlz_m(1,ngrp,1,ngear,sage,nage);
-	d3_array d2lz_m(1,ngrp,1,ngear,sage,nage);
-	d3_array  dlw_m(1,ngrp,1,ngear,sage,nage);
-	d3_array d2lw_m(1,ngrp,1,ngear,sage,nage);
+	dvector &phiq   = m_ws.phiq;
+	dvector &dphif  = m_ws.dphif;
+	dvector &d2phif = m_ws.d2phif;
+	dvector &dre    = m_ws.dre;
+	dvector &d2re   = m_ws.d2re;
+	dvector &dye    = m_ws.dye;
+	dmatrix &dphiq  = m_ws.dphiq;   // only the diagonal is used here
+	dmatrix &d2phiq = m_ws.d2phiq;  // only the diagonal is used here
+	dmatrix &d2ye   = m_ws.d2ye;
 
 	for( h = 1; h <= ngrp; h++ )
 	{
-		// dvector za  = m_dMt(h) + fe * m_d3_V;
-		za = m_dM(h);
-		for( k = 1; k <= ngear; k++ )
+		dvector &za   = m_ws.za(h);
+		dvector &sa   = m_ws.sa(h);
+		dvector &oa   = m_ws.oa(h);
+		dvector &lz   = m_ws.lz(h);
+		dmatrix &qa   = m_ws.qa(h);
+		dmatrix &dlz  = m_ws.dlz(h);
+		dmatrix &d2lz = m_ws.d2lz(h);
+		const dmatrix &V = m_d3_V(h);
+
+		for( j = sage; j <= nage; j++ )
 		{
-			za  = za + fe(k) * m_d3_V(h)(k);
+			za(j) = m_dM(h,j);
+			for( k = 1; k <= ngear; k++ )
+			{
+				za(j) += fe(k) * V(k,j);
+			}
+			sa(j) = exp(-za(j));
+			oa(j) = 1.-sa(j);
+			for( k = 1; k <= ngear; k++ )
+			{
+				qa(k,j) = V(k,j)*m_dWa(h,j)*oa(j)/za(j);
+			}
 		}
-		za_m(h) = za;
-
-		pza     = m_rho*za;
-		sa      = exp(-za);
-		sa_m(h) = sa;
-		psa     = exp(-pza);
-		oa      = 1.-sa;
-		oa_m(h) = oa;
-		poa     = 1.-elem_prod(sa,psa);
 		for(k=1;k<=ngear;k++)
 		{
-			qa(k)        = elem_div(elem_prod(elem_prod(m_d3_V(h)(k),m_dWa(h)),oa),za);
 			dlz(k,sage)  = 0;
-			dlz_m(h,k,sage) = 0;
 			d2lz(k,sage) = 0;
-			d2lz_m(h,k,sage) = 0;
-			dlw(k,sage)  = -psa(sage)*m_rho*m_d3_V(h)(k)(sage);
-			dlw_m(h,k,sage) = 0;
-			d2lw(k,sage) =  psa(sage)*square(m_rho)*square(m_d3_V(h)(k)(sage));
-			dlw_m(h,k,sage) = 0;
-			qa_m(h)(k)   = qa(k);
 		}
 		
 		lz(sage) = 1.0/ngrp;
-		lw(sage) = 1.0/ngrp * psa(sage);
 		for(j=sage+1; j<=nage; j++)
 		{
 			lz(j)   = lz(j-1) * sa(j-1);
-			lw(j)   = lz(j)   * psa(j);
 			if( j==nage )
 			{
 				lz(j) = lz(j)/oa(j);
-				lw(j) = lz(j-1)*sa(j-1)*psa(j)/oa(j);
 			}
 			
 			for(k=1; k<=ngear; k++)
 			{
+				double V1  = V(k,j-1);
+
 				// derivatives for survivorship
-				dlz(k)(j)  = sa(j-1) * ( dlz(k)(j-1) - lz(j-1)*m_d3_V(h)(k)(j-1) );
-				d2lz(k)(j) = sa(j-1) * ( d2lz(k)(j-1)+ lz(j-1)*m_d3_V(h)(k)(j-1)*m_d3_V(h)(k)(j-1) );
-				
-				// derivatives for spawning survivorship
-				dlw(k)(j)  = -lz(j)*m_rho*m_d3_V(h)(k)(j)*psa(j); 
-				d2lw(k)(j) =  lz(j)*square(m_rho)*square(m_d3_V(h)(k)(j))*psa(j);
+				dlz(k,j)  = sa(j-1) * ( dlz(k,j-1) - lz(j-1)*V1 );
+				d2lz(k,j) = sa(j-1) * ( d2lz(k,j-1)+ lz(j-1)*V1*V1 );
 				
 				if( j==nage ) // + group derivatives
 				{
-					dlz(k)(j)  = dlz(k)(j)/oa(j) - lz(j-1)*sa(j-1)*m_d3_V(h)(k)(j)*sa(j)/square(oa(j));
-					
-					dlw(k)(j)  = -lz(j-1)*sa(j-1)*m_rho*m_d3_V(h)(k)(j)/oa(j)
-								- lz(j-1)*psa(j)*m_d3_V(h)(k)(j)*sa(j)/square(oa(j));
-					
-					double V1  = m_d3_V(h)(k)(j-1);
-					double V2  = m_d3_V(h)(k)(j);
+					double V2  = V(k,j);
 					double oa2 = oa(j)*oa(j);
+
+					dlz(k,j)  = dlz(k,j)/oa(j) - lz(j-1)*sa(j-1)*V2*sa(j)/oa2;
 					
-					d2lz(k)(j) = d2lz(k)(j)/oa(j) 
+					d2lz(k,j) = d2lz(k,j)/oa(j) 
 								+ 2*lz(j-1)*V1*sa(j-1)*V2*sa(j)/oa2
 								+ 2*lz(j-1)*sa(j-1)*V2*V2*sa(j)*sa(j)/(oa(j)*oa2)
 								+ lz(j-1)*sa(j-1)*V2*V2*sa(j)/oa2;
-					
-					d2lw(k)(j) = lz(j-1)*square(m_rho)*square(V2)*psa(j)/oa(j)
-								+ 2*lz(j-1)*m_rho*square(V2)*psa(j)*sa(j)/oa2
-								+ 2*lz(j-1)*psa(j)*square(V2)*square(sa(j))/(oa(j)*oa2)
-								+ lz(j-1)*psa(j)*square(V2)*sa(j)/oa2;
 				}
-				dlz_m(h,k,j)  =  dlz(k)(j);
-				d2lz_m(h,k,j) = d2lz(k)(j);
-				dlw_m(h,k,j)  =  dlw(k)(j);
-				d2lw_m(h,k,j) = d2lw(k)(j);
-
 			}// gear		
 		}// age
-		lz_m(h) = lz;
-		lw_m(h) = lw;
-		phisf += lz * m_dFa(h);
-		phif  += lz * m_dFa(h);
+		for( j = sage; j <= nage; j++ )
+		{
+			phif += lz(j) * m_dFa(h,j);
+		}
 		
 	}// ngrp
 	phif2 = phif*phif;
-	m_lz  = lz_m;
+	m_lz  = m_ws.lz;
 	
 	// Incidence functions and associated derivatives
-	dvector  dphif(1,ngear);   dphif.initialize();
-	dvector d2phif(1,ngear);  d2phif.initialize();
-	dvector   phiq(1,ngear);    phiq.initialize();
-	dvector  dphiq(1,ngear);   dphiq.initialize();
-	dvector d2phiq(1,ngear);  d2phiq.initialize();
-	dvector    dre(1,ngear);     dre.initialize();
-	dvector   d2re(1,ngear);    d2re.initialize();
-	dvector     t1(sage,nage);    t1.initialize();
+	dphif.initialize();
+	d2phif.initialize();
+	phiq.initialize();
+	dphiq.initialize();
+	d2phiq.initialize();
 	
 	for( h = 1; h <= ngrp; h++ )
 	{	
+		dvector &za   = m_ws.za(h);
+		dvector &sa   = m_ws.sa(h);
+		dvector &oa   = m_ws.oa(h);
+		dvector &lz   = m_ws.lz(h);
+		dmatrix &qa   = m_ws.qa(h);
+		dmatrix &dlz  = m_ws.dlz(h);
+		dmatrix &d2lz = m_ws.d2lz(h);
+		const dmatrix &V = m_d3_V(h);
+
 		for(k=1; k<=ngear; k++)
 		{
-			dphif(k)  += dlz_m(h)(k)  * m_dFa(h);
-			d2phif(k) += d2lz_m(h)(k) * m_dFa(h);
-			//dphif(k)   += dlw_m(h)(k)  * m_dFa(h);
-			//d2phif(k)  += d2lw_m(h)(k) * m_dFa(h);
-			
-			// per recruit yield
-			phiq(k)   +=  lz_m(h) * qa_m(h)(k);
-			if(ngear>=1)  // was (if ngear==1), changed during debugging of nfleet>1
+			for( j = sage; j <= nage; j++ )
 			{
+				dphif(k)  += dlz(k,j)  * m_dFa(h,j);
+				d2phif(k) += d2lz(k,j) * m_dFa(h,j);
+				
+				// per recruit yield
+				phiq(k)   += lz(j) * qa(k,j);
+
 				// dphiq = wa*oa*va*dlz/za + lz*wa*va^2*sa/za - lz*wa*va^2*oa/za^2
-				t1 = elem_div(elem_prod(elem_prod(lz_m(h),m_dWa(h)),square(m_d3_V(h)(k))),za_m(h));
-			}
-			else
-			{
-				// dphiq = wa*oa*va*dlz/za + lz*wa*va*sa/za - lz*wa*va*oa/za^2
-				t1 = elem_div(elem_prod(elem_prod(lz_m(h),m_dWa(h)),m_d3_V(h)(k)),za_m(h));
+				double t0  = oa(j)/za(j);
+				double t5  = m_dWa(h,j)*V(k,j)*V(k,j)/za(j);
+				double t13 = lz(j)*t5;
+				dphiq(k,k) += qa(k,j)*dlz(k,j) + t13*(sa(j)-t0);
+
+				// 2nd derivative for per recruit yield (nasty)
+				d2phiq(k,k) += d2lz(k,j)*qa(k,j)
+				             + 2.*dlz(k,j)*t5*sa(j)
+				             - 2.*dlz(k,j)*t5*t0
+				             - t13*V(k,j)*sa(j)
+				             - 2.*t13*V(k,j)*sa(j)/za(j)
+				             + 2.*t13*V(k,j)*t0/za(j);
 			}
-			dvector t0 = elem_div(oa_m(h),za_m(h));
-			dvector t3 = sa_m(h)-t0;
-			dphiq(k)  += qa_m(h)(k)*dlz_m(h)(k) + t1 * t3;
-			
-			// 2nd derivative for per recruit yield (nasty)
-			dvector t2  = 2. * dlz_m(h)(k);
-			dvector V2  = elem_prod(m_d3_V(h)(k),m_d3_V(h)(k));
-			dvector t5  = elem_div(elem_prod(m_dWa(h),V2),za_m(h));
-			dvector t7  = elem_div(m_d3_V(h)(k),za_m(h));
-			dvector t9  = elem_prod(t5,sa_m(h));
-			dvector t11 = elem_prod(t5,t0);
-			dvector t13 = elem_prod(lz_m(h),t5);
-			dvector t14 = elem_prod(m_d3_V(h)(k),sa_m(h));
-			dvector t15 = elem_prod(t7,sa_m(h));
-			dvector t17 = elem_prod(m_d3_V(h)(k),t0);
-			dvector t18 = elem_div(t17,za_m(h));
-			d2phiq(k)  += d2lz_m(h)(k)*qa_m(h)(k) 
-						+ t2*t9 - t2*t11 - t13*t14 -2.*t13*t15 
-						+ 2.*t13*t18;
 		}   // gear
 	}  // ngrp
 			
@@ -683,77 +659,59 @@ void Msy::calcEquilibrium(const dvector& fe)
 	}		
 	
 	// Equilibrium calculations
-	double    re;
-	dvector   ye(1,ngear);
-	dvector fstp(1,ngear);
-	dvector  dye(1,ngear);
-	dmatrix d2ye(1,ngear,1,ngear);
-	dmatrix invJ(1,ngear,1,ngear);
-
-	// cout<<"Ro = "<<ro<<endl;
-	// cout<<"kappa="<<kappa<<endl;
-	// cout<<"phie=" <<m_phie<<endl;
-	// cout<<"phif = "<<phif<<endl;
-	// cout<<"km1 = "<<km1<<endl;
-
-
-	re   = ro*(kappa-m_phie/phif) / km1;
-	ye   = re*elem_prod(fe,phiq);
-	// dye  = re*phiq + elem_prod(fe,elem_prod(phiq,dre)) + elem_prod(fe,re*dphiq);
-	dye  = re*phiq + elem_prod(fe,phiq)*dre + (fe*re)*dphiq;
+	// dye  = re*phiq + elem_prod(fe,phiq)*dre + (fe*re)*dphiq;
+	// where the last two terms are inner products (common to all gears).
+	double re   = ro*(kappa-m_phie/phif) / km1;
+	double sdre = 0;
+	double sdphiq = 0;
+	for( k = 1; k <= ngear; k++ )
+	{
+		sdre   += fe(k)*phiq(k)*dre(k);
+		sdphiq += fe(k)*re*dphiq(k,k);
+	}
+	for( k = 1; k <= ngear; k++ )
+	{
+		m_ye(k) = re*fe(k)*phiq(k);
+		dye(k)  = re*phiq(k) + sdre + sdphiq;
+	}
 
-	// cout<<"Re     = "<<re<<endl;
-	// cout<<"phiq   = "<<phiq<<endl;
-	// cout<<"fe     = "<<fe<<endl;
-	// cout<<"dre    = "<<dre<<endl;
-	// cout<<"dphiq  = "<<dphiq<<endl;
-	// cout<<"dye    = "<<dye<<endl;
-	
 	// Caclculate Jacobian matrix (2nd derivative of the catch equation)
 	for(j=1; j<=ngear; j++)
 	{
 		for(k=1; k<=ngear; k++)
 		{
-			d2ye(k)(j) = fe(j)*phiq(j)*d2re(k) + 2.*fe(j)*dre(k)*dphiq(k) + fe(j)*re*d2phiq(k);
+			d2ye(k,j) = fe(j)*phiq(j)*d2re(k) + 2.*fe(j)*dre(k)*dphiq(k,k) 
+			          + fe(j)*re*d2phiq(k,k);
 			if(k == j)
 			{
-				d2ye(j)(k) += 2.*dre(j)*phiq(j)+2.*re*dphiq(j);
+				d2ye(j,k) += 2.*dre(j)*phiq(j)+2.*re*dphiq(j,j);
 			}
 		} 
 	}
 
-	// Newton-Raphson step.
-	// cout<<"Second Derivatives \n"<<d2ye <<endl;
-	invJ   = -inv(d2ye);
-	//cout<<"B"<<endl;
-	fstp   = invJ * dye;  
+	// Newton-Raphson step: fstp = -inv(d2ye) * dye
+	m_ws.A = d2ye;
+	const dvector &x = m_ws.solve(dye);
 	
 	// Set private members
-	m_p    = fstp;
-	m_ye   = ye;
-	// cout<<"Re =    "<<re<<endl;
+	double dYe  = 0;
+	double d2Ye = 0;
+	for( k = 1; k <= ngear; k++ )
+	{
+		m_p(k) = -x(k);
+		m_g(k) = d2ye(k,k);		//Gradient vector
+		m_f(k) = dye(k);		//Value of the function to minimize
+		dYe   += dye(k);
+		d2Ye  += d2ye(k,k);
+	}
 	m_re   = re;
 	m_be   = re*phif;
-	m_bi   = re*phisf;
+	m_bi   = re*phif;
 	m_phif = phif;
 	m_phiq = phiq;
 	m_spr  = phif/m_phie;
-	m_dYe  = sum(dye);
-	m_d2Ye = sum(diagonal(d2ye));
-	m_g    = diagonal(d2ye);		//Gradient vector
-	m_f    = dye;   				//Value of the function to minimize
-	
-	// cout<<"mean za = "<<mean(za_m)<<endl;
-
-	// numerical test for dre passed for 2+ fleets.
-	// numerical test for dphif failed.
-    // numerical test for dphiq passed for 1 fleet, fails on 2+ fleets.
-
-
-	// cout<<"fe "<<setw(8)<<fe<<" re "<<setw(8)<<re<<" ye "<<setw(8)<<ye
-	    // <<" dye "<<setw(8)<<dye<<endl;
-	// cout<<"dlz_m"<<endl<<dlz_m<<endl;
-
+	m_dYe  = dYe;
+	m_d2Ye = d2Ye;
 }
 
 
@@ -852,7 +810,6 @@ void Msy::calc_phie(const dmatrix& _m, const dmatrix& _fa)
 
 	// [] TODO: check the discrepency between bo here and bo in calcStockRecruitment.
 	m_bo = m_ro * m_phie;
-	cout<<m_bo<<endl;
 	
 }
 
@@ -0,0 +1,89 @@
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include "../../include/output_manifest.h"
+#include "../../include/Logger.h"
+
+static const char* SERIES[] = {"mcmc", "sbt", "rt", "ft", "rdev", "vbt", "ut", "proj"};
+static const int   NSERIES  = sizeof(SERIES) / sizeof(SERIES[0]);
+
+/// Constructor, every series is on until a manifest is read.
+OutputManifest::OutputManifest()
+{
+	for( int i = 0; i < NSERIES; i++ ) m_series[SERIES[i]] = Series(true);
+}
+
+
+/** \brief Read a manifest file, false (with a message in the log) on errors.
+
+	Series that are not in the file are turned off.
+**/
+bool OutputManifest::read(const std::string& filename)
+{
+	std::ifstream ifs(filename.c_str());
+	if( !ifs )
+	{
+		LOG<<"Cannot open the output manifest "<<filename<<'\n';
+		return false;
+	}
+	for( int i = 0; i < NSERIES; i++ ) m_series[SERIES[i]] = Series(false);
+
+	std::string line;
+	int lineno = 0;
+	while( std::getline(ifs, line) )
+	{
+		lineno++;
+		size_t hash = line.find('#');
+		if( hash != std::string::npos ) line.erase(hash);
+
+		std::istringstream iss(line);
+		std::string name, groups("all"), years("all");
+		if( !(iss>>name) ) continue;
+		iss>>groups>>years;
+
+		std::map<std::string, Series>::iterator it = m_series.find(name);
+		if( it == m_series.end() )
+		{
+			LOG<<filename<<" line "<<lineno<<": unknown series "<<name<<'\n';
+			return false;
+		}
+		Series s(true);
+		if( groups != "all" )
+		{
+			std::istringstream gs(groups);
+			std::string g;
+			while( std::getline(gs, g, ',') )
+			{
+				int ig = atoi(g.c_str());
+				if( ig < 1 )
+				{
+					LOG<<filename<<" line "<<lineno<<": bad group "<<g<<'\n';
+					return false;
+				}
+				s.groups.push_back(ig);
+			}
+		}
+		if( years != "all" )
+		{
+			size_t colon = years.find(':');
+			s.syr = atoi(years.substr(0, colon).c_str());
+			s.nyr = colon == std::string::npos ? s.syr : atoi(years.substr(colon+1).c_str());
+			if( s.syr < 1 || s.nyr < s.syr )
+			{
+				LOG<<filename<<" line "<<lineno<<": bad years "<<years<<'\n';
+				return false;
+			}
+		}
+		it->second = s;
+	}
+	return true;
+}
+
+
+/** \brief Selection for series name (off for names that are not known). **/
+const OutputManifest::Series& OutputManifest::get(const std::string& name) const
+{
+	static const Series off(false);
+	std::map<std::string, Series>::const_iterator it = m_series.find(name);
+	return it == m_series.end() ? off : it->second;
+}
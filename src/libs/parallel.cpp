@@ -0,0 +1,55 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "../../include/parallel.h"
+#include "../../include/Logger.h"
+
+namespace parallel
+{
+  static int defaultThreadCount(){
+    int n = static_cast<int>(std::thread::hardware_concurrency());
+    return n > 0 ? n : 1;
+  }
+
+  static int nThreads = defaultThreadCount();
+
+  int getThreadCount(){
+    return nThreads;
+  }
+
+  void setThreadCount(const int n){
+    nThreads = n > 0 ? n : defaultThreadCount();
+  }
+
+  void for_each(const int first, const int last, const std::function<void(int)> &body){
+    const int n = last - first + 1;
+    if(n <= 0){
+      return;
+    }
+    const int nt = nThreads < n ? nThreads : n;
+    if(nt <= 1){
+      for(int i = first; i <= last; i++){
+        body(i);
+      }
+      return;
+    }
+
+    // Each thread pulls the next index until the range is exhausted.
+    std::atomic<int> next(first);
+    std::vector<std::thread> pool;
+    pool.reserve(nt - 1);
+    auto worker = [&](){
+      int i;
+      while((i = next++) <= last){
+        body(i);
+      }
+    };
+    for(int t = 1; t < nt; t++){
+      pool.push_back(std::thread(worker));
+    }
+    worker();
+    for(size_t t = 0; t < pool.size(); t++){
+      pool[t].join();
+    }
+  }
+}
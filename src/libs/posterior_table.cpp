@@ -0,0 +1,507 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+#include <admodel.h>
+#include "../../include/posterior_table.h"
+#include "../../include/Logger.h"
+
+static const char POST_MAGIC[8] = {'I','P','O','S','T',0,0,0};
+static const int  POST_VERSION  = 1;
+static const size_t BLOCK_BYTES = 64 << 20;	// memory for transposing / exporting
+
+/// The file is little-endian, byte swap on a big-endian host.
+static bool littleEndian()
+{
+	const uint16_t x = 1;
+	return *reinterpret_cast<const char*>(&x) == 1;
+}
+
+static void putBytes(std::ostream& os, const void* p, const size_t& n)
+{
+	if( littleEndian() )
+	{
+		os.write(static_cast<const char*>(p), n);
+		return;
+	}
+	const char* c = static_cast<const char*>(p);
+	for( size_t i = n; i > 0; i-- ) os.put(c[i-1]);
+}
+
+static bool getBytes(std::istream& is, void* p, const size_t& n)
+{
+	char* c = static_cast<char*>(p);
+	if( !is.read(c, n) ) return false;
+	if( !littleEndian() )
+	{
+		for( size_t i = 0; i < n/2; i++ ) std::swap(c[i], c[n-1-i]);
+	}
+	return true;
+}
+
+/// Write n doubles.
+static void putDoubles(std::ostream& os, const double* x, const size_t& n)
+{
+	if( littleEndian() )
+	{
+		os.write(reinterpret_cast<const char*>(x), n*sizeof(double));
+		return;
+	}
+	for( size_t i = 0; i < n; i++ ) putBytes(os, &x[i], sizeof(double));
+}
+
+/// Read n doubles.
+static bool getDoubles(std::istream& is, double* x, const size_t& n)
+{
+	if( littleEndian() )
+	{
+		return bool(is.read(reinterpret_cast<char*>(x), n*sizeof(double)));
+	}
+	for( size_t i = 0; i < n; i++ )
+	{
+		if( !getBytes(is, &x[i], sizeof(double)) ) return false;
+	}
+	return true;
+}
+
+static void putString(std::ostream& os, const std::string& s)
+{
+	int32_t n = s.size();
+	putBytes(os, &n, sizeof(n));
+	os.write(s.data(), n);
+}
+
+static bool getString(std::istream& is, std::string& s)
+{
+	int32_t n;
+	if( !getBytes(is, &n, sizeof(n)) || n < 0 ) return false;
+	s.resize(n);
+	return n == 0 || bool(is.read(&s[0], n));
+}
+
+
+PosteriorHeader::PosteriorHeader()
+:version(POST_VERSION),layout(0),ndraw(0),ncol(0),offset(0)
+{
+}
+
+
+/** \brief Write the header and set offset to the start of the data. **/
+void PosteriorHeader::write(std::ostream& os)
+{
+	int32_t v = version;
+	int32_t l = layout;
+	int64_t n = ndraw;
+	int64_t c = names.size();
+	ncol = c;
+
+	long long len = sizeof(POST_MAGIC) + 2*sizeof(int32_t) + 3*sizeof(int64_t);
+	len += sizeof(int32_t) + dims.size();
+	for( size_t i = 0; i < names.size(); i++ ) len += sizeof(int32_t) + names[i].size();
+	offset = (len + 7) / 8 * 8;
+	int64_t o = offset;
+
+	os.write(POST_MAGIC, sizeof(POST_MAGIC));
+	putBytes(os, &v, sizeof(v));
+	putBytes(os, &l, sizeof(l));
+	putBytes(os, &n, sizeof(n));
+	putBytes(os, &c, sizeof(c));
+	putBytes(os, &o, sizeof(o));
+	putString(os, dims);
+	for( size_t i = 0; i < names.size(); i++ ) putString(os, names[i]);
+	for( long long i = len; i < offset; i++ ) os.put(0);
+}
+
+
+/** \brief Read the header, false if it is not a posterior file. **/
+bool PosteriorHeader::read(std::istream& is)
+{
+	char magic[sizeof(POST_MAGIC)];
+	int32_t v, l;
+	int64_t n, c, o;
+	if( !is.read(magic, sizeof(magic)) || memcmp(magic, POST_MAGIC, sizeof(magic)) ) return false;
+	if( !getBytes(is, &v, sizeof(v)) || v != POST_VERSION ) return false;
+	if( !getBytes(is, &l, sizeof(l)) || !getBytes(is, &n, sizeof(n))
+	 || !getBytes(is, &c, sizeof(c)) || !getBytes(is, &o, sizeof(o)) ) return false;
+	version = v;
+	layout  = l;
+	ndraw   = n;
+	ncol    = c;
+	offset  = o;
+	if( !getString(is, dims) ) return false;
+	names.resize(ncol);
+	for( long long i = 0; i < ncol; i++ )
+	{
+		if( !getString(is, names[i]) ) return false;
+	}
+	return true;
+}
+
+
+PosteriorSummary::PosteriorSummary()
+:m_count(0)
+{
+}
+
+
+/** \brief Reset the summary for the columns in names. **/
+void PosteriorSummary::allocate(const std::vector<std::string>& names)
+{
+	const double prob[NPROB] = {0.025, 0.5, 0.975};
+	m_names = names;
+	m_count = 0;
+	m_mean.assign(names.size(), 0);
+	m_m2.assign(names.size(), 0);
+	m_quant.clear();
+	for( size_t c = 0; c < names.size(); c++ )
+	{
+		for( int q = 0; q < NPROB; q++ ) m_quant.push_back(P2Quantile(prob[q]));
+	}
+}
+
+
+/** \brief Add one draw, x has a value for every column. **/
+void PosteriorSummary::add(const double* x)
+{
+	m_count++;
+	for( size_t c = 0; c < m_names.size(); c++ )
+	{
+		double d   = x[c] - m_mean[c];
+		m_mean[c] += d / m_count;
+		m_m2[c]   += d * (x[c] - m_mean[c]);
+		for( int q = 0; q < NPROB; q++ ) m_quant[c*NPROB+q].add(x[c]);
+	}
+}
+
+
+void PosteriorSummary::writeHeader(std::ostream& os)
+{
+	os<<"series,name,n,mean,sd,q025,q50,q975\n";
+}
+
+
+/** \brief Write one row per column, series is the name of the table. **/
+void PosteriorSummary::write(std::ostream& os, const std::string& series) const
+{
+	for( size_t c = 0; c < m_names.size(); c++ )
+	{
+		double sd = m_count > 1 ? sqrt(m_m2[c] / (m_count-1)) : 0;
+		os<<series<<","<<m_names[c]<<","<<m_count<<","<<m_mean[c]<<","<<sd;
+		for( int q = 0; q < NPROB; q++ ) os<<","<<m_quant[c*NPROB+q].getQuantile();
+		os<<'\n';
+	}
+}
+
+
+PosteriorTable::PosteriorTable()
+:m_binary(false),m_naming(false),m_rows(0),m_offset(0),m_summarize(false),m_rowMajor(false)
+{
+}
+
+
+PosteriorTable::~PosteriorTable()
+{
+	close();
+}
+
+
+/** \brief Start a new file.
+
+	\param  basename file name without extension
+	\param  binary write basename.ipost instead of basename.csv
+	\param  dims dimension string for the binary header
+**/
+void PosteriorTable::open(const std::string& basename, const bool& binary, const std::string& dims)
+{
+	close();
+	m_binary   = binary;
+	m_basename = basename;
+	m_dims     = dims;
+	m_names.clear();
+	m_row.clear();
+	m_rows     = 0;
+	m_naming   = false;
+	if( m_binary )
+	{
+		m_ofs.open((basename + ".ipost.part").c_str(), std::ios::out | std::ios::binary);
+	}
+	else
+	{
+		m_ofs.open((basename + ".csv").c_str());
+	}
+}
+
+
+/** \brief Stream for the name of the next column. **/
+std::ostream& PosteriorTable::name()
+{
+	commitName();
+	m_naming = true;
+	return m_name;
+}
+
+void PosteriorTable::commitName()
+{
+	if( m_naming )
+	{
+		m_names.push_back(m_name.str());
+		m_name.str("");
+		m_naming = false;
+	}
+}
+
+
+void PosteriorTable::writeHeader()
+{
+	if( m_binary )
+	{
+		PosteriorHeader h;
+		h.layout = 0;
+		h.dims   = m_dims;
+		h.names  = m_names;
+		h.write(m_ofs);
+		m_offset = h.offset;
+		return;
+	}
+	for( size_t i = 0; i < m_names.size(); i++ )
+	{
+		if( i ) m_ofs<<",";
+		m_ofs<<m_names[i];
+	}
+	m_ofs<<'\n';
+}
+
+
+/** \brief Finish the current draw. **/
+void PosteriorTable::endRow()
+{
+	commitName();
+	if( m_row.size() != m_names.size() )
+	{
+		LOG<<"Draw "<<m_rows+1<<" of "<<m_basename<<" has "<<int(m_row.size())
+		   <<" values for "<<int(m_names.size())<<" columns\n";
+		ad_exit(1);
+	}
+	if( m_rows == 0 )
+	{
+		writeHeader();
+		if( m_summarize ) m_summary.allocate(m_names);
+	}
+	if( m_summarize && m_row.size() ) m_summary.add(&m_row[0]);
+	if( m_binary )
+	{
+		if( m_row.size() ) putDoubles(m_ofs, &m_row[0], m_row.size());
+	}
+	else
+	{
+		for( size_t i = 0; i < m_row.size(); i++ )
+		{
+			if( i ) m_ofs<<",";
+			m_ofs<<m_row[i];
+		}
+		m_ofs<<'\n';
+	}
+	m_last.swap(m_row);
+	m_row.clear();
+	m_rows++;
+}
+
+
+/** \brief Write the previous draw again (a repeated mceval draw, -memo). **/
+void PosteriorTable::repeatRow()
+{
+	if( m_rows == 0 )
+	{
+		LOG<<"No draw of "<<m_basename<<" to repeat\n";
+		ad_exit(1);
+	}
+	m_row = m_last;
+	endRow();
+}
+
+
+/** \brief Close the file, a binary file is transposed to column-major
+	(unless setRowMajor(true)).
+
+	A table that got no draws (e.g. a manifest series whose years match
+	none of the model years) still gets its header, so the file can be
+	read by posterior_to_csv and posterior_append.
+**/
+void PosteriorTable::close()
+{
+	if( !m_ofs.is_open() ) return;
+	if( m_rows == 0 )
+	{
+		commitName();
+		writeHeader();
+	}
+	m_ofs.close();
+	if( m_binary && !m_rowMajor ) transpose();
+}
+
+
+/** \brief Rewrite basename.ipost.part (row-major) as basename.ipost.
+
+	Columns are done in blocks that fit in BLOCK_BYTES, each block is one
+	pass over the row-major file.
+**/
+void PosteriorTable::transpose()
+{
+	std::string part = m_basename + ".ipost.part";
+	std::string post = m_basename + ".ipost";
+	std::ifstream ifs(part.c_str(), std::ios::binary);
+
+	PosteriorHeader h;
+	h.layout = 1;
+	h.ndraw  = m_rows;
+	h.dims   = m_dims;
+	h.names  = m_names;
+	std::ofstream ofs(post.c_str(), std::ios::binary);
+	h.write(ofs);
+
+	const long long ncol = m_names.size();
+	long long nblock = m_rows ? BLOCK_BYTES / (sizeof(double) * m_rows) : ncol;
+	if( nblock < 1 ) nblock = 1;
+	std::vector<double> row(ncol);
+	for( long long c0 = 0; m_rows && c0 < ncol; c0 += nblock )
+	{
+		long long nc = c0 + nblock < ncol ? nblock : ncol - c0;
+		std::vector<double> buf(nc * m_rows);
+		ifs.clear();
+		ifs.seekg(m_offset);
+		for( long long r = 0; r < m_rows; r++ )
+		{
+			if( !getDoubles(ifs, &row[0], ncol) )
+			{
+				LOG<<"Error reading "<<part<<'\n';
+				return;
+			}
+			for( long long j = 0; j < nc; j++ ) buf[j*m_rows + r] = row[c0+j];
+		}
+		putDoubles(ofs, &buf[0], buf.size());
+	}
+	ifs.close();
+	ofs.close();
+	if( ofs ) std::remove(part.c_str());
+}
+
+
+/** \brief Convert a binary posterior file to the CSV layout of mcmc_output.
+
+	Reads both layouts, including the row-major .ipost.part of a run that
+	did not finish.  Values are written with the default stream precision,
+	as mcmc_output does.
+**/
+bool posterior_to_csv(const std::string& binfile, const std::string& csvfile)
+{
+	std::ifstream ifs(binfile.c_str(), std::ios::binary);
+	PosteriorHeader h;
+	if( !ifs || !h.read(ifs) )
+	{
+		LOG<<binfile<<" is not a posterior file\n";
+		return false;
+	}
+	const long long ncol = h.ncol;
+	long long ndraw = h.ndraw;
+	if( h.layout == 0 && ndraw == 0 && ncol )
+	{
+		ifs.seekg(0, std::ios::end);
+		ndraw = (static_cast<long long>(ifs.tellg()) - h.offset) / (sizeof(double) * ncol);
+	}
+
+	BufferedOfstream ofs;
+	ofs.open(csvfile.c_str());
+	for( long long c = 0; c < ncol; c++ )
+	{
+		if( c ) ofs<<",";
+		ofs<<h.names[c];
+	}
+	ofs<<'\n';
+
+	long long nblock = ncol ? BLOCK_BYTES / (sizeof(double) * ncol) : 1;
+	if( nblock < 1 ) nblock = 1;
+	std::vector<double> buf;
+	for( long long r0 = 0; r0 < ndraw; r0 += nblock )
+	{
+		long long nr = r0 + nblock < ndraw ? nblock : ndraw - r0;
+		buf.resize(nr * ncol);
+		bool ok = true;
+		if( h.layout == 0 )
+		{
+			ifs.clear();
+			ifs.seekg(h.offset + sizeof(double) * r0 * ncol);
+			ok = getDoubles(ifs, &buf[0], buf.size());
+		}
+		else
+		{
+			std::vector<double> col(nr);
+			for( long long c = 0; ok && c < ncol; c++ )
+			{
+				ifs.clear();
+				ifs.seekg(h.offset + sizeof(double) * (c * ndraw + r0));
+				ok = getDoubles(ifs, &col[0], nr);
+				for( long long r = 0; r < nr; r++ ) buf[r*ncol + c] = col[r];
+			}
+		}
+		if( !ok )
+		{
+			LOG<<"Error reading "<<binfile<<'\n';
+			return false;
+		}
+		for( long long r = 0; r < nr; r++ )
+		{
+			for( long long c = 0; c < ncol; c++ )
+			{
+				if( c ) ofs<<",";
+				ofs<<buf[r*ncol + c];
+			}
+			ofs<<'\n';
+		}
+	}
+	return true;
+}
+
+
+/** \brief Append the draws of a row-major binary posterior file to table.
+
+	Used to merge the .ipost.part files of the -pmceval workers in draw
+	order.  The columns of an empty table are named from the file, other
+	tables must have the same number of columns.
+**/
+bool posterior_append(const std::string& binfile, PosteriorTable& table)
+{
+	std::ifstream ifs(binfile.c_str(), std::ios::binary);
+	PosteriorHeader h;
+	if( !ifs || !h.read(ifs) || h.layout != 0 )
+	{
+		LOG<<binfile<<" is not a row-major posterior file\n";
+		return false;
+	}
+	if( table.getColumns() == 0 && table.getRows() == 0 )
+	{
+		for( size_t c = 0; c < h.names.size(); c++ ) table.name()<<h.names[c];
+	}
+	else if( table.getColumns() != h.ncol )
+	{
+		LOG<<binfile<<" has "<<h.ncol<<" columns, expected "<<table.getColumns()<<'\n';
+		return false;
+	}
+
+	const long long ncol = h.ncol;
+	ifs.seekg(0, std::ios::end);
+	long long ndraw = ncol ? (static_cast<long long>(ifs.tellg()) - h.offset) / (sizeof(double) * ncol) : 0;
+	ifs.clear();
+	ifs.seekg(h.offset);
+	std::vector<double> row(ncol);
+	for( long long r = 0; r < ndraw; r++ )
+	{
+		if( ncol && !getDoubles(ifs, &row[0], ncol) )
+		{
+			LOG<<"Error reading "<<binfile<<'\n';
+			return false;
+		}
+		for( long long c = 0; c < ncol; c++ ) table.add(row[c]);
+		table.endRow();
+	}
+	return true;
+}
@@ -0,0 +1,342 @@
+#include "../../include/projection_model.h"
+#include "../../include/Logger.h"
+
+/** \brief Constructor, sizes the projection arrays.
+
+	\param  nprob number of problems (TAC options or draws)
+	\param  allocation fraction of the TAC taken by each gear
+	\param  sage youngest age
+	\param  nage oldest age
+	\param  syr first year of the historical arrays
+	\param  nyr last year of the historical arrays
+	\param  nproj number of projection years after nyr
+	\param  srr stock-recruitment model 1 = Beverton-Holt, 2 = Ricker
+	\param  zfrac fraction of total mortality that takes place prior to spawning
+**/
+ProjectionModel::ProjectionModel(const int& nprob, const dvector& allocation,
+                                 const int& sage, const int& nage,
+                                 const int& syr, const int& nyr, const int& nproj,
+                                 const int& srr, const double& zfrac)
+:m_nprob(nprob),m_ngear(size_count(allocation)),m_sage(sage),m_nage(nage),
+ m_syr(syr),m_nyr(nyr),m_pyr(nyr+nproj),m_srr(srr),m_zfrac(zfrac),
+ m_hcr(0),m_lrp(0),m_usr(0),m_hmax(0),
+ m_baranov(nprob,size_count(allocation),sage,nage)
+{
+	m_alloc.allocate(1,m_ngear);
+	for( int k = 1; k <= m_ngear; k++ )
+	{
+		m_alloc(k) = allocation(allocation.indexmin()+k-1);
+	}
+
+	m_M.allocate(1,nprob,sage,nage);
+	m_fa.allocate(1,nprob,sage,nage);
+	m_wa.allocate(1,nprob,sage,nage);
+	m_va.allocate(1,nprob,1,m_ngear,sage,nage);
+	m_so.allocate(1,nprob);
+	m_beta.allocate(1,nprob);
+	m_tau.allocate(1,nprob);
+	m_bref.allocate(1,nprob);
+	m_hN.allocate(1,nprob,nyr-1,nyr,sage,nage);
+	m_hZ.allocate(1,nprob,nyr-1,nyr,sage,nage);
+	m_xx.allocate(1,nprob,nyr-1,m_pyr);
+
+	m_tac.allocate(1,nprob,nyr+1,m_pyr);
+	m_sbt.allocate(1,nprob,syr,m_pyr);
+	m_ft.allocate(1,nprob,nyr,m_pyr,1,m_ngear);
+	m_clip.allocate(1,nprob,nyr,m_pyr);
+	m_tac.initialize();
+	m_sbt.initialize();
+}
+
+
+/** \brief Copy the inputs of one draw into problem p.
+
+	The draw's reference biomass for the harvest control rule is set by
+	setHarvestControlRule, so call that first when a rule is used.
+**/
+void ProjectionModel::setProblem(const int& p, const ProjectionDraw& d)
+{
+	int i;
+	m_M(p)    = d.M;
+	m_fa(p)   = d.fa;
+	m_wa(p)   = d.wa;
+	for( int k = 1; k <= m_ngear; k++ )
+	{
+		m_va(p,k) = d.va(d.va.rowmin()+k-1);
+	}
+	m_so(p)   = d.so;
+	m_beta(p) = d.beta;
+	m_tau(p)  = d.tau;
+	m_bref(p) = m_hcr == 2 ? d.bmsy : d.bo;
+	for( i = m_nyr-1; i <= m_nyr; i++ )
+	{
+		m_hN(p,i) = d.N(i);
+		m_hZ(p,i) = d.Z(i);
+	}
+	for( i = m_syr; i <= m_nyr; i++ )
+	{
+		m_sbt(p,i) = d.sbt(i);
+	}
+	for( i = m_nyr-1; i <= m_pyr; i++ )
+	{
+		m_xx(p,i) = d.xx(i);
+	}
+}
+
+/** \brief Constant catch in every projection year for problem p. **/
+void ProjectionModel::setTac(const int& p, const double& tac)
+{
+	m_tac(p) = tac;
+}
+
+/** \brief Use a hockey-stick harvest control rule instead of a constant TAC.
+
+	\param  ref reference biomass 1 = Bo, 2 = Bmsy (0 switches the rule off)
+	\param  lrp limit reference point as a fraction of the reference biomass
+	\param  usr upper stock reference as a fraction of the reference biomass
+	\param  hmax harvest rate at and above the upper stock reference
+**/
+void ProjectionModel::setHarvestControlRule(const int& ref, const double& lrp,
+                                            const double& usr, const double& hmax)
+{
+	m_hcr  = ref;
+	m_lrp  = lrp;
+	m_usr  = usr;
+	m_hmax = hmax;
+}
+
+
+/** \brief Project all problems from nyr-1 to pyr.
+
+	M, selectivity and weight do not change with year so they are loaded
+	into the batch once; each year only the numbers and catch of every
+	problem are copied in before the solve.
+
+	\param  threaded share the Baranov solves out over threads (useful when
+	        the problems are many draws).
+**/
+void ProjectionModel::run(const bool& threaded)
+{
+	int i,j,k,p;
+
+	for( p = 1; p <= m_nprob; p++ )
+	{
+		for( k = 1; k <= m_ngear; k++ )
+		{
+			for( j = m_sage; j <= m_nage; j++ )
+			{
+				m_baranov.V(p,k,j) = m_va(p,k,j);
+			}
+		}
+		for( j = m_sage; j <= m_nage; j++ )
+		{
+			m_baranov.M(p,j) = m_M(p,j);
+			m_baranov.W(p,j) = m_wa(p,j);
+		}
+	}
+
+	// State (problem, age) for the current year and the next.
+	dmatrix N(1,m_nprob,m_sage,m_nage);
+	dmatrix Z(1,m_nprob,m_sage,m_nage);
+	dmatrix Nn(1,m_nprob,m_sage,m_nage);
+	dvector surv(m_sage,m_nage);
+	for( p = 1; p <= m_nprob; p++ )
+	{
+		N(p) = m_hN(p,m_nyr-1);
+	}
+	m_ft.initialize();
+	m_clip.initialize();
+
+	for( i = m_nyr-1; i <= m_pyr; i++ )
+	{
+		// ft(nyr) is a function of ct(nyr), so use Z from the model up to nyr.
+		if( i > m_nyr )
+		{
+			for( p = 1; p <= m_nprob; p++ )
+			{
+				if( m_hcr )
+				{
+					double bt = m_sbt(p,i-1);
+					double rb = bt / m_bref(p);
+					double ut = m_hmax;
+					if( rb <= m_lrp )     ut = 0;
+					else if( rb < m_usr ) ut = m_hmax * (rb-m_lrp) / (m_usr-m_lrp);
+					m_tac(p,i) = ut * bt;
+				}
+				for( k = 1; k <= m_ngear; k++ )
+				{
+					m_baranov.ct(p,k) = m_alloc(k) * m_tac(p,i);
+				}
+				for( j = m_sage; j <= m_nage; j++ ) m_baranov.N(p,j) = N(p,j);
+			}
+			m_baranov.solve(threaded);
+			for( p = 1; p <= m_nprob; p++ )
+			{
+				Z(p) = m_M(p);
+				for( k = 1; k <= m_ngear; k++ )
+				{
+					m_ft(p,i,k) = m_baranov.getF(p,k);
+					Z(p)       += m_ft(p,i,k) * m_va(p,k);
+				}
+				m_clip(p,i) = m_baranov.getResult(p).clipped;
+			}
+		}
+		else
+		{
+			for( p = 1; p <= m_nprob; p++ ) Z(p) = m_hZ(p,i);
+		}
+
+		for( p = 1; p <= m_nprob; p++ )
+		{
+			if( i >= m_nyr )
+			{
+				double sb = 0;
+				for( j = m_sage; j <= m_nage; j++ )
+				{
+					sb += N(p,j) * exp(-Z(p,j)*m_zfrac) * m_fa(p,j);
+				}
+				m_sbt(p,i) = sb;
+			}
+
+			// Next year's recruits from the lagged spawning biomass.
+			Nn(p,m_sage) = i+1 <= m_nyr ? m_hN(p,i+1,m_sage) : 0;
+			if( i >= m_syr+m_sage-1 )
+			{
+				double et = m_sbt(p,i-m_sage+1);
+				double rt = 1;
+				if( m_srr == 1 ) rt = m_so(p)*et/(1.+m_beta(p)*et);
+				if( m_srr == 2 ) rt = m_so(p)*et*exp(-m_beta(p)*et);
+				Nn(p,m_sage) = rt * exp(m_xx(p,i)-0.5*m_tau(p)*m_tau(p));
+			}
+
+			// Next year's numbers
+			for( j = m_sage; j <= m_nage; j++ ) surv(j) = exp(-Z(p,j));
+			for( j = m_sage+1; j <= m_nage; j++ )
+			{
+				Nn(p,j) = N(p,j-1) * surv(j-1);
+			}
+			Nn(p,m_nage) += N(p,m_nage) * surv(m_nage);
+		}
+		for( p = 1; p <= m_nprob; p++ ) N(p) = Nn(p);
+	}
+}
+
+
+static const char STATE_MAGIC[4] = {'I','P','S','T'};
+static const int  STATE_VERSION  = 1;
+
+void state_io::putInt(std::ostream& os, const int& x)
+{
+	os.write(reinterpret_cast<const char*>(&x), sizeof(int));
+}
+
+void state_io::putDouble(std::ostream& os, const double& x)
+{
+	os.write(reinterpret_cast<const char*>(&x), sizeof(double));
+}
+
+void state_io::putVector(std::ostream& os, const dvector& x)
+{
+	for( int i = x.indexmin(); i <= x.indexmax(); i++ ) putDouble(os, x(i));
+}
+
+bool state_io::getInt(std::istream& is, int& x)
+{
+	return bool(is.read(reinterpret_cast<char*>(&x), sizeof(int)));
+}
+
+bool state_io::getDouble(std::istream& is, double& x)
+{
+	return bool(is.read(reinterpret_cast<char*>(&x), sizeof(double)));
+}
+
+bool state_io::getVector(std::istream& is, dvector& x)
+{
+	for( int i = x.indexmin(); i <= x.indexmax(); i++ )
+	{
+		if( !getDouble(is, x(i)) ) return false;
+	}
+	return true;
+}
+
+
+using namespace state_io;
+
+/** \brief Write the file header (magic, version and dimensions). **/
+void ProjectionStateHeader::write(std::ostream& os) const
+{
+	os.write(STATE_MAGIC, 4);
+	putInt(os, STATE_VERSION);
+	putInt(os, type);
+	putInt(os, sage);
+	putInt(os, nage);
+	putInt(os, ngear);
+	putInt(os, syr);
+	putInt(os, nyr);
+}
+
+/** \brief Read the file header, false if it is not a projection state file. **/
+bool ProjectionStateHeader::read(std::istream& is)
+{
+	char magic[4];
+	int  version;
+	if( !is.read(magic, 4) ) return false;
+	for( int i = 0; i < 4; i++ )
+	{
+		if( magic[i] != STATE_MAGIC[i] ) return false;
+	}
+	if( !getInt(is, version) || version != STATE_VERSION ) return false;
+	return getInt(is, type) && getInt(is, sage) && getInt(is, nage)
+	    && getInt(is, ngear) && getInt(is, syr) && getInt(is, nyr);
+}
+
+
+/** \brief Append the draw to a projection state file. **/
+void ProjectionDraw::write(std::ostream& os) const
+{
+	putInt(os, draw);
+	putVector(os, M);
+	putVector(os, fa);
+	putVector(os, wa);
+	for( int k = va.rowmin(); k <= va.rowmax(); k++ ) putVector(os, va(k));
+	putDouble(os, so);
+	putDouble(os, beta);
+	putDouble(os, tau);
+	for( int i = N.rowmin(); i <= N.rowmax(); i++ ) putVector(os, N(i));
+	for( int i = Z.rowmin(); i <= Z.rowmax(); i++ ) putVector(os, Z(i));
+	putVector(os, sbt);
+	putDouble(os, bo);
+	putDouble(os, bmsy);
+	putDouble(os, fmsy);
+	putDouble(os, ftnyr);
+}
+
+/** \brief Read the next draw, false at the end of the file.
+
+	The arrays are allocated here with the dimensions in the header; xx
+	is left unallocated.
+**/
+bool ProjectionDraw::read(std::istream& is, const ProjectionStateHeader& h)
+{
+	if( !getInt(is, draw) ) return false;
+	M.allocate(h.sage,h.nage);
+	fa.allocate(h.sage,h.nage);
+	wa.allocate(h.sage,h.nage);
+	va.allocate(1,h.ngear,h.sage,h.nage);
+	N.allocate(h.nyr-1,h.nyr,h.sage,h.nage);
+	Z.allocate(h.nyr-1,h.nyr,h.sage,h.nage);
+	sbt.allocate(h.syr,h.nyr);
+
+	bool ok = getVector(is, M) && getVector(is, fa) && getVector(is, wa);
+	for( int k = 1; ok && k <= h.ngear; k++ ) ok = getVector(is, va(k));
+	ok = ok && getDouble(is, so) && getDouble(is, beta) && getDouble(is, tau);
+	for( int i = h.nyr-1; ok && i <= h.nyr; i++ ) ok = getVector(is, N(i));
+	for( int i = h.nyr-1; ok && i <= h.nyr; i++ ) ok = getVector(is, Z(i));
+	ok = ok && getVector(is, sbt);
+	ok = ok && getDouble(is, bo) && getDouble(is, bmsy) && getDouble(is, fmsy) && getDouble(is, ftnyr);
+	if( !ok )
+	{
+		LOG<<"Projection state file ends in the middle of draw "<<draw<<'\n';
+	}
+	return ok;
+}
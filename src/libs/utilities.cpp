@@ -43,7 +43,7 @@ ivector getIndex(const dvector& a, const dvector& b){
   return(tmp);
 }
 
-void write_proj_headers(ofstream &ofsP, int syr, int nyr, bool include_msy){
+void write_proj_headers(ostream &ofsP, int syr, int nyr, bool include_msy){
   // Write the decision table headers for projection years
   ofsP<<"TAC"                  <<",";
   ofsP<<"B"<<nyr+1             <<",";
@@ -75,7 +75,7 @@ void write_proj_headers(ofstream &ofsP, int syr, int nyr, bool include_msy){
   ofsP<<'\n';
 }
 
-void write_proj_output(ofstream &ofsP, int syr, int nyr, double tac, int pyr, dvector p_sbt, dmatrix p_ft, dvar_matrix ft, double bo, dmatrix fmsy, dvector bmsy, bool include_msy){
+void write_proj_output(ostream &ofsP, int syr, int nyr, double tac, int pyr, const dvector& p_sbt, const dmatrix& p_ft, double ftnyr, double bo, double fmsy, double bmsy, bool include_msy){
   // Write the projection output to the file
   ofsP<<tac                        <<","
       <<p_sbt(pyr)                 <<","
@@ -88,12 +88,11 @@ void write_proj_output(ofstream &ofsP, int syr, int nyr, double tac, int pyr, dv
       <<p_sbt(pyr+1)/(0.4*bo)      <<","
       <<p_sbt(pyr+1)/(0.2*bo)      <<","
       <<p_sbt(pyr+1)/p_sbt(syr)    <<","
-    //<<ft(1)(1,nyr)               <<","
-      <<ft(1,nyr)                  <<","
+      <<ftnyr                      <<","
       <<p_ft(pyr,1)                <<","
-      <<p_ft(pyr,1)/ft(1,nyr)      <<","
+      <<p_ft(pyr,1)/ftnyr          <<","
       <<(1. - mfexp(-p_ft(pyr,1))) <<","
-      <<(1. - mfexp(-p_ft(pyr,1)))/(1. - mfexp(-ft(1,nyr)));
+      <<(1. - mfexp(-p_ft(pyr,1)))/(1. - mfexp(-ftnyr));
   if(include_msy){
     //MSY based ref points
     ofsP<<","<<bmsy                <<","
@@ -107,3 +106,37 @@ void write_proj_output(ofstream &ofsP, int syr, int nyr, double tac, int pyr, dv
   }
   ofsP<<'\n';
 }
+
+void write_proj_year_headers(ostream &ofsP, int ngear, bool include_msy){
+  // Headers for the long format projection file, one row per draw, TAC and year
+  ofsP<<"iter,TAC,Year,B,BB0";
+  if(include_msy){
+    ofsP<<",BBMSY";
+  }
+  for(int k = 1; k <= ngear; k++){
+    ofsP<<",F"<<k;
+  }
+  ofsP<<",U_sumF,Clip\n";
+}
+
+void write_proj_years(ostream &ofsP, int iter, const dvector& p_tac, int nyr, int pyr, const dvector& p_sbt, const dmatrix& p_ft, const ivector& p_clip, double bo, double bmsy, bool include_msy){
+  // Write the projection years nyr+1..pyr for one TAC option of draw iter;
+  // p_tac holds the catch taken in each of those years.
+  // U_sumF = 1-exp(-sum of F over gears) is the harvest rate of fully
+  // selected fish with the gears combined and natural mortality ignored; it
+  // approximates, and is not, the catch over the biomass.  Clip flags a TAC
+  // that the stock could not support (F at the upper bound in the catch
+  // equation).
+  for(int i = nyr+1; i <= pyr; i++){
+    ofsP<<iter<<","<<p_tac(i)<<","<<i<<","<<p_sbt(i)<<","<<p_sbt(i)/bo;
+    if(include_msy){
+      ofsP<<","<<p_sbt(i)/bmsy;
+    }
+    double fsum = 0;
+    for(int k = p_ft.colmin(); k <= p_ft.colmax(); k++){
+      ofsP<<","<<p_ft(i,k);
+      fsum += p_ft(i,k);
+    }
+    ofsP<<","<<1. - exp(-fsum)<<","<<p_clip(i)<<'\n';
+  }
+}
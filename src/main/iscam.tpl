@@ -33,6 +33,15 @@ DATA_SECTION
 	// | 4)   end year for average fecundity/weight-at-age
 	// | 5) start year for recruitment period (not implemented yet)
 	// | 6)   end year for recruitment period (not implemented yet)
+	// | 7-9) historical control points (delay difference model)
+	// | 10) number of projection years after nyr (optional, default and minimum 2)
+	// | 11-14) harvest control rule projections for mceval (optional, all four or none)
+	// |   11) reference biomass for the rule (0 = off, 1 = Bo, 2 = Bmsy)
+	// |   12) limit reference point as a fraction of the reference biomass
+	// |   13) upper stock reference as a fraction of the reference biomass
+	// |   14) maximum harvest rate of spawning biomass (at or above 13)
+	// | 15) number of target spawning potential ratios n_spr (optional, default 0)
+	// | 16 to 15+n_spr) target ratios for the F_x% and B_x% reference points
 	// |
 
 	!! ad_comm::change_datafile_name(ProjectFileControl);
@@ -50,6 +59,12 @@ DATA_SECTION
 
 	init_int eof_pf;
 
+	int n_proj;  ///< Number of projection years after nyr.
+	int hcr_ref; ///< Reference biomass for HCR projections, 0 = off, 1 = Bo, 2 = Bmsy.
+	number hcr_lrp;  ///< HCR limit reference point (fraction of reference biomass).
+	number hcr_usr;  ///< HCR upper stock reference (fraction of reference biomass).
+	number hcr_hmax; ///< HCR maximum harvest rate.
+	int n_spr;       ///< Number of target spawning potential ratios (pf_cntrl 15).
 	LOC_CALCS
 		if(eof_pf!=-999)
 		{
@@ -58,6 +73,40 @@ DATA_SECTION
 			LOG<<"The file should end with -999.\n Aborting!\n";
 			ad_exit(1);
 		}
+		n_proj = n_pfcntrl >= 10 ? int(pf_cntrl(10)) : 2;
+		if(n_proj < 2) n_proj = 2;
+		LOG<<"Number of projection years: "<<n_proj<<'\n';
+		hcr_ref = 0;
+		if(n_pfcntrl >= 14)
+		{
+			hcr_ref  = int(pf_cntrl(11));
+			hcr_lrp  = pf_cntrl(12);
+			hcr_usr  = pf_cntrl(13);
+			hcr_hmax = pf_cntrl(14);
+		}
+		if(hcr_ref)
+		{
+			if(hcr_ref > 2 || hcr_lrp < 0 || hcr_usr <= hcr_lrp || hcr_hmax < 0 || hcr_hmax >= 1)
+			{
+				LOG<<"Error in the harvest control rule (pf_cntrl 11-14).\n";
+				LOG<<"Need reference 1 or 2, 0 <= LRP < USR and 0 <= hmax < 1.\n";
+				ad_exit(1);
+			}
+			LOG<<"Harvest control rule projections: reference "<<hcr_ref<<", LRP "<<hcr_lrp
+			   <<", USR "<<hcr_usr<<", hmax "<<hcr_hmax<<'\n';
+		}
+		n_spr = n_pfcntrl >= 15 ? int(pf_cntrl(15)) : 0;
+		if(n_spr < 0 || n_pfcntrl < 15+n_spr)
+		{
+			LOG<<"Error in the SPR targets (pf_cntrl 15-).\n";
+			LOG<<"pf_cntrl(15) = "<<n_spr<<" needs that many target ratios after it.\n";
+			ad_exit(1);
+		}
+	END_CALCS
+	/// | Target spawning potential ratios for SPR-based reference points.
+	vector spr_target(1,n_spr);
+	LOC_CALCS
+		for(int i=1;i<=n_spr;i++) spr_target(i) = pf_cntrl(15+i);
 	END_CALCS
 
 	// |---------------------------------------------------------------------------------|
@@ -71,6 +120,14 @@ DATA_SECTION
 	int rseed;    ///< Random number seed for simulated data.
 	int retro_yrs;///< Number of years to look back from terminal year.
 	int testMSY;
+	int frontierSteps; ///< Number of allocation steps for the MSY frontier (0 = off).
+	int drawCsv;  ///< Write the per-draw mceval projection files (off with -nodrawcsv).
+	int projOnly; ///< Rerun the projections from a saved state, 1 = MPD, 2 = mceval draws.
+	int mcBinary; ///< Write the mcmc_output tables as binary columnar files (-mcbin).
+	int memo;     ///< Reuse the output of repeated mceval draws (-memo).
+	int pmceval;  ///< Number of worker processes for -mceval (-pmceval n, 0 = serial).
+	int nchains;  ///< Number of parallel MCMC chains (-mcmc n -nchains k, 0 = one chain here).
+	int mcstop;   ///< End -mcmc when mcmc_monitor finds it converged or not converging (-mcstop).
 
 	int delaydiff; ///Flag for delay difference model 
 
@@ -116,6 +173,128 @@ DATA_SECTION
 			testMSY = 1;
 		}
 
+		// Number of threads for the reference point calculations. "-nthreads n"
+		if((on=option_match(ad_comm::argc,ad_comm::argv,"-nthreads",opt))>-1)
+		{
+			parallel::setThreadCount(atoi(ad_comm::argv[on+1]));
+		}
+		LOG<<"Number of threads for reference points = "<<parallel::getThreadCount()<<'\n';
+
+		// Allocation trade-off frontier for multiple fleets. "-frontier nstep"
+		frontierSteps = 0;
+		if((on=option_match(ad_comm::argc,ad_comm::argv,"-frontier",opt))>-1)
+		{
+			frontierSteps = atoi(ad_comm::argv[on+1]);
+			LOG<<"Calculating the MSY allocation frontier with "<<frontierSteps<<" steps\n";
+		}
+
+		// Decision table only, without the per-draw projection files. "-nodrawcsv"
+		drawCsv = 1;
+		if((on=option_match(ad_comm::argc,ad_comm::argv,"-nodrawcsv",opt))>-1)
+		{
+			drawCsv = 0;
+			LOG<<"Per-draw projection files are off, see iscammcmc_decision_table.csv\n";
+		}
+
+		// Binary columnar mceval output instead of CSV. "-mcbin"
+		mcBinary = 0;
+		if((on=option_match(ad_comm::argc,ad_comm::argv,"-mcbin",opt))>-1)
+		{
+			mcBinary = 1;
+			LOG<<"mceval output is written to binary .ipost files, convert with -mcexport\n";
+		}
+
+		// Repeated mceval draws (rejected proposals) are not evaluated again. "-memo"
+		memo = 0;
+		if((on=option_match(ad_comm::argc,ad_comm::argv,"-memo",opt))>-1)
+		{
+			memo = 1;
+			LOG<<"mceval reuses the output of draws that repeat the previous draw\n";
+		}
+
+		// mceval in worker processes, see parallel_mceval. "-mceval -pmceval n"
+		pmceval = 0;
+		if((on=option_match(ad_comm::argc,ad_comm::argv,"-pmceval",opt))>-1)
+		{
+			if(on+1 >= ad_comm::argc || atoi(ad_comm::argv[on+1]) < 1
+			   || option_match(ad_comm::argc,ad_comm::argv,"-mceval")<0)
+			{
+				LOG<<"Usage: -mceval -pmceval nworkers\n";
+				ad_exit(1);
+			}
+			pmceval = atoi(ad_comm::argv[on+1]);
+		}
+
+		// Parallel MCMC chains, see mcmc_chains. "-mcmc n -nchains k"
+		nchains = 0;
+		if((on=option_match(ad_comm::argc,ad_comm::argv,"-nchains",opt))>-1)
+		{
+			if(on+1 >= ad_comm::argc || atoi(ad_comm::argv[on+1]) < 1
+			   || option_match(ad_comm::argc,ad_comm::argv,"-mcmc")<0)
+			{
+				LOG<<"Usage: -mcmc n -nchains nchains [-mcseed seed]\n";
+				ad_exit(1);
+			}
+			nchains = atoi(ad_comm::argv[on+1]);
+		}
+
+		// End the chain early on the status of mcmc_monitor. "-mcmc n -mcstop"
+		mcstop = 0;
+		if((on=option_match(ad_comm::argc,ad_comm::argv,"-mcstop",opt))>-1)
+		{
+			mcstop = 1;
+			LOG<<"-mcmc stops once iscam_mcmc_status.txt reports converged or not-converging\n";
+		}
+
+		// Series to write in mceval. "-manifest file"
+		if((on=option_match(ad_comm::argc,ad_comm::argv,"-manifest",opt))>-1)
+		{
+			if(on+1 >= ad_comm::argc || !outputManifest.read(ad_comm::argv[on+1]))
+			{
+				LOG<<"Error reading the output manifest, usage: -manifest file\n";
+				ad_exit(1);
+			}
+			LOG<<"mceval output is limited to the series in "<<ad_comm::argv[on+1]<<'\n';
+		}
+
+		// Convert binary mceval output to CSV and stop. "-mcexport [file.ipost ...]"
+		// Without file names the mcmc_output tables in the working directory
+		// are converted, including the .ipost.part files of an unfinished run.
+		if((on=option_match(ad_comm::argc,ad_comm::argv,"-mcexport",opt))>-1)
+		{
+			std::vector<std::string> files;
+			for(int a=on+1; a<ad_comm::argc && ad_comm::argv[a][0]!='-'; a++){
+				files.push_back(ad_comm::argv[a]);
+			}
+			if(files.empty()){
+				for(int t=0;t<7;t++){
+					std::string base(mcmcTableNames[t]);
+					if(ifstream((base+".ipost").c_str()).good()) files.push_back(base+".ipost");
+					else if(ifstream((base+".ipost.part").c_str()).good()) files.push_back(base+".ipost.part");
+				}
+			}
+			int nfail = 0;
+			for(size_t t=0; t<files.size(); t++){
+				std::string csv = files[t].substr(0, files[t].find(".ipost")) + ".csv";
+				if(posterior_to_csv(files[t], csv)){
+					LOG<<"Exported "<<files[t]<<" to "<<csv<<'\n';
+				}else{
+					nfail ++;
+				}
+			}
+			if(files.empty()) LOG<<"No .ipost files to export\n";
+			ad_exit(nfail ? 1 : 0);
+		}
+
+		// Projections only, from the state saved by a fitted model. "-projonly [mcmc]"
+		projOnly = 0;
+		if((on=option_match(ad_comm::argc,ad_comm::argv,"-projonly",opt))>-1)
+		{
+			projOnly = 1;
+			if(on+1 < ad_comm::argc && !strcmp(ad_comm::argv[on+1],"mcmc")) projOnly = 2;
+			LOG<<"Rerunning the projections from the saved "<<(projOnly==2 ? "mceval" : "MPD")<<" state\n";
+		}
+
 		//Delay difference
 		//CW Dec 2015 - copied from RF May 22 2013
 		// command line option for implementing delay difference model "-delaydiff"
@@ -814,6 +993,9 @@ DATA_SECTION
 	matrix fall(1,ngroup,1,nfleet);	//Fishing mortality based on dAllocation
 	matrix  msy(1,ngroup,1,nfleet);	//Maximum sustainable yield
 	vector bmsy(1,ngroup);			//Spawning biomass at MSY
+	matrix fspr(1,ngroup,1,n_spr);	//Total fishing mortality rate at F_x%
+	matrix bspr(1,ngroup,1,n_spr);	//Spawning biomass at F_x%
+	matrix yspr(1,ngroup,1,n_spr);	//Equilibrium yield at F_x%
  // number Umsy;					//Exploitation rate at MSY
 	vector age_tau2(1,nAgears);	//MLE estimate of the variance for age comps
  // 	//catch-age for simulation model (could be declared locally 3d_array)
@@ -1102,11 +1284,27 @@ DATA_SECTION
 	// | 15-> switch for generating selex based on IFD and cohort biomass
   // | 16-> toggle to fit to annual mean weights for commercial catch
   // | 17-> toggle to do the fmsy calculations (set to 0 for herring)
+  // | 18-> condition F on the observed catch instead of estimating log_ft_pars
+  // |     (optional, 0 when the controls end at 17 and the next number is the eofc marker)
 
-	init_vector d_iscamCntrl(1,17);
+	init_vector d_iscamCntrl_in(1,17);
+	init_number d_iscamCntrl_next;
+	vector d_iscamCntrl(1,18);
 	int verbose;
-	init_int eofc;
+	int eofc;
 	LOC_CALCS
+		d_iscamCntrl(1,17) = d_iscamCntrl_in;
+		if(d_iscamCntrl_next==999)
+		{
+			d_iscamCntrl(18) = 0;
+			eofc = 999;
+		}
+		else
+		{
+			d_iscamCntrl(18) = d_iscamCntrl_next;
+			eofc = 0;
+			*(ad_comm::global_datafile) >> eofc;
+		}
 		verbose = d_iscamCntrl(1);
 		if(verbose) LOG<<d_iscamCntrl;
 		for(int ig=1;ig<=n_ags;ig++)
@@ -1125,6 +1323,21 @@ DATA_SECTION
 			LOG<<"\n ***** ERROR READING CONTROL FILE ***** \n";
       exit(1);
 		}
+
+		// Harvest control rule projections (pf_cntrl 11-14) are run by the
+		// age-structured model only, and a Bmsy reference needs bmsy.
+		if(hcr_ref && delaydiff)
+		{
+			LOG<<"Harvest control rule projections (pf_cntrl 11-14) are not implemented for\n";
+			LOG<<"the delay difference model, set pf_cntrl(11) to 0.\n";
+			ad_exit(1);
+		}
+		if(hcr_ref==2 && !d_iscamCntrl(17))
+		{
+			LOG<<"The harvest control rule reference 2 (Bmsy) needs the MSY reference points,\n";
+			LOG<<"set control 17 to 1 or use reference 1 (Bo) in pf_cntrl(11).\n";
+			ad_exit(1);
+		}
 	END_CALCS
 
 	int nf;
@@ -1271,6 +1484,52 @@ DATA_SECTION
 	//END_CALCS
 
 
+	// |---------------------------------------------------------------------------------|
+	// | CATCH CONDITIONED FISHING MORTALITY
+	// |---------------------------------------------------------------------------------|
+	// | - d_iscamCntrl(18): solve ft each year from the observed catch in
+	// |   calcCatchConditionedFt, so log_ft_pars are not estimated (ft_phz = -1).
+	// | - Catch in weight or numbers must be for both sexes combined (sex=0) unless
+	// |   nsex==1, and one type per area, group and year, with at most one row per gear.
+	// | - Roe fisheries (type=3) are solved directly from the spawning biomass.
+	int ft_phz;
+	LOC_CALCS
+		ft_phz = 1;
+		if( d_iscamCntrl(18) )
+		{
+			if( delaydiff )
+			{
+				LOG<<"Catch conditioned F (control 18) is not implemented for the delay difference model\n";
+				exit(1);
+			}
+			for( int ii = 1; ii <= nCtNobs; ii++ )
+			{
+				int l = dCatchData(ii,6);
+				if( l == 3 ) continue;
+				if( dCatchData(ii,5) && nsex > 1 )
+				{
+					LOG<<"Catch conditioned F needs catch for both sexes combined, row "<<ii<<'\n';
+					exit(1);
+				}
+				for( int jj = 1; jj < ii; jj++ )
+				{
+					if( dCatchData(jj,6) == 3 ) continue;
+					if( dCatchData(jj,1) != dCatchData(ii,1) ) continue;
+					if( dCatchData(jj,3) != dCatchData(ii,3) ) continue;
+					if( dCatchData(jj,4) != dCatchData(ii,4) ) continue;
+					if( dCatchData(jj,2) == dCatchData(ii,2) || dCatchData(jj,6) != l )
+					{
+						LOG<<"Catch conditioned F needs one catch type and one row per gear"
+						   <<" in each area, group and year, rows "<<jj<<" and "<<ii<<'\n';
+						exit(1);
+					}
+				}
+			}
+			ft_phz = -1;
+			LOG<<"Fishing mortality conditioned on catch, "<<ft_count<<" log_ft_pars fixed\n";
+		}
+	END_CALCS
+
 	// END OF DATA_SECTION
 	!! if(verbose) LOG<<"||-- END OF DATA_SECTION --||\n";
 
@@ -1330,7 +1589,8 @@ PARAMETER_SECTION
 						double uu = 0;
 						if(SimFlag && j > 1)
 						{
-							uu = 0.05*randn(j+rseed);
+							CounterRng rng(rseed, CounterRng::SIM_SELECTIVITY);
+							uu = 0.05*rng.randn(k,j);
 						} 
 						sel_par(k,j,1) = log(ahat_agemin(k)*exp(uu));
 						sel_par(k,j,2) = log(ghat_agemax(k));
@@ -1356,9 +1616,10 @@ PARAMETER_SECTION
 	// | - Estimate all fishing mortality rates in log-space.
 	// | - If in simulation mode then initialize with F=0.1; Actual F is conditioned on
 	// |   the observed catch.
+	// | - ft_phz is negative when F is conditioned on catch (d_iscamCntrl(18)).
 	// |
 
-	init_bounded_vector log_ft_pars(1,ft_count,-30.,3.0,1);
+	init_bounded_vector log_ft_pars(1,ft_count,-30.,3.0,ft_phz);
 
 	LOC_CALCS
 		if(!SimFlag) log_ft_pars = log(0.10);
@@ -1590,6 +1851,19 @@ PRELIMINARY_CALCS_SECTION
  	// | - SimFlag comes from the -sim command line argument to simulate fake data.
  	// |
     nf=0;
+  	if( projOnly )
+  	{
+  		projection_only();
+  		ad_exit(0);
+  	}
+  	if( pmceval )
+  	{
+  		parallel_mceval();  // returns in the worker processes only
+  	}
+  	if( nchains )
+  	{
+  		mcmc_chains();
+  	}
   	if( testMSY )
   	{
   		testMSYxls();
@@ -1609,6 +1883,20 @@ RUNTIME_SECTION
 
 PROCEDURE_SECTION
 	
+	// a SIGINT or SIGTERM during mceval is handled here, between draws.
+	if(mceval_phase()) BufferedOfstream::pollSignal();
+
+	// -memo: a draw with the parameters of the previous mceval draw is not
+	// evaluated, see mcmc_repeat.
+	if(memo && mceval_phase()){
+		dvector x(1,initial_params::nvarcalc());
+		initial_params::xinit(x);
+		if(drawMemo.repeat(x)){
+			mcmc_repeat();
+			return;
+		}
+	}
+
 	if(!delaydiff){	
 		if(d_iscamCntrl(5)==2) d_iscamCntrl(5)=0; //This control determines whether population is unfished in syr (0=false). The delay diff model also has option 2 where the population is at equilibrium with fishing mortality - not implemented in ASM.
 	
@@ -1643,6 +1931,7 @@ PROCEDURE_SECTION
 	if(mc_phase())
 	{
 		mcmcPhase=1;
+		mcmc_monitor();
 	}
 	if(mceval_phase())
 	{
@@ -2117,9 +2406,12 @@ FUNCTION calcTotalMortality
 	// |---------------------------------------------------------------------------------|
 	// | FISHING MORTALITY
 	// |---------------------------------------------------------------------------------|
+	// | - If F is conditioned on catch (d_iscamCntrl(18)) it is solved year by year in
+	// |   calcNumbersAtAge, here Z = M.
 	// |
        	for(ig=1;ig<=nCtNobs;ig++)
 	{
+		if( d_iscamCntrl(18) ) break;
 		i  = dCatchData(ig)(1);	 //year
 		k  = dCatchData(ig)(2);  //gear
 		f  = dCatchData(ig)(3);  //area
@@ -2260,15 +2552,29 @@ FUNCTION calcNumbersAtAge
 		}
 		N(ig)(syr)(sage,nage) = 1./nsex * mfexp(tr);
 		log_rt(ih)(syr-nage+sage,syr) = tr.shift(syr-nage+sage);
+	}
 
-		for(i=syr;i<=nyr;i++)
+	// Years in the outer loop so that all sexes have N(i) before a catch
+	// conditioned F is solved for year i.
+	for(i=syr;i<=nyr;i++)
+	{
+		for(ig=1;ig<=n_ags;ig++)
 		{
+			f  = n_area(ig);
+			g  = n_group(ig);
+			ih = pntr_ag(f,g);
 			if( i>syr )
 			{
 				log_rt(ih)(i) = (log_avgrec(ih)+log_rec_devs(ih)(i));
 				N(ig)(i,sage) = 1./nsex * mfexp( log_rt(ih)(i) );				
 			}
+		}
+
+		if( d_iscamCntrl(18) ) calcCatchConditionedFt(i);
 
+		for(ig=1;ig<=n_ags;ig++)
+		{
+			g  = n_group(ig);
 			N(ig)(i+1)(sage+1,nage) =++elem_prod(N(ig)(i)(sage,nage-1)
 			                                     ,S(ig)(i)(sage,nage-1));
 			N(ig)(i+1,nage)        +=  N(ig)(i,nage)*S(ig)(i,nage);
@@ -2279,6 +2585,13 @@ FUNCTION calcNumbersAtAge
 			//vulnerable biomass to all gears //Added by RF March 19 2015
 			for(kgear=1; kgear<=ngear; kgear++) vbt(g)(kgear)(i) = sum(elem_prod(elem_prod(N(ig)(i),d3_wt_avg(ig)(i)), mfexp(log_sel(kgear)(ig)(i)))); 
 		}
+	}
+
+	for(ig=1;ig<=n_ags;ig++)
+	{
+		f  = n_area(ig);
+		g  = n_group(ig);
+		ih = pntr_ag(f,g);
 		N(ig)(nyr+1,sage) = 1./nsex * mfexp( log_avgrec(ih));	 //No deviation
 		//bt(g)(nyr+1) += N(ig)(nyr+1) * d3_wt_avg(ig)(nyr+1);
 		bt(g)(nyr+1) = sum(elem_prod(N(ig)(nyr+1),d3_wt_avg(ig)(nyr+1)));
@@ -2287,6 +2600,158 @@ FUNCTION calcNumbersAtAge
 	}
 	if(verbose)LOG<<"**** Ok after calcNumbersAtAge ****\n";
   }	
+
+
+  	/**
+  	Purpose: This function solves the fishing mortality rates in year iyr from the
+  	         observed catch (d_iscamCntrl(18)), replacing the log_ft_pars.  F, Z and S
+  	         for year iyr are updated for every area, group and sex.
+  	
+  	Arguments:
+  		iyr -> year
+  	
+  	NOTES:
+  		- ft0 is solved in double precision with BaranovCatchEquation, using all
+  		  gears with catch in the same area and group together.
+  		- Derivatives are attached with one Newton step taken with the dvariable
+  		  catch equation at ft0:  ft = ft0 - J^{-1}(C(ft0) - ct),  J = dC/dF at ft0.
+  		  The value is ft0 (the residual is ~0), and by the implicit function theorem
+  		  the derivatives with respect to N, M and selectivity are -J^{-1} dC/dtheta.
+  		- If ft0 is clipped at MAXF (catch larger than the stock) no derivatives are
+  		  attached for that area and group and year.
+  		- Roe fisheries (type=3) have ct = (1-exp(-ft)) * ssb, so ft = -log(1-ct/ssb).
+  	*/
+FUNCTION void calcCatchConditionedFt(const int& iyr)
+  {
+	int ii,ig,ff,gg,h,k,kk,l,ll,type,ng;
+	double d_ct;
+	BaranovCatchEquation cBaranov;
+	ivector gear(1,ngear);
+	dvector ctk(1,ngear);
+
+	for(ff=1;ff<=narea;ff++)
+	{
+		for(gg=1;gg<=ngroup;gg++)
+		{
+			ng   = 0;
+			type = 1;
+			for(ii=1;ii<=nCtNobs;ii++)
+			{
+				if( dCatchData(ii,1) != iyr ) continue;
+				if( dCatchData(ii,3) != ff  ) continue;
+				if( dCatchData(ii,4) != gg  ) continue;
+				k    = dCatchData(ii,2);
+				h    = dCatchData(ii,5);
+				l    = dCatchData(ii,6);
+				d_ct = dCatchData(ii,7);
+				if( l == 3 )
+				{
+					// | Roe fishery, no F on the adults.
+					int h1 = h ? h : 1;
+					int h2 = h ? h : nsex;
+					dvariable ssb = 0;
+					for(h=h1;h<=h2;h++)
+					{
+						ig   = pntr_ags(ff,gg,h);
+						ssb += N(ig)(iyr) * d3_wt_mat(ig)(iyr);
+					}
+					dvariable ut = d_ct / ssb;
+					if( value(ut) > 0.99 ) ut = 0.99;
+					for(h=h1;h<=h2;h++)
+					{
+						ft(pntr_ags(ff,gg,h))(k,iyr) = -log(1.-ut);
+					}
+					continue;
+				}
+				ng ++;
+				gear(ng) = k;
+				ctk(ng)  = d_ct;
+				type     = l;
+			}
+			if( !ng ) continue;
+
+			// | Double precision solution for ft0.
+			dvector  ct_obs(1,ng);
+			dmatrix  ma(1,nsex,sage,nage);
+			dmatrix  na(1,nsex,sage,nage);
+			dmatrix  wa(1,nsex,sage,nage);
+			d3_array va(1,nsex,1,ng,sage,nage);
+			for(kk=1;kk<=ng;kk++) ct_obs(kk) = ctk(kk);
+			for(h=1;h<=nsex;h++)
+			{
+				ig    = pntr_ags(ff,gg,h);
+				ma(h) = value(M(ig)(iyr));
+				na(h) = value(N(ig)(iyr));
+				wa(h) = d3_wt_avg(ig)(iyr);
+				for(kk=1;kk<=ng;kk++)
+				{
+					va(h)(kk) = value(mfexp(log_sel(gear(kk))(ig)(iyr)));
+				}
+			}
+
+			// const reference: a non-const dmatrix would bind to the _hCt overload.
+			const dmatrix &c_wa = wa;
+			dvector ft0(1,ng);
+			dmatrix J(1,ng,1,ng);
+			if( type == 1 )
+			{
+				ft0 = cBaranov.getFishingMortality(ct_obs,ma,&va,na,c_wa);
+				J   = cBaranov.getCatchJacobian(ft0,ma,&va,na,c_wa);
+			}
+			else
+			{
+				ft0 = cBaranov.getFishingMortality(ct_obs,ma,&va,na);
+				J   = cBaranov.getCatchJacobian(ft0,ma,&va,na);
+			}
+
+			// | Newton step with the dvariable catch equation to attach derivatives.
+			dvar_vector ftmp(1,ng);
+			ftmp = ft0;
+			if( !cBaranov.getResult().clipped )
+			{
+				dmatrix Jinv = inv(J);
+				dvar_vector chat(1,ng);
+				chat.initialize();
+				for(h=1;h<=nsex;h++)
+				{
+					ig = pntr_ags(ff,gg,h);
+					dvar_vector za(sage,nage);
+					za = M(ig)(iyr);
+					for(kk=1;kk<=ng;kk++)
+					{
+						za += ft0(kk) * mfexp(log_sel(gear(kk))(ig)(iyr));
+					}
+					dvar_vector oa = elem_prod(elem_div(1.-mfexp(-za),za),N(ig)(iyr));
+					if( type == 1 ) oa = elem_prod(oa,d3_wt_avg(ig)(iyr));
+					for(kk=1;kk<=ng;kk++)
+					{
+						chat(kk) += ft0(kk) * (mfexp(log_sel(gear(kk))(ig)(iyr)) * oa);
+					}
+				}
+				for(kk=1;kk<=ng;kk++)
+				{
+					for(ll=1;ll<=ng;ll++)
+					{
+						ftmp(kk) -= Jinv(kk,ll) * (chat(ll) - ct_obs(ll));
+					}
+				}
+			}
+
+			for(h=1;h<=nsex;h++)
+			{
+				ig = pntr_ags(ff,gg,h);
+				for(kk=1;kk<=ng;kk++)
+				{
+					k = gear(kk);
+					ft(ig)(k,iyr) = ftmp(kk);
+					F(ig)(iyr)   += ftmp(kk) * mfexp(log_sel(k)(ig)(iyr));
+				}
+				Z(ig)(iyr) = M(ig)(iyr) + F(ig)(iyr);
+				S(ig)(iyr) = mfexp(-Z(ig)(iyr));
+			}
+		}
+	}
+  }
   	/**
   	Purpose:  This function calculates the predicted age-composition samples (A) for 
   	          both directed commercial fisheries and survey age-composition data. For 
@@ -4076,7 +4541,7 @@ FUNCTION calcObjectiveFunction
 	if(last_phase())
 	{
 		
-		pvec(1) = dnorm(log_fbar,log(d_iscamCntrl(7)),d_iscamCntrl(9));
+		if( active(log_ft_pars) ) pvec(1) = dnorm(log_fbar,log(d_iscamCntrl(7)),d_iscamCntrl(9));
 		
 		// | Penalty for log_rec_devs (large variance here)
 		for(g=1;g<=n_ag;g++)
@@ -4093,7 +4558,7 @@ FUNCTION calcObjectiveFunction
 	else
 	{
 
-		pvec(1) = dnorm(log_fbar,log(d_iscamCntrl(7)),d_iscamCntrl(8));
+		if( active(log_ft_pars) ) pvec(1) = dnorm(log_fbar,log(d_iscamCntrl(7)),d_iscamCntrl(8));
 		
 		//Penalty for log_rec_devs (CV ~ 0.0707) in early phases
 		for(g=1;g<=n_ag;g++)
@@ -4256,13 +4721,11 @@ FUNCTION void calcReferencePoints()
       // |     : ensure dAllocation sums to 1.
       dvector d_ak(1,nfleet);
       d3_array  d_V(1,n_ags,1,nfleet,sage,nage);
-      dvar3_array  dvar_V(1,n_ags,1,nfleet,sage,nage);
       for(k = 1;k <= nfleet;k++){
         kk      = nFleetIndex(k);
         d_ak(k) = dAllocation(kk);
         for(ig = 1;ig <= n_ags;ig++){
           d_V(ig)(k) = value(exp(log_sel(kk)(ig)(nyr)));
-          dvar_V(ig)(k) = exp(log_sel(kk)(ig)(nyr));
         }
       }
       d_ak /= sum(d_ak);
@@ -4283,56 +4746,67 @@ FUNCTION void calcReferencePoints()
       msy.initialize();
       bmsy.initialize();
 
-      dvar_vector dftry(1,nfleet);
+      dvector dftry(1,nfleet);
       dftry  = 0.6/nfleet * mean(M_bar);
 
-      // | (4) : Instantiate msy class for each stock
-      for(g=1;g<=ngroup;g++){
-        double d_rho = d_iscamCntrl(13);
-        dvector d_mbar = M_bar(g);
-        dvector d_wa = dWt_bar(g);
-        dvector d_fa = fa_bar(g);
-
-        rfp::msy<dvariable,dvar_vector,dvar_matrix,dvar3_array> 
-          c_MSY(ro(g),steepness(g),d_rho,M_bar,dWt_bar,fa_bar,dvar_V);
-        bo  = c_MSY.getBo();
-        if(d_iscamCntrl(17)){
-          dvar_vector dfmsy = c_MSY.getFmsy(dftry,d_ak);
-          dvariable dbmsy = c_MSY.getBmsy();
-          dvar_vector dmsy = c_MSY.getMsy();
-          bmsy(g) = value(dbmsy);
-          msy(g)  = value(dmsy);
-          fmsy(g) = value(dfmsy);
-        }
-      }
-      // Data-type version of MSY-based reference points.
-      for(ig = 1;ig <= n_ags;ig++){
-        fa_bar(ig) = elem_prod(dWt_bar(ig), ma(ig));
-        M_bar(ig) = colsum(value(M(ig).sub(pf_cntrl(3), pf_cntrl(4))));
-        M_bar(ig) /= pf_cntrl(4) - pf_cntrl(3) + 1;
-      }
+      // | (4) : Instantiate the reference point objects for each stock using
+      // |     : only the area/sex slices that belong to the group, then run
+      // |     : the independent per-group solves concurrently (-nthreads).
+      // |     : Objects are built here, in the main thread; the solves only
+      // |     : touch their own object and their own row of the results.
+      double d_rho = d_iscamCntrl(13);
+      typedef rfp::spr<double,dvector,dmatrix,d3_array> spr_t;
+      std::vector<Msy*>   c_msy(ngroup,(Msy*)0);
+      std::vector<spr_t*> c_spr(ngroup,(spr_t*)0);
       for(g = 1;g <= ngroup;g++){
         double d_ro = value(ro(g));
         double d_h = value(steepness(g));
-        double d_rho = d_iscamCntrl(13);
-        rfp::msy<double,dvector,dmatrix,d3_array>
-          c_dMSY(d_ro,d_h,d_rho,M_bar,dWt_bar,fa_bar,d_V);
-        bo = c_dMSY.getBo();
+        dmatrix g_M, g_wa, g_fa;
+        d3_array g_V;
+        getGroupSlices(g,M_bar,fa_bar,d_V,g_M,g_wa,g_fa,g_V);
+
         if(d_iscamCntrl(17)){
-          fmsy(g) = c_dMSY.getFmsy(value(dftry));
-          bmsy(g) = c_dMSY.getBmsy();
-          msy(g) = c_dMSY.getMsy();
-          dvector finit(1,nfleet);
-          finit = fmsy(g);
-          c_dMSY.checkDerivatives(finit);
-          Msy c_msy(d_ro, d_h, M_bar, d_rho, dWt_bar, fa_bar, &d_V);
+          c_msy[g-1] = new Msy(d_ro,d_h,g_M,d_rho,g_wa,g_fa,&g_V);
           fmsy(g) = 0.1;
-          c_msy.get_fmsy(fmsy(g));
-          bmsy(g) = c_msy.getBmsy();
-          msy(g) = c_msy.getMsy();
-          bo = c_msy.getBo();
+        }else{
+          rfp::msy<double,dvector,dmatrix,d3_array>
+            c_dMSY(d_ro,d_h,d_rho,g_M,g_wa,g_fa,g_V);
+          bo(g) = c_dMSY.getBo();
+        }
+
+        // SPR-based reference points for each target ratio in the pfc file.
+        if(n_spr){
+          c_spr[g-1] = new spr_t(d_ro,d_h,d_rho,int(d_iscamCntrl(2)),g_M,g_wa,g_fa,g_V);
+        }
+      }
+
+      parallel::for_each(1,ngroup,[&](int gg){
+        if(c_msy[gg-1]){
+          c_msy[gg-1]->get_fmsy(fmsy(gg));
+        }
+        if(c_spr[gg-1]){
+          fspr(gg) = c_spr[gg-1]->getFspr(spr_target,d_ak);
+        }
+      });
+
+      for(g = 1;g <= ngroup;g++){
+        if(c_msy[g-1]){
+          bmsy(g) = c_msy[g-1]->getBmsy();
+          msy(g) = c_msy[g-1]->getMsy();
+          bo(g) = c_msy[g-1]->getBo();
+          delete c_msy[g-1];
+        }
+        if(c_spr[g-1]){
+          bspr(g) = c_spr[g-1]->getBspr();
+          yspr(g) = c_spr[g-1]->getYspr();
+          delete c_spr[g-1];
         }
       }
+
+      // | (5) : Allocation trade-off frontier (-frontier nstep).
+      if(frontierSteps && nfleet > 1 && !mceval_phase()){
+        calcMsyFrontier(d_V,M_bar,fa_bar,dftry);
+      }
     }
 
     if(verbose){
@@ -4340,6 +4814,62 @@ FUNCTION void calcReferencePoints()
   	}
   }
 
+  /**
+   * Copy the area/sex slices (ig) that belong to stock g out of the n_ags
+   * arrays used for the reference points: natural mortality, weight-at-age,
+   * fecundity-at-age and selectivity.  The reference point classes treat
+   * every row as part of the same stock, so passing all n_ags rows would
+   * mix the stocks together.
+   */
+FUNCTION void getGroupSlices(const int& g, const dmatrix& M_bar, const dmatrix& fa_bar, const d3_array& d_V, dmatrix& g_M, dmatrix& g_wa, dmatrix& g_fa, d3_array& g_V)
+  {
+    int ig, n = 0;
+    for(ig = 1;ig <= n_ags;ig++){
+      if(n_group(ig) == g) n++;
+    }
+    g_M.allocate(1,n,sage,nage);
+    g_wa.allocate(1,n,sage,nage);
+    g_fa.allocate(1,n,sage,nage);
+    g_V.allocate(1,n,1,nfleet,sage,nage);
+    int ii = 1;
+    for(ig = 1;ig <= n_ags;ig++){
+      if(n_group(ig) != g) continue;
+      g_M(ii)  = M_bar(ig);
+      g_wa(ii) = dWt_bar(ig);
+      g_fa(ii) = fa_bar(ig);
+      g_V(ii)  = d_V(ig);
+      ii++;
+    }
+  }
+
+  /**
+   * Trade-off between catch allocation and MSY for multiple fleets.
+   * Sweeps the simplex of allocations in steps of 1/frontierSteps and
+   * writes Fmsy, MSY by fleet, total MSY and Bmsy for each allocation and
+   * group to iscam_frontier.csv.  The allocations are solved in parallel
+   * (see -nthreads), each one warm-started from its neighbour.
+   */
+FUNCTION void calcMsyFrontier(const d3_array& d_V, const dmatrix& M_bar, const dmatrix& fa_bar, const dvector& dftry)
+  {
+    ofstream ofs("iscam_frontier.csv");
+    for(int g = 1;g <= ngroup;g++){
+      double d_ro = value(ro(g));
+      double d_h = value(steepness(g));
+      double d_rho = d_iscamCntrl(13);
+      dmatrix g_M, g_wa, g_fa;
+      d3_array g_V;
+      getGroupSlices(g,M_bar,fa_bar,d_V,g_M,g_wa,g_fa,g_V);
+      rfp::msyFrontier<double,dvector,dmatrix,d3_array>
+        c_frontier(d_ro,d_h,d_rho,g_M,g_wa,g_fa,g_V);
+      c_frontier.simplex(frontierSteps);
+      c_frontier.solve(dftry);
+      c_frontier.write(ofs,g);
+      LOG<<"Allocation frontier for group "<<g<<": "
+         <<c_frontier.getPoints()<<" allocations, "
+         <<sum(c_frontier.getIterations())<<" Newton iterations\n";
+    }
+  }
+
   /**
    * This is a simple test routine for comparing the MSY class output to the 
    * MSF.xlsx spreadsheet that was used to develop the multiple fleet msy 
@@ -4469,19 +4999,30 @@ FUNCTION void simulationModel(const long& seed)
     // | - epsilon -> Observation errors
     // | - rec_dev -> Process errors
     // | - init_rec_dev
+    // | - eta -> Catch observation errors
     // | [ ] - add other required random numbers if necessary.
+    // | Each source has its own CounterRng stream and every number is keyed by
+    // | its indices, so adding observations does not change the other errors.
     // |
-	random_number_generator rng(seed);
 	dmatrix      epsilon(1,nItNobs,1,n_it_nobs);
 	dmatrix      rec_dev(1,n_ag,syr,nyr+retro_yrs);
 	dmatrix init_rec_dev(1,n_ag,sage+1,nage);
 	dvector      eta(1,nCtNobs);
-    
 
-	epsilon.fill_randn(rng);
-	rec_dev.fill_randn(rng);
-	init_rec_dev.fill_randn(rng);
-	eta.fill_randn(rng);
+	CounterRng rngSurvey(seed, CounterRng::SIM_SURVEY);
+	CounterRng rngRec(seed, CounterRng::SIM_RECRUITMENT);
+	CounterRng rngInit(seed, CounterRng::SIM_INIT_RECRUITMENT);
+	CounterRng rngCatch(seed, CounterRng::SIM_CATCH);
+	for(k=1;k<=nItNobs;k++)
+	{
+		for(i=1;i<=n_it_nobs(k);i++) epsilon(k,i) = rngSurvey.randn(k,i);
+	}
+	for(ih=1;ih<=n_ag;ih++)
+	{
+		for(i=syr;i<=nyr+retro_yrs;i++) rec_dev(ih,i) = rngRec.randn(ih,i);
+		for(j=sage+1;j<=nage;j++) init_rec_dev(ih,j) = rngInit.randn(ih,j);
+	}
+	for(ii=1;ii<=nCtNobs;ii++) eta(ii) = rngCatch.randn(ii);
 
     // | Scale survey observation errors
     double std;
@@ -4692,8 +5233,12 @@ FUNCTION void simulationModel(const long& seed)
 	// | - A is the matrix of observed catch-age data.
 	// | - A_hat is the predicted matrix from which to draw samples.
 	// |
+	// | - multivariate logistic errors, one CounterRng number per gear, obs and age;
+	// |   age_tau is a variance, as in rmvlogistic, so the SD is sqrt(age_tau).
 	int k, kk, aa, AA;
 	double age_tau = value(sig(1));
+	double age_sd  = sqrt(age_tau);
+	CounterRng rngAge(seed, CounterRng::SIM_AGE_COMPOSITION);
 	
 	calcComposition();
 	for(kk=1;kk<=nAgears;kk++)
@@ -4701,10 +5246,16 @@ FUNCTION void simulationModel(const long& seed)
 		aa = n_A_sage(kk);
 		AA = n_A_nage(kk);
 		dvector pa(aa,AA);
+		dvector xa(aa,AA);
 		for(ii=1;ii<=n_A_nobs(kk);ii++)
 		{
 			pa = value(A_hat(kk)(ii));
-			d3_A(kk)(ii)(aa,AA)=rmvlogistic(pa,age_tau,i+seed);
+			for(j=aa;j<=AA;j++)
+			{
+				xa(j) = log(pa(j)) + age_sd*rngAge.randn(kk,ii,j);
+			}
+			xa -= mean(xa);
+			d3_A(kk)(ii)(aa,AA) = exp(xa)/sum(exp(xa));
 		}
 	}
 	
@@ -5189,18 +5740,20 @@ REPORT_SECTION
 		REPORT(msy);
 		REPORT(bmsy);
 		// REPORT(Umsy);
+		if(n_spr && !delaydiff){
+			REPORT(spr_target);
+			REPORT(fspr);
+			REPORT(bspr);
+			REPORT(yspr);
+		}
     LOG<<"Running Projections\n";
     //RF RE-INSTATED PROJECTION_MODEL :: ONLY IMPLEMENTED FOR AGS=1 AND FOR GEAR 1 (FISHERY)
     if(n_ags==1) {
-		  int ii;
-		  for(ii=1;ii<=n_tac;ii++){
-        //LOG<<ii<<" "<<tac(ii)<<'\n';
-		   	if(delaydiff){
-          projection_model_dd(tac(ii));
-        }else{
-          projection_model(tac(ii));
-        }
-		 	}
+		  if(delaydiff){
+        projection_model_dd(tac);
+      }else{
+        projection_model(tac);
+      }
 		 }
 		 if(n_ags>1){
        if(nf==1) LOG<<"************Projections not yet implemented for number of areas/groups > 1************\n\n";
@@ -5356,10 +5909,37 @@ REPORT_SECTION
      //}
 
 FUNCTION mcmc_output
-  int iter;
-  if(nf==1){
-    // Open the files and write the headers
-    ofstream ofs("iscam_mcmc.csv");
+  // The output tables stay open for the whole mceval (mcmcTables in GLOBALS)
+  // and are closed in FINAL_SECTION, where the posterior summary is written.
+  // They are CSV files, or with -mcbin binary columnar .ipost files (see
+  // PosteriorTable, -mcexport).  With -manifest only the series, groups
+  // and years in the manifest are written (see OutputManifest).
+  static bool opened = false;
+  const OutputManifest::Series& sel1 = outputManifest.get(mcmcSeries[1]);
+  const OutputManifest::Series& sel2 = outputManifest.get(mcmcSeries[2]);
+  const OutputManifest::Series& sel3 = outputManifest.get(mcmcSeries[3]);
+  const OutputManifest::Series& sel4 = outputManifest.get(mcmcSeries[4]);
+  const OutputManifest::Series& sel5 = outputManifest.get(mcmcSeries[5]);
+  const OutputManifest::Series& sel6 = outputManifest.get(mcmcSeries[6]);
+  PosteriorTable& ofs = mcmcTables[0];
+  PosteriorTable& of1 = mcmcTables[1];
+  PosteriorTable& of2 = mcmcTables[2];
+  PosteriorTable& of3 = mcmcTables[3];
+  PosteriorTable& of4 = mcmcTables[4];
+  PosteriorTable& of5 = mcmcTables[5];
+  PosteriorTable& of6 = mcmcTables[6];
+  if(!opened){
+    opened = true;
+    open_mcmc_tables();
+    BufferedOfstream::flushOnSignal();
+    // Reference points have a _gr suffix only with more than one group.
+    auto group_suffix = [&](int group) -> std::string {
+      std::ostringstream sfx;
+      if(ngroup>1) sfx<<"_gr"<<group;
+      return sfx.str();
+    };
+
+    // Column names.
     // The structure for these objects can be found at roughly lines 924 and 1409.
     // they are set up as vector_vectors to increase dimensionality
     // for the split sex case and also for areas and groups
@@ -5367,320 +5947,781 @@ FUNCTION mcmc_output
     // parametername_gr[0-9]+  - for unique group only
     // parametername_gs[0-9]+  - for unique group and sex
     // paramatername_ag[0-9]+  - for unique area and gear
-    for(int group=1;group<=ngroup;group++){
-      ofs<<"ro_gr"<<group;
-    }
-    for(int group=1;group<=ngroup;group++){
-      ofs<<","<<"h_gr"<<group;
-    }
-    for(int gs=1;gs<=n_gs;gs++){
-      ofs<<","<<"m_gs"<<gs;
-    }
-    for(int ag=1;ag<=n_ag;ag++){
-      ofs<<","<<"rbar_ag"<<ag;
-    }
-    for(int ag=1;ag<=n_ag;ag++){
-      ofs<<","<<"rinit_ag"<<ag;
-    }
-    for(int group=1;group<=ngroup;group++){
-      ofs<<","<<"rho_gr"<<group;
-    }
-    for(int group=1;group<=ngroup;group++){
-      ofs<<","<<"vartheta_gr"<<group;
-    }
-    ofs<<","<<"bo";
-    // If the msy reference points were set to be calculated in the control file,
-    //  include them
-    if(d_iscamCntrl(17)){
-      ofs<<","<<"bmsy";
-      for(int fleet=1;fleet<=nfleet;fleet++){
-        ofs<<","<<"msy"<<fleet;
+    if(ofs.is_open()){
+      for(int group=1;group<=ngroup;group++){
+        ofs.name()<<"ro_gr"<<group;
       }
-      for(int fleet=1;fleet<=nfleet;fleet++){
-        ofs<<","<<"fmsy"<<fleet;
+      for(int group=1;group<=ngroup;group++){
+        ofs.name()<<"h_gr"<<group;
       }
-      for(int fleet=1;fleet<=nfleet;fleet++){
-        ofs<<","<<"umsy"<<fleet;
+      for(int gs=1;gs<=n_gs;gs++){
+        ofs.name()<<"m_gs"<<gs;
       }
-    }
-    for(int i=1;i<=nItNobs;i++){
-      ofs<<","<<"q"<<i;
-    }
-    for(int group=1;group<=ngroup;group++){
-      ofs<<","<<"SSB"<<group;
-    }
-    for(k=1;k<=ngear;k++){
-      for (j=1;j<=jsel_npar(k);j++){
-        ofs<<","<<"sel_g"<<k;
-        ofs<<","<<"sel_sd"<<k;
+      for(int ag=1;ag<=n_ag;ag++){
+        ofs.name()<<"rbar_ag"<<ag;
       }
-    }
-    ofs<<","<<"f";
-    ofs<<'\n';
-
-    ofstream of1("iscam_sbt_mcmc.csv");
-    for(int group=1;group<=ngroup;group++){
-      for(int yr=syr;yr<=nyr+1;yr++){
-        if(yr == syr){
-          of1<<"sbt"<<group<<"_"<<yr;
-        }else{
-          of1<<",sbt"<<group<<"_"<<yr;
-        }
+      for(int ag=1;ag<=n_ag;ag++){
+        ofs.name()<<"rinit_ag"<<ag;
       }
-    }
-    of1<<'\n';
-
-    ofstream of2("iscam_rt_mcmc.csv");
-    for(int group=1;group<=ngroup;group++){
-      for(int yr=syr+sage;yr<=nyr;yr++){
-        if(yr == syr+sage){
-          of2<<"rt"<<group<<"_"<<yr;
-        }else{
-          of2<<",rt"<<group<<"_"<<yr;
-        }
+      for(int group=1;group<=ngroup;group++){
+        ofs.name()<<"rho_gr"<<group;
       }
-    }
-    of2<<'\n';
-
-    ofstream of3("iscam_ft_mcmc.csv");
-    iter = 1;
+      for(int group=1;group<=ngroup;group++){
+        ofs.name()<<"vartheta_gr"<<group;
+      }
+      for(int group=1;group<=ngroup;group++){
+        ofs.name()<<"bo"<<group_suffix(group);
+      }
+      // If the msy reference points were set to be calculated in the control file,
+      //  include them
+      if(d_iscamCntrl(17)){
+        for(int group=1;group<=ngroup;group++){
+          ofs.name()<<"bmsy"<<group_suffix(group);
+        }
+        for(int group=1;group<=ngroup;group++){
+          for(int fleet=1;fleet<=nfleet;fleet++){
+            ofs.name()<<"msy"<<fleet<<group_suffix(group);
+          }
+        }
+        for(int group=1;group<=ngroup;group++){
+          for(int fleet=1;fleet<=nfleet;fleet++){
+            ofs.name()<<"fmsy"<<fleet<<group_suffix(group);
+          }
+        }
+        for(int group=1;group<=ngroup;group++){
+          for(int fleet=1;fleet<=nfleet;fleet++){
+            ofs.name()<<"umsy"<<fleet<<group_suffix(group);
+          }
+        }
+      }
+      // SPR-based reference points, labelled by percentage, e.g. fspr40_gr1
+      if(n_spr && !delaydiff){
+        for(int group=1;group<=ngroup;group++){
+          for(int i=1;i<=n_spr;i++){
+            int pct = int(100.*spr_target(i)+0.5);
+            ofs.name()<<"fspr"<<pct<<"_gr"<<group;
+            ofs.name()<<"bspr"<<pct<<"_gr"<<group;
+          }
+        }
+      }
+      for(int i=1;i<=nItNobs;i++){
+        ofs.name()<<"q"<<i;
+      }
+      for(int group=1;group<=ngroup;group++){
+        ofs.name()<<"SSB"<<group;
+      }
+      for(k=1;k<=ngear;k++){
+        for (j=1;j<=jsel_npar(k);j++){
+          ofs.name()<<"sel_g"<<k;
+          ofs.name()<<"sel_sd"<<k;
+        }
+      }
+      ofs.name()<<"f";
+    }
+
+    for(int group=1;group<=ngroup;group++){
+      for(int yr=syr;yr<=nyr+1;yr++){
+        if(sel1.has(group,yr)) of1.name()<<"sbt"<<group<<"_"<<yr;
+      }
+    }
+
+    for(int group=1;group<=ngroup;group++){
+      for(int yr=syr+sage;yr<=nyr;yr++){
+        if(sel2.has(group,yr)) of2.name()<<"rt"<<group<<"_"<<yr;
+      }
+    }
+
     for(int ag=1;ag<=n_ags;ag++){
       for(int gear=1;gear<=ngear;gear++){
         for(int yr=syr;yr<=nyr;yr++){
-          if(iter == 1){
-            of3<<"ft"<<ag<<"_gear"<<gear<<"_"<<yr;
-          }else{
-            of3<<",ft"<<ag<<"_gear"<<gear<<"_"<<yr;
-          }
-          iter++;
+          if(sel3.has(ag,yr)) of3.name()<<"ft"<<ag<<"_gear"<<gear<<"_"<<yr;
         }
       }
     }
-    of3<<'\n';
 
-    ofstream of4("iscam_rdev_mcmc.csv");
-    iter = 1;
     for(int ag=1;ag<=n_ag;ag++){
       for(int yr=syr;yr<=nyr;yr++){
-        if(iter == 1){
-          of4<<"rdev"<<ag<<"_"<<yr;
-        }else{
-          of4<<",rdev"<<ag<<"_"<<yr;
-        }
-        iter++;
+        if(sel4.has(ag,yr)) of4.name()<<"rdev"<<ag<<"_"<<yr;
       }
     }
-    of4<<'\n';
 
-    ofstream of5("iscam_vbt_mcmc.csv");
-    iter = 1;
     for(int ag=1;ag<=ngroup;ag++){
       for(int gear=1;gear<=ngear;gear++){
         for(int yr=syr;yr<=nyr+1;yr++){
-          if(iter == 1){
-            of5<<"vbt"<<ag<<"_gear"<<gear<<"_"<<yr;
-          }else{
-            of5<<",vbt"<<ag<<"_gear"<<gear<<"_"<<yr;
-          }
-          iter++;
+          if(sel5.has(ag,yr)) of5.name()<<"vbt"<<ag<<"_gear"<<gear<<"_"<<yr;
         }
       }
     }
-    of5<<'\n';
 
-    ofstream of6("iscam_ut_mcmc.csv");
-    iter = 1;
     for(int ag=1;ag<=n_ags;ag++){
       for(int gear=1;gear<=ngear;gear++){
         for(int yr=syr;yr<=nyr;yr++){
-          if(iter == 1){
-            of6<<"ut"<<ag<<"_gear"<<gear<<"_"<<yr;
-          }else{
-            of6<<",ut"<<ag<<"_gear"<<gear<<"_"<<yr;
-          }
-          iter++;
+          if(sel6.has(ag,yr)) of6.name()<<"ut"<<ag<<"_gear"<<gear<<"_"<<yr;
         }
       }
     }
-    of6<<'\n';
   }
 
   // Leading parameters & reference points
   //Delay difference/Age-structured switch is in calcReferencePoints
-  calcReferencePoints();
+  //The reference points are only needed for iscam_mcmc.csv and the projections.
+  bool proj = n_ags==1 && outputManifest.wants("proj");
+  if(ofs.is_open() || proj) calcReferencePoints();
 
   // Append the values to the files
-  ofstream ofs("iscam_mcmc.csv",ios::app);
-  for(int group=1;group<=ngroup;group++){
-    ofs<<exp(theta(1)(group));
-  }
-  for(int group=1;group<=ngroup;group++){
-    ofs<<","<<theta(2)(group);
-  }
-  for(int gs=1;gs<=n_gs;gs++){
-    ofs<<","<<exp(theta(3)(gs));
-  }
-  for(int ag=1;ag<=n_ag;ag++){
-    ofs<<","<<exp(theta(4)(ag));
-  }
-  for(int ag=1;ag<=n_ag;ag++){
-    ofs<<","<<exp(theta(5)(ag));
-  }
-  for(int group=1;group<=ngroup;group++){
-    ofs<<","<<theta(6)(group);
-  }
-  for(int group=1;group<=ngroup;group++){
-    ofs<<","<<theta(7)(group);
-  }
-  ofs<<","<<bo;
-  // If the msy reference points were set to be calculated in the control file,
-  //  include them
-  if(d_iscamCntrl(17)){
-    ofs<<","<<bmsy;
-    for(int fleet=1;fleet<=nfleet;fleet++){
-      ofs<<","<<msy(fleet);
+  if(ofs.is_open()){
+    for(int group=1;group<=ngroup;group++){
+      ofs.add(value(exp(theta(1)(group))));
     }
-    for(int fleet=1;fleet<=nfleet;fleet++){
-      ofs<<","<<fmsy(fleet);
+    for(int group=1;group<=ngroup;group++){
+      ofs.add(value(theta(2)(group)));
     }
-    for(int fleet=1;fleet<=nfleet;fleet++){
-      ofs<<","<<1.0-exp(-fmsy(fleet));
+    for(int gs=1;gs<=n_gs;gs++){
+      ofs.add(value(exp(theta(3)(gs))));
     }
-  }
-  for(int it=1;it<=nItNobs;it++){
-    ofs<<","<<q(it);
-  }
-  for(int group=1;group<=ngroup;group++){
-    ofs<<","<<sbt(group)(nyr);
-  }
-  for(k=1;k<=ngear;k++){
-    for (j=1;j<=jsel_npar(k);j++){
-      ofs<<","<<exp(sel_par(k)(j)(1));
-      ofs<<","<<exp(sel_par(k)(j)(2));
+    for(int ag=1;ag<=n_ag;ag++){
+      ofs.add(value(exp(theta(4)(ag))));
+    }
+    for(int ag=1;ag<=n_ag;ag++){
+      ofs.add(value(exp(theta(5)(ag))));
     }
+    for(int group=1;group<=ngroup;group++){
+      ofs.add(value(theta(6)(group)));
+    }
+    for(int group=1;group<=ngroup;group++){
+      ofs.add(value(theta(7)(group)));
+    }
+    for(int group=1;group<=ngroup;group++){
+      ofs.add(bo(group));
+    }
+    // If the msy reference points were set to be calculated in the control file,
+    //  include them
+    if(d_iscamCntrl(17)){
+      for(int group=1;group<=ngroup;group++){
+        ofs.add(bmsy(group));
+      }
+      for(int group=1;group<=ngroup;group++){
+        for(int fleet=1;fleet<=nfleet;fleet++){
+          ofs.add(msy(group,fleet));
+        }
+      }
+      for(int group=1;group<=ngroup;group++){
+        for(int fleet=1;fleet<=nfleet;fleet++){
+          ofs.add(fmsy(group,fleet));
+        }
+      }
+      for(int group=1;group<=ngroup;group++){
+        for(int fleet=1;fleet<=nfleet;fleet++){
+          ofs.add(1.0-exp(-fmsy(group,fleet)));
+        }
+      }
+    }
+    if(n_spr && !delaydiff){
+      for(int group=1;group<=ngroup;group++){
+        for(int i=1;i<=n_spr;i++){
+          ofs.add(fspr(group,i));
+          ofs.add(bspr(group,i));
+        }
+      }
+    }
+    for(int it=1;it<=nItNobs;it++){
+      ofs.add(q(it));
+    }
+    for(int group=1;group<=ngroup;group++){
+      ofs.add(sbt(group)(nyr));
+    }
+    for(k=1;k<=ngear;k++){
+      for (j=1;j<=jsel_npar(k);j++){
+        ofs.add(value(exp(sel_par(k)(j)(1))));
+        ofs.add(value(exp(sel_par(k)(j)(2))));
+      }
+    }
+    ofs.add(value(objfun));
+    ofs.endRow();
   }
 
-  ofs<<","<<objfun;
-  ofs<<'\n';
-
   // output spawning stock biomass
-  ofstream of1("iscam_sbt_mcmc.csv",ios::app);
   for(int group=1;group<=ngroup;group++){
     for(int yr=syr;yr<=nyr+1;yr++){
-      if(yr == syr){
-        of1<<sbt(group)(yr);
-      }else{
-        of1<<","<<sbt(group)(yr);
-      }
+      if(sel1.has(group,yr)) of1.add(sbt(group)(yr));
     }
   }
-  of1<<'\n';
+  if(of1.is_open()) of1.endRow();
 
   // output age-1 recruits
-  ofstream of2("iscam_rt_mcmc.csv",ios::app);
   for(int group=1;group<=ngroup;group++){
     for(int yr=syr+sage;yr<=nyr;yr++){
-      if(yr == syr+sage){
-        of2<<rt(group)(yr);
-      }else{
-        of2<<","<<rt(group)(yr);
-      }
+      if(sel2.has(group,yr)) of2.add(rt(group)(yr));
     }
   }
-  of2<<'\n';
+  if(of2.is_open()) of2.endRow();
 
   // output fishing mortality
-  ofstream of3("iscam_ft_mcmc.csv",ios::app);
-  iter = 1;
   for(int ag=1;ag<=n_ags;ag++){
     for(int gear=1;gear<=ngear;gear++){
       for(int yr=syr;yr<=nyr;yr++){
-        if(iter == 1){
-          of3<<ft(ag)(gear)(yr);
-        }else{
-          of3<<","<<ft(ag)(gear)(yr);
-        }
-        iter++;
+        if(sel3.has(ag,yr)) of3.add(ft(ag)(gear)(yr));
       }
     }
   }
-  of3<<'\n';
+  if(of3.is_open()) of3.endRow();
 
   // output recruitment deviations
   // This is what the declaration of log_dev_recs looks like:
   // init_bounded_matrix log_rec_devs(1,n_ag,syr,nyr,-15.,15.,2);
-  ofstream of4("iscam_rdev_mcmc.csv",ios::app);
-  iter = 1;
   for(int ag=1;ag<=n_ag;ag++){
     for(int yr=syr;yr<=nyr;yr++){
-      if(iter == 1){
-        of4<<log_rec_devs(ag)(yr);
-      }else{
-        of4<<","<<log_rec_devs(ag)(yr);
-      }
-      iter++;
+      if(sel4.has(ag,yr)) of4.add(value(log_rec_devs(ag)(yr)));
     }
   }
-  of4<<'\n';
+  if(of4.is_open()) of4.endRow();
 
   // output vulnerable biomass to all gears //Added by RF March 19 2015
-  ofstream of5("iscam_vbt_mcmc.csv",ios::app);
-  iter = 1;
   for(int ag=1;ag<=ngroup;ag++){
     for(int gear=1;gear<=ngear;gear++){
-      for(int yr=syr;yr<=nyr;yr++){
-        if(iter == 1){
-          of5<<vbt(ag)(gear)(yr);
-        }else{
-          of5<<","<<vbt(ag)(gear)(yr);
-        }
-        iter++;
+      for(int yr=syr;yr<=nyr+1;yr++){
+        if(sel5.has(ag,yr)) of5.add(vbt(ag)(gear)(yr));
       }
     }
   }
-  of5<<'\n';
+  if(of5.is_open()) of5.endRow();
 
   // output fishing mortality as U (1-e^-F)
-  ofstream of6("iscam_ut_mcmc.csv",ios::app);
-  iter = 1;
   for(int ag=1;ag<=n_ags;ag++){
     for(int gear=1;gear<=ngear;gear++){
       for(int yr=syr;yr<=nyr;yr++){
-        if(iter == 1){
-          of6<<1.0-exp(-ft(ag)(gear)(yr));
-        }else{
-          of6<<","<<1.0-exp(-ft(ag)(gear)(yr));
-        }
-        iter++;
+        if(sel6.has(ag,yr)) of6.add(1.0-exp(-ft(ag)(gear)(yr)));
       }
     }
   }
-  of6<<'\n';
-
-  ofs.flush();
-  of1.flush();
-  of2.flush();
-  of3.flush();
-  of4.flush();
-  of5.flush();
-  of6.flush();
+  if(of6.is_open()) of6.endRow();
 
  //RF:: March 17 2015. RF re-instated projection_model for Arrowtooth Flounder assessment. NOT IMPLEMENTED FOR MULTIPLE AREA/GROUPS
  // CW: Took this out while testing  the multiple area delaydiff
  
- if(n_ags==1) {
-  int ii;
-  for(ii=1;ii<=n_tac;ii++){
-    LOG<<ii<<" "<<tac(ii)<<'\n';
-    if(!delaydiff) projection_model(tac(ii)); //TO DO: Add historical ref points
-    if(delaydiff) projection_model_dd(tac(ii)); //TO DO: update with msy and b0-based reference points
-  }
+ if(proj) {
+  if(!delaydiff) projection_model(tac); //TO DO: Add historical ref points
+  if(delaydiff) projection_model_dd(tac); //TO DO: update with msy and b0-based reference points
  }
   
  if(n_ags>1){
   if(nf==1) LOG<<"************Decision Table not yet implemented for number of areas/groups > 1************\n\n";
  }
 
+FUNCTION void mcmc_repeat()
+  /*
+  Output of an mceval draw that repeats the parameters of the previous
+  draw (-memo).  The model, calcReferencePoints and mcmc_output are
+  skipped: the model variables still hold the previous draw, so the rows
+  of the mcmc_output tables are written again.  The projections are run
+  for this draw, with its own draw number, so the recruitment deviates
+  (CounterRng, see run_projections) are the ones a full evaluation would
+  draw and the output is the same as without -memo.
+  */
+  for(int t=0;t<7;t++){
+    if(mcmcTables[t].is_open()) mcmcTables[t].repeatRow();
+  }
+  if(n_ags==1 && outputManifest.wants("proj")){
+    if(!delaydiff) projection_model(tac);
+    if(delaydiff) projection_model_dd(tac);
+  }
+
+FUNCTION void mcmc_monitor()
+  /*
+  Convergence diagnostics while -mcmc runs: split-R-hat and effective
+  sample size (ConvergenceMonitor) of the leading parameters theta (those
+  estimated), q, bo and objfun over the draws saved in the .psv file, in
+  iscam_mcmc_status.txt.
+
+  The model is evaluated for every proposal, while the .psv file has the
+  state of the chain, so the monitored values of each evaluation are kept
+  in monitorCache under its parameter vector (model scale, as in the .psv
+  file); it holds the last 2*monitorEvery evaluations, so its size does
+  not grow with the number of parameters times the run length.  Every
+  monitorEvery evaluations the draws ADMB has written to the
+  .psv file since the last time are read, looked up in monitorCache, and
+  the status file is rewritten.  Draws that are not in the cache (e.g. of
+  an earlier run continued with -mcr) are counted as unmatched.
+
+  With -mcstop the run ends when the status is converged or
+  not-converging (exit code 1).  The .psv file is not closed by ADMB then,
+  so it ends at the last draw ADMB had written out; a partly written draw
+  at the end is ignored by -mceval and by the chain merge of -nchains.
+  */
+  static long neval = 0;
+  static std::streamoff psvPos = 0;
+  static int psvNvar = 0;
+  static long long unmatched = 0;
+
+  int nvar = initial_params::nvarcalc();
+  dvector x(1,nvar);
+  int ii = 1;
+  initial_params::copy_all_values(x,ii);
+
+  std::vector<std::string> names;
+  std::vector<double> v;
+  const char* thetaNames[7] = {"log_ro","h","log_m","log_rbar","log_rinit","rho","vartheta"};
+  for(int i=1;i<=npar;i++){
+    if(theta_phz(i)<=0) continue;
+    for(int j=1;j<=ipar_vector(i);j++){
+      std::ostringstream nm;
+      if(i<=7) nm<<thetaNames[i-1]<<"_"<<j;
+      else nm<<"theta"<<i<<"_"<<j;
+      names.push_back(nm.str());
+      v.push_back(value(theta(i,j)));
+    }
+  }
+  for(int k=1;k<=nItNobs;k++){
+    std::ostringstream nm;
+    nm<<"q"<<k;
+    names.push_back(nm.str());
+    v.push_back(value(q(k)));
+  }
+  for(int g=1;g<=ngroup;g++){
+    std::ostringstream nm;
+    nm<<"bo"<<g;
+    names.push_back(nm.str());
+    v.push_back(value(sbo(g)));
+  }
+  names.push_back("objfun");
+  v.push_back(value(objfun));
+  if(!mcmcMonitor.allocated()) mcmcMonitor.allocate(names);
+  monitorCache.put(&x(1), nvar, v);
+
+  if(++neval % monitorEvery) return;
+
+  // Draws written to the .psv file since the last check.
+  adstring psvname = ad_comm::adprogram_name + adstring(".psv");
+  ifstream psv((char*)psvname, ios::binary);
+  if(!psv) return;
+  if(!psvPos){
+    if(!psv.read((char*)&psvNvar, sizeof(int))) return;
+    psvPos = sizeof(int);
+  }
+  if(psvNvar!=nvar) return;
+  psv.seekg(psvPos);
+  std::vector<double> y(nvar);
+  while(psv.read((char*)&y[0], nvar*sizeof(double))){
+    psvPos += nvar*sizeof(double);
+    const std::vector<double>* w = monitorCache.get(&y[0], nvar);
+    if(w) mcmcMonitor.add(*w);
+    else unmatched++;
+  }
+
+  ConvergenceMonitor::Status status = mcmcMonitor.update();
+  ofstream ofs("iscam_mcmc_status.txt");
+  ofs<<"# Convergence of -mcmc, rewritten every "<<monitorEvery<<" evaluations (mcmc_monitor)\n";
+  ofs<<"evaluations "<<neval<<'\n';
+  ofs<<"draws "<<mcmcMonitor.getCount()<<'\n';
+  ofs<<"unmatched "<<unmatched<<'\n';
+  ofs<<"status "<<ConvergenceMonitor::statusName(status)<<'\n';
+  mcmcMonitor.write(ofs);
+  ofs.close();
+
+  if(mcstop && (status==ConvergenceMonitor::CONVERGED || status==ConvergenceMonitor::FAILING)){
+    LOG<<"-mcstop: "<<ConvergenceMonitor::statusName(status)<<" after "<<mcmcMonitor.getCount()
+       <<" draws, see iscam_mcmc_status.txt\n";
+    ad_exit(status==ConvergenceMonitor::CONVERGED ? 0 : 1);
+  }
+
+FUNCTION void open_mcmc_tables()
+  /*
+  Opens the mcmc_output tables in the manifest, with running summaries of
+  the derived time series (tables 1-6) for iscammcmc_summary.csv.  A
+  -pmceval worker leaves the summaries and the column-major files to the
+  process that merges its tables.
+  */
+  std::ostringstream dims;
+  dims<<"ngroup="<<ngroup<<" n_ag="<<n_ag<<" n_ags="<<n_ags<<" ngear="<<ngear
+      <<" nfleet="<<nfleet<<" syr="<<syr<<" nyr="<<nyr<<" sage="<<sage<<" nage="<<nage;
+  for(int t=0;t<7;t++){
+    if(!outputManifest.wants(mcmcSeries[t])) continue;
+    mcmcTables[t].setSummary(t>0 && !pmcevalWorker);
+    mcmcTables[t].setRowMajor(pmcevalWorker);
+    mcmcTables[t].open(mcmcTableNames[t], mcBinary, dims.str());
+  }
+
+FUNCTION void close_mcmc_output()
+  /*
+  Posterior summaries (iscammcmc_summary.csv) and closing of the
+  mcmc_output tables, at the end of mceval (FINAL_SECTION) or of the merge
+  in parallel_mceval.
+  */
+  long long nsummary = 0;
+  for(int t=1;t<7;t++){
+    if(mcmcTables[t].getRows() > nsummary) nsummary = mcmcTables[t].getRows();
+  }
+  if(nsummary && !pmcevalWorker){
+    // Mean, sd and quantiles of sbt, rt, ft, rdev, vbt and ut over the draws.
+    ofstream ofs("iscammcmc_summary.csv");
+    PosteriorSummary::writeHeader(ofs);
+    for(int t=1;t<7;t++){
+      if(mcmcTables[t].getRows()) mcmcTables[t].getSummary().write(ofs, mcmcTableNames[t]);
+    }
+    LOG<<"Posterior summaries of "<<nsummary<<" draws written to iscammcmc_summary.csv\n";
+  }
+  for(int t=0;t<7;t++){
+    mcmcTables[t].close();
+  }
+  BufferedOfstream::flushAll();
+
+FUNCTION void parallel_mceval()
+  /*
+  -mceval -pmceval n: the draws of the .psv file are split into n
+  contiguous chunks, and each chunk is evaluated by a forked worker process
+  in its own directory, pmceval_1 to pmceval_n, which gets the chunk as its
+  .psv file.  The workers return from here with the data already read and
+  run the ADMB mceval of their chunk, writing row-major binary tables and
+  the projection state only (the projections are run in the merge).  Their
+  draw numbers start at the first draw of the chunk, so the projection
+  recruitment deviates (CounterRng) are those of a serial mceval.
+
+  This process waits for the workers and merges their output in draw
+  order (merge_pmceval), then exits.  Each worker logs to its own
+  directory: iscam_runtime.log (LOG) and pmceval.log (screen output), so
+  the workers' output is not interleaved.
+  */
+  adstring psvname = ad_comm::adprogram_name + adstring(".psv");
+  ifstream psv((char*)psvname, ios::binary);
+  int nvar = 0;
+  if(!psv || !psv.read((char*)&nvar, sizeof(int)) || nvar<1){
+    LOG<<"Cannot read "<<psvname<<", run -mcmc first\n";
+    ad_exit(1);
+  }
+  psv.seekg(0, ios::end);
+  const long long rowBytes = sizeof(double)*nvar;
+  const long long ndraw = ((long long)psv.tellg() - (long long)sizeof(int))/rowBytes;
+  const int nw = pmceval < ndraw ? pmceval : int(ndraw);
+  if(nw<1){
+    LOG<<psvname<<" has no draws\n";
+    ad_exit(1);
+  }
+  LOG<<"Parallel mceval of "<<ndraw<<" draws with "<<nw<<" worker processes\n";
+
+  std::vector<pid_t> pids;
+  std::vector<char> buf(1<<20);
+  for(int w=1; w<=nw; w++){
+    const long long first = ndraw*(w-1)/nw;
+    const long long last  = ndraw*w/nw;
+    std::ostringstream dir;
+    dir<<"pmceval_"<<w;
+    mkdir(dir.str().c_str(), 0755);
+    ofstream ofs((dir.str()+"/"+(char*)psvname).c_str(), ios::binary);
+    ofs.write((char*)&nvar, sizeof(int));
+    psv.clear();
+    psv.seekg(sizeof(int) + rowBytes*first);
+    for(long long n=rowBytes*(last-first); n>0 && psv; ){
+      long long nb = n < (long long)buf.size() ? n : (long long)buf.size();
+      psv.read(&buf[0], nb);
+      ofs.write(&buf[0], nb);
+      n -= nb;
+    }
+    ofs.close();
+    if(!psv || !ofs){
+      LOG<<"Cannot write the draws of worker "<<w<<" to "<<dir.str()<<'\n';
+      ad_exit(1);
+    }
+
+    // Unflushed stdio output would be written again by the child.
+    cout.flush();
+    fflush(NULL);
+    pid_t pid = fork();
+    if(pid<0){
+      LOG<<"Cannot start worker "<<w<<'\n';
+      ad_exit(1);
+    }
+    if(pid==0){
+      if(chdir(dir.str().c_str())){
+        _exit(1);
+      }
+      int fd = ::open("pmceval.log", O_WRONLY|O_CREAT|O_TRUNC, 0644);
+      if(fd>=0){
+        dup2(fd, 1);
+        dup2(fd, 2);
+        ::close(fd);
+      }
+      Logger::instance().redirect("iscam_runtime.log");
+      LOG<<"pmceval worker "<<w<<" of "<<nw<<", draws "<<first+1<<"-"<<last<<'\n';
+      pmcevalWorker    = true;
+      pmcevalFirstDraw = int(first);
+      mcBinary = 1;
+      drawCsv  = 0;
+      return;
+    }
+    pids.push_back(pid);
+  }
+  psv.close();
+
+  int nfail = 0;
+  for(int w=1; w<=nw; w++){
+    int status = 0;
+    waitpid(pids[w-1], &status, 0);
+    if(!WIFEXITED(status) || WEXITSTATUS(status)){
+      LOG<<"pmceval worker "<<w<<" failed, see pmceval_"<<w<<"/iscam_runtime.log and pmceval.log\n";
+      nfail ++;
+    }
+  }
+  if(nfail){
+    ad_exit(1);
+  }
+  merge_pmceval(nw);
+  ad_exit(0);
+
+FUNCTION void mcmc_chains()
+  /*
+  -mcmc n -nchains k [-mcseed seed]: k independent chains in parallel, each
+  a separate iscam -mcmc process in its own directory, chain_1 to chain_k,
+  with copies of the input files.  Chain c has the seed seed+c (seed is
+  rseed without -mcseed) and starts from an overdispersed draw of the
+  normal approximation of the posterior of the fitted model, passed with
+  -mcpin.  The other options (-mcmc, -mcsave, ...) are passed on.  Each
+  chain fits the model again, because the ADMB proposal uses the Hessian
+  of the fit.
+
+  The starting points need the .cor file of a fit in this directory: the
+  estimates, standard deviations and correlations of the active
+  parameters are mapped to the unbounded scale of the ADMB parameters
+  (numerical derivatives of initial_params::xinit), drawn there with
+  twice the standard deviations so that they are inside the bounds, and
+  mapped back to the model scale of the .psv file.
+
+  When the chains are done their draws are pooled in this directory's
+  .psv file (chain after chain, for -mceval or -pmceval) and in
+  iscam_chains.csv with the chain and draw numbers, for diagnostics.
+  A chain that exits with an error (including not-converging under
+  -mcstop) is reported and left out of the pool; the draws of the other
+  chains are still pooled, and the exit code is then 1.
+  */
+  const double spread = 2.0;
+  initial_params::current_phase = initial_params::max_number_phases;
+  const int nvar = initial_params::nvarcalc();
+  adstring corname = ad_comm::adprogram_name + adstring(".cor");
+  ParameterCorrelations pc;
+  if(!pc.read((char*)corname, nvar)){
+    ad_exit(1);
+  }
+
+  // Estimates in the unbounded scale and the derivatives of the mapping,
+  // which is one parameter at a time.
+  dvector xhat(1,nvar);
+  for(int i=1;i<=nvar;i++) xhat(i) = pc.value[i-1];
+  int ii = 1;
+  initial_params::restore_all_values(xhat,ii);
+  dvector yhat(1,nvar);
+  initial_params::xinit(yhat);
+  dvector dydx(1,nvar);
+  for(int i=1;i<=nvar;i++){
+    dvector x(1,nvar);
+    dvector y(1,nvar);
+    x = xhat;
+    double h = 1.e-6*(fabs(xhat(i))+1.e-3);
+    x(i) += h;
+    ii = 1;
+    initial_params::restore_all_values(x,ii);
+    initial_params::xinit(y);
+    dydx(i) = (y(i)-yhat(i))/h;
+  }
+  std::vector<double> L(nvar*nvar);
+  for(int i=0;i<nvar;i++){
+    for(int j=0;j<nvar;j++){
+      L[i*nvar+j] = pc.cor[i*nvar+j]*pc.sd[i]*pc.sd[j]*dydx(i+1)*dydx(j+1);
+    }
+  }
+  if(!cholesky(L, nvar)){
+    // Rounded correlations, start from independent draws.
+    LOG<<"The covariance from "<<corname<<" is not positive definite, the starting points ignore the correlations\n";
+    for(int i=0;i<nvar;i++){
+      for(int j=0;j<nvar;j++){
+        L[i*nvar+j] = i==j ? fabs(pc.sd[i]*dydx(i+1)) : 0;
+      }
+    }
+  }
+
+  int on, opt;
+  long seed = rseed;
+  if((on=option_match(ad_comm::argc,ad_comm::argv,"-mcseed",opt))>-1 && on+1 < ad_comm::argc){
+    seed = atol(ad_comm::argv[on+1]);
+  }
+  CounterRng rng(seed, CounterRng::MCMC_START);
+
+  // Input files of the chains, by their base names.
+  std::vector<std::string> inputs;
+  inputs.push_back((char*)DataFile);
+  inputs.push_back((char*)ControlFile);
+  inputs.push_back((char*)ProjectFileControl);
+  inputs.push_back((char*)ProcedureControlFile);
+  inputs.push_back((char*)ScenarioControlFile);
+  inputs.push_back(std::string((char*)ad_comm::adprogram_name) + ".pin");
+
+  // The program, and the options that are passed on to the chains.
+  std::string prog(ad_comm::argv[0]);
+  if(prog.find('/') != std::string::npos){
+    char* path = realpath(prog.c_str(), 0);
+    if(path){
+      prog = path;
+      free(path);
+    }
+  }
+  std::vector<std::string> args(1, prog);
+  for(int a=1; a<ad_comm::argc; a++){
+    std::string arg(ad_comm::argv[a]);
+    if(arg=="-nchains" || arg=="-mcseed" || arg=="-mcpin" || arg=="-ind"){
+      a++;
+      continue;
+    }
+    args.push_back(arg);
+  }
+
+  LOG<<"Running "<<nchains<<" MCMC chains in chain_1 to chain_"<<nchains<<'\n';
+  std::vector<pid_t> pids;
+  for(int c=1; c<=nchains; c++){
+    std::ostringstream dir;
+    dir<<"chain_"<<c;
+    mkdir(dir.str().c_str(), 0755);
+
+    ofstream dat((dir.str()+"/"+(char*)ad_comm::adprogram_name+".dat").c_str());
+    for(size_t f=0; f<inputs.size(); f++){
+      ifstream ifs(inputs[f].c_str(), ios::binary);
+      if(inputs[f].empty() || !ifs) continue;
+      std::string base = inputs[f].substr(inputs[f].find_last_of('/')+1);
+      ofstream ofs((dir.str()+"/"+base).c_str(), ios::binary);
+      ofs<<ifs.rdbuf();
+      if(f<5) dat<<base<<'\n';
+    }
+    dat.close();
+
+    // Overdispersed starting point.
+    dvector y(1,nvar);
+    for(int i=1;i<=nvar;i++){
+      y(i) = yhat(i);
+      for(int j=1;j<=i;j++){
+        y(i) += spread*L[(i-1)*nvar+j-1]*rng.randn(c,j);
+      }
+    }
+    initial_params::reset(y);
+    dvector x(1,nvar);
+    ii = 1;
+    initial_params::copy_all_values(x,ii);
+    ofstream pin((dir.str()+"/mcmc_start.pin").c_str());
+    pin<<setprecision(17);
+    for(int i=1;i<=nvar;i++) pin<<x(i)<<'\n';
+    pin.close();
+    if(!pin || !dat){
+      LOG<<"Cannot write the input files of chain "<<c<<" in "<<dir.str()<<'\n';
+      ad_exit(1);
+    }
+
+    std::ostringstream cseed;
+    cseed<<seed+c;
+    std::vector<std::string> cargs(args);
+    cargs.push_back("-mcseed");
+    cargs.push_back(cseed.str());
+    cargs.push_back("-mcpin");
+    cargs.push_back("mcmc_start.pin");
+    std::vector<char*> argv;
+    for(size_t a=0; a<cargs.size(); a++) argv.push_back(const_cast<char*>(cargs[a].c_str()));
+    argv.push_back(0);
+
+    cout.flush();
+    fflush(NULL);
+    pid_t pid = fork();
+    if(pid<0){
+      LOG<<"Cannot start chain "<<c<<'\n';
+      ad_exit(1);
+    }
+    if(pid==0){
+      // The chain's output goes to chain_c/chain.log.
+      if(chdir(dir.str().c_str())==0){
+        int fd = ::open("chain.log", O_WRONLY|O_CREAT|O_TRUNC, 0644);
+        if(fd>=0){
+          dup2(fd, 1);
+          dup2(fd, 2);
+          ::close(fd);
+        }
+        execvp(argv[0], &argv[0]);
+      }
+      _exit(127);
+    }
+    pids.push_back(pid);
+  }
+
+  std::vector<std::string> psvfiles;
+  std::vector<int> chains;
+  for(int c=1; c<=nchains; c++){
+    int status = 0;
+    waitpid(pids[c-1], &status, 0);
+    if(!WIFEXITED(status) || WEXITSTATUS(status)){
+      LOG<<"Chain "<<c<<" failed, see chain_"<<c<<"/chain.log; its draws are not pooled\n";
+      continue;
+    }
+    std::ostringstream fn;
+    fn<<"chain_"<<c<<"/"<<ad_comm::adprogram_name<<".psv";
+    psvfiles.push_back(fn.str());
+    chains.push_back(c);
+  }
+  if(chains.empty()){
+    ad_exit(1);
+  }
+
+  adstring psvname = ad_comm::adprogram_name + adstring(".psv");
+  if(!merge_chains(psvfiles, chains, pc.columnNames(), (char*)psvname, "iscam_chains.csv")){
+    ad_exit(1);
+  }
+  LOG<<"Pooled the draws of "<<int(chains.size())<<" of "<<nchains<<" chains in "<<psvname<<" and iscam_chains.csv\n";
+  ad_exit(int(chains.size())==nchains ? 0 : 1);
+
+FUNCTION void merge_pmceval(const int& nw)
+  /*
+  Output of -pmceval from the worker directories, in draw order: the rows
+  of the mcmc_output tables, and the projection state files, from which
+  the projections, decision table and harvest control rule projections
+  are run again (see projection_only).  The merged worker files are
+  removed.
+  */
+  open_mcmc_tables();
+  for(int t=0;t<7;t++){
+    if(!mcmcTables[t].is_open()) continue;
+    for(int w=1; w<=nw; w++){
+      std::ostringstream part;
+      part<<"pmceval_"<<w<<"/"<<mcmcTableNames[t]<<".ipost.part";
+      if(!posterior_append(part.str(), mcmcTables[t])){
+        ad_exit(1);
+      }
+      std::remove(part.str().c_str());
+    }
+  }
+
+  if(n_ags==1 && outputManifest.wants("proj")){
+    BufferedOfstream ofs;
+    ofs.open("iscammcmc_proj_state.bin", ios::binary);
+    for(int w=1; w<=nw; w++){
+      std::ostringstream fn;
+      fn<<"pmceval_"<<w<<"/iscammcmc_proj_state.bin";
+      ifstream ifs(fn.str().c_str(), ios::binary);
+      ProjectionStateHeader h;
+      if(!ifs || !h.read(ifs)){
+        LOG<<"Cannot read the projection state file "<<fn.str()<<'\n';
+        ad_exit(1);
+      }
+      if(w==1) h.write(ofs);
+      ofs<<ifs.rdbuf();
+      ifs.close();
+      std::remove(fn.str().c_str());
+    }
+    ofs.close();
+    projOnly = 2;
+    projection_only();
+  }
+  close_mcmc_output();
+
+  adstring psvname = ad_comm::adprogram_name + adstring(".psv");
+  for(int w=1; w<=nw; w++){
+    std::ostringstream fn;
+    fn<<"pmceval_"<<w<<"/"<<psvname;
+    std::remove(fn.str().c_str());
+  }
+  LOG<<"Merged the mceval output of "<<nw<<" workers\n";
+
 // FUNCTION dvector age3_recruitment(const dvector& rt, const double& wt,const double& M)
 //   {
 // /*
@@ -5711,15 +6752,15 @@ FUNCTION mcmc_output
 
  //RF re-instated this code (with several updates to match current version, and new code for projection output files for 2014 Arrowtooth Flounder) March 17 2015
  // !!! NOT IMPLEMENTED FOR n_ags > 1!!!
-FUNCTION void projection_model(const double& tac);
+FUNCTION void projection_model(const dvector& tac);
   /*
   This routine conducts population projections based on
-  the estimated values of theta.  Note that all variables
-  in this routine are data type variables.
+  the estimated values of theta for every TAC option at once.
+  Note that all variables in this routine are data type variables.
 
   Arguments:
-  tac is the total allowable catch that must be allocated
-  to each gear type based on dAllocation(k)
+  tac is the vector of total allowable catch options, each is
+  allocated to the gear types based on dAllocation(k)
 
   theta(1) = log_ro
   theta(2) = h
@@ -5733,12 +6774,26 @@ FUNCTION void projection_model(const double& tac);
   * Projections are based on average natural mortality and fecundity.
   * Selectivity is based on selectivity in terminal year.
   * Average weight-at-age is based on mean weight in the last 5 years.
+  * The setup below is shared by all TAC options; ProjectionModel advances
+    a (TAC, age) matrix of numbers and solves the catch equation for all
+    TAC options together in each projection year.
+  * The rows for all TAC options of a draw are written with one write.
+  * The horizon is n_proj years (pf_cntrl(10)); iscammcmc_proj_Gear1.csv keeps
+    the nyr+1 and nyr+2 columns and iscammcmc_proj_years.csv has one row for
+    each draw, TAC and projection year.
+  * In mceval every draw is added to decisionTable, which is written to
+    iscammcmc_decision_table.csv in FINAL_SECTION; -nodrawcsv skips the
+    per-draw files above.
+  * With a harvest control rule (pf_cntrl(11-14)) the draw is also kept in
+    hcrDraws for hcr_projection in FINAL_SECTION.
+  * The inputs of the draw are saved in the state file (see
+    open_projection_state) and
+    projected by run_projections, so -projonly can repeat the projections
+    for a new projection control file without refitting the model.
   */
-  static int runNo=0;
-  runNo ++;
-  int i,k;
-  int pyr = nyr+1;
-  BaranovCatchEquation cBaranov;
+  static int iter=0;
+  if(mceval_phase()) iter ++;
+  int i;
   // | (2) : Average weight and mature spawning biomass for reference years  (copied from calcReferencePoints() but only implemented for ig=1)
   // |     : dWt_bar(1,n_ags,sage,nage)
   dvector fa_bar(sage,nage);
@@ -5750,7 +6805,6 @@ FUNCTION void projection_model(const double& tac);
   // --survivorship of spawning biomass
   dvector lx(sage,nage);
   double  tau = value(sqrt(1.-rho)*varphi);
-  //double m_rho = d_iscamCntrl(13);
   lx(sage)     = 1.;
   for(i=sage+1; i<=nage; i++){
    lx(i) = lx(i-1)*mfexp(-M_bar(i-1));
@@ -5768,86 +6822,83 @@ FUNCTION void projection_model(const double& tac);
     beta = value(log(kappa(1)/bo));
     break;
   }
-  /* Fill arrays with historical values */
-  dvector p_sbt(syr,pyr+1);
-  dvector  p_ct(1,ngear);
-  dmatrix  p_ft(nyr,pyr+1,1,ngear);
-  dmatrix   p_N(syr,pyr+2,sage,nage);
-  dmatrix   p_Z(syr,pyr+1,sage,nage);
-  p_N.initialize();
-  p_sbt.initialize();
-  p_Z.initialize();
-  p_ct.initialize();
-  p_ft.initialize();
+
+  /* Selectivity in the terminal year */
+  dmatrix va_bar(1,ngear,sage,nage);
+  for(int k=1;k<=ngear;k++){
+   va_bar(k) = exp(value(log_sel(k)(1)(nyr)));
+  }
 
   //The main model already does a projection to nyr+1
   //but want to draw an average recruitment for projection rather than highly uncertain estimate
-  for(i = syr; i<=nyr; i++){
-   p_N(i) = value(N(1)(i));
-   p_sbt(i) =  value(sbt(1)(i));
-   p_Z(i) =  value(Z(1)(i));
+  //d_iscamCntrl(13) is defined as: fraction of total mortality that takes place prior to spawning
+  ProjectionDraw d;
+  d.draw = mceval_phase() ? pmcevalFirstDraw + iter : 0;
+  d.M    = M_bar;
+  d.fa   = fa_bar;
+  d.wa   = dWt_bar(1);
+  d.va   = va_bar;
+  d.so   = so;
+  d.beta = beta;
+  d.tau  = tau;
+  d.N.allocate(nyr-1,nyr,sage,nage);
+  d.Z.allocate(nyr-1,nyr,sage,nage);
+  for(i = nyr-1; i<=nyr; i++){
+    d.N(i) = value(N(1)(i));
+    d.Z(i) = value(Z(1)(i));
   }
+  d.sbt   = value(sbt(1)(syr,nyr));
+  d.bo    = bo;
+  d.bmsy  = bmsy(1);
+  d.fmsy  = fmsy(1,1);
+  d.ftnyr = value(ft(1)(1,nyr));
+
+  static BufferedOfstream ofs;
+  open_projection_state(ofs, 0);
+  d.write(ofs);
+  if(!mceval_phase()) ofs.close();
+  // A -pmceval worker only saves the state, see merge_pmceval.
+  if(!pmcevalWorker) run_projections(tac, d, mceval_phase());
+
+FUNCTION void run_projections(const dvector& tac, ProjectionDraw& d, const bool& mcmc)
+  /*
+  Constant TAC projections of one draw (from projection_model or from the
+  saved state in projection_only) and their output.
 
-  /* Selectivity and dAllocation to gears */
-  dmatrix va_bar(1,ngear,sage,nage);
-  for(k=1;k<=ngear;k++){
-   p_ct(k)   = dAllocation(k)*tac;
-   va_bar(k) = exp(value(log_sel(k)(1)(nyr)));
+  The recruitment deviates are drawn here from the CounterRng with the
+  draw number, so they are the same for each TAC option (TAC slot 0 of the
+  counter) and a rerun reproduces them for any projection horizon.
+  NOTE that this treatment of rec devs is different from historical model.
+
+  mcmc = true adds the draw to decisionTable, hcrDraws and the per-draw
+  iscammcmc_proj_*.csv files; otherwise iscammpd_proj_Gear1.csv is
+  rewritten with the MPD rows.
+  */
+  static int nmcmc=0;
+  static BufferedOfstream ofsmcmc;
+  static BufferedOfstream ofsyrs;
+  int i;
+  int pyr = nyr+1;
+  CounterRng rng(rseed, CounterRng::PROJ_RECRUITMENT);
+  dvector xx(nyr-1,nyr+n_proj);
+  for(i = nyr-1; i<=nyr+n_proj; i++){
+    xx(i) = rng.randn(d.draw,0,i)*d.tau;
   }
+  d.xx = xx;
 
-  /* Simulate population into the future under constant tac policy. */
-  for(i = nyr-1; i<=pyr+1; i++){
-    //ft(nyr) is a function of ct(nyr) not the tac so use ft(nyr) from the main model for nyr
-    if(i>nyr){
-     // get_ft is defined in the Baranov.cpp file
-     //average weight is calculated for all area/groups but projections are currently only implemented for n_ags=1
-     p_ft(i) = cBaranov.getFishingMortality(p_ct,M_bar, va_bar, p_N(i),dWt_bar(1));  
-     // calculate total mortality in future years
-     p_Z(i) = M_bar;
-     for(k=1;k<=ngear;k++){
-      p_Z(i)+=p_ft(i,k)*va_bar(k);
-     }
-    }
+  int ntac = tac.indexmax()-tac.indexmin()+1;
+  ProjectionModel cProj(ntac, dAllocation, sage, nage, syr, nyr, n_proj, int(d_iscamCntrl(2)), d_iscamCntrl(13));
+  for(int t=1; t<=ntac; t++){
+    cProj.setProblem(t, d);
+    cProj.setTac(t, tac(tac.indexmin()+t-1));
+  }
+  cProj.run();
 
-    //Overwrite sbt(nyr) so that it does not include estimated Rt(nyr), which is highly uncertain
-    //This will only be different from sbt(nyr) in the main model if recruits contribute to the spawning population, which is rare
-    //d_iscamCntrl(13) is defined as: fraction of total mortality that takes place prior to spawning
-    if(i>=nyr){
-      p_sbt(i) = elem_prod(p_N(i),exp(-p_Z(i)*d_iscamCntrl(13))) *fa_bar;
-    }
+  // Keep the draw for the harvest control rule projections in FINAL_SECTION.
+  if(mcmc && hcr_ref){
+    hcrDraws.push_back(d);
+  }
 
-    // sage recruits with random deviate xx
-    // note the random number seed is repeated for each tac level.
-    //NOTE that this treatment of rec devs is different from historical model
-    double  xx = randn(nf+i)*tau;
-    if(i>=syr+sage-1){
-      double rt = 1;
-      double et = p_sbt(i-sage+1);  //lagged spawning biomass  (+1 because we want recruits for year i+1)
-      if(d_iscamCntrl(2)==1){      // Beverton-Holt model
-        rt=(so*et/(1.+beta*et));
-      }
-      if(d_iscamCntrl(2)==2){      // Ricker model
-        rt=(so*et*exp(-beta*et));
-      }
-      p_N(i+1,sage)=rt*exp(xx-0.5*tau*tau);  //Next year's recruits
-    }
-    /* Update numbers at age in future years*/
-    //Next year's numbers
-    p_N(i+1)(sage+1,nage) =++ elem_prod(p_N(i)(sage,nage-1),exp(-p_Z(i)(sage,nage-1)));
-    p_N(i+1,nage)        +=   p_N(i,nage)*exp(-p_Z(i,nage));
-
-    //Predicted catch for checking calculations    (RF tested this March 17, 2015)
-    //if(i > nyr){
-    //        LOG<<p_ft<<'\n';
-    // for(k=1;k<=ngear;k++)
-    // {
-    //  dvector ba = elem_prod(p_N(i),dWt_bar(1));
-    //  double ctest;
-    //  ctest = sum(elem_div(elem_prod(elem_prod(ba,p_ft(i,k)*va_bar(k)),1.-exp(-p_Z(i))),p_Z(i)));
-    //  LOG<<"gear = "<<k<<" tac = "<<tac<<"\t ct = "<<ctest<<'\n';
-    // }
-    //}
-  } //end year loop
   /*
   Write output to projection file for constructing decision tables.
   For BC Arrowtooth Flounder 2014 assessment (Forrest, Grandin, Pacific Biological Station)
@@ -5857,33 +6908,165 @@ FUNCTION void projection_model(const double& tac);
   */
 
 //write_proj_headers and write_proj_output are in include/utilities.h 
-//ofsmcmc object is in libs/utilities.cpp
-  if(mceval_phase()){
-   if(nf==1 && runNo==1){
+  if(mcmc){
+   if(!decisionTable.allocated()){
+    decisionTable.allocate(tac, syr, nyr, d_iscamCntrl(17));
+   }
+   for(int t=1; t<=ntac; t++){
+    decisionTable.add(t, cProj.getSbt(t), cProj.getFt(t), d.ftnyr, d.bo, d.fmsy, d.bmsy);
+   }
+  }
+  if(mcmc && drawCsv){
+   // The files stay open until the end of the run (see BufferedOfstream).
+   if(nmcmc++==0){
     LOG<<"Running MCMC projections\n";
-    ofstream ofsmcmc("iscammcmc_proj_Gear1.csv");
+    ofsmcmc.open("iscammcmc_proj_Gear1.csv");
     write_proj_headers(ofsmcmc, syr, nyr, d_iscamCntrl(17));
-    ofsmcmc.flush();
+    ofsyrs.open("iscammcmc_proj_years.csv");
+    write_proj_year_headers(ofsyrs, ngear, d_iscamCntrl(17));
    }
-   ofstream ofsmcmc("iscammcmc_proj_Gear1.csv", ios::app);
-   write_proj_output(ofsmcmc, syr, nyr, tac, pyr, p_sbt, p_ft, ft(1), bo, fmsy, bmsy, d_iscamCntrl(17));
-   ofsmcmc.flush();
-  }else{
-//   if(runNo==1){
-//    LOG<<"Running MPD projections"<<'\n';
-//    ofstream ofsmpd("iscammpd_proj_Gear1.csv");
-//    write_proj_output(ofsmpd);
-//    ofsmpd.flush();
-//   }
-//   ofstream ofsmpd("iscammpd_proj_Gear1.csv", ios::app);
-//   write_proj_output(ofsmpd, tac, pyr, p_sbt, p_ft);
-//   ofsmpd.flush();
+   for(int t=1; t<=ntac; t++){
+    dvector p_sbt = cProj.getSbt(t);
+    dmatrix p_ft  = cProj.getFt(t);
+    dvector p_tac = cProj.getTac(t);
+    write_proj_output(ofsmcmc, syr, nyr, p_tac(pyr), pyr, p_sbt, p_ft, d.ftnyr, d.bo, d.fmsy, d.bmsy, d_iscamCntrl(17));
+    write_proj_years(ofsyrs, d.draw, p_tac, nyr, cProj.getLastYear(), p_sbt, p_ft, cProj.getClipped(t), d.bo, d.bmsy, d_iscamCntrl(17));
+   }
+  }
+  if(!mcmc){
+   ofstream ofsmpd("iscammpd_proj_Gear1.csv");
+   write_proj_headers(ofsmpd, syr, nyr, d_iscamCntrl(17));
+   for(int t=1; t<=ntac; t++){
+    dvector p_tac = cProj.getTac(t);
+    write_proj_output(ofsmpd, syr, nyr, p_tac(pyr), pyr, cProj.getSbt(t), cProj.getFt(t), d.ftnyr, d.bo, d.fmsy, d.bmsy, d_iscamCntrl(17));
+   }
+   LOG<<"Finished projection model for "<<ntac<<" TAC options\n";
+  }
+
+FUNCTION void open_projection_state(BufferedOfstream& ofs, const int& type)
+  /*
+  Gets the projection state file ready for the next draw:
+  iscammcmc_proj_state.bin in mceval (opened with a header for the first
+  draw and kept open for the others) and iscam_proj_state.bin otherwise
+  (rewritten on each call, so it keeps the last MPD state).  type is 0 for
+  ProjectionDraw and 1 for DDProjectionDraw records.  See projection_only.
+  */
+  if(mceval_phase() && ofs.is_open()){
+    return;
+  }
+  ofs.open(mceval_phase() ? "iscammcmc_proj_state.bin" : "iscam_proj_state.bin", ios::binary);
+  ProjectionStateHeader h;
+  h.type  = type;
+  h.sage  = sage;
+  h.nage  = nage;
+  h.ngear = ngear;
+  h.syr   = syr;
+  h.nyr   = nyr;
+  h.write(ofs);
+
+FUNCTION void projection_only()
+  /*
+  -projonly [mcmc]: rerun the projections and decision tables for the
+  current projection control file (TAC options, horizon, harvest control
+  rule) from the state saved by the fitted model, without fitting it again.
+  The MPD state (iscam_proj_state.bin) is used by default and the mceval
+  draws (iscammcmc_proj_state.bin) with "mcmc".  The output files are the
+  same as those of the fit or of -mceval.
+  */
+  const char* fn = projOnly==2 ? "iscammcmc_proj_state.bin" : "iscam_proj_state.bin";
+  bool mcmc = projOnly==2;
+  if(n_ags>1){
+    LOG<<"Projections not yet implemented for number of areas/groups > 1\n";
+    ad_exit(1);
+  }
+  ifstream ifs(fn, ios::binary);
+  ProjectionStateHeader h;
+  if(!ifs || !h.read(ifs)){
+    LOG<<"Cannot read the projection state file "<<fn<<", run the model"<<(mcmc ? " with -mceval" : "")<<" first\n";
+    ad_exit(1);
+  }
+  if(h.type!=delaydiff || h.sage!=sage || h.nage!=nage || h.ngear!=ngear || h.syr!=syr || h.nyr!=nyr){
+    LOG<<"The projection state file "<<fn<<" was written by a different model\n";
+    LOG<<"(type "<<h.type<<", ages "<<h.sage<<"-"<<h.nage<<", gears "<<h.ngear<<", years "<<h.syr<<"-"<<h.nyr<<")\n";
+    ad_exit(1);
+  }
+
+  int ndraw = 0;
+  for(;;){
+    if(delaydiff){
+      DDProjectionDraw d;
+      if(!d.read(ifs, h)) break;
+      run_projections_dd(tac, d, mcmc);
+    }else{
+      ProjectionDraw d;
+      if(!d.read(ifs, h)) break;
+      run_projections(tac, d, mcmc);
+    }
+    ndraw ++;
+  }
+  LOG<<"Projected "<<ndraw<<" draws from "<<fn<<'\n';
+  if(mcmc){
+    write_mcmc_projections();
+  }
+  BufferedOfstream::flushAll();
+
+FUNCTION void write_mcmc_projections()
+  /*
+  Output of the projections that need all mceval draws: the decision
+  table and the harvest control rule projections.
+  */
+  if(decisionTable.allocated()){
+    ofstream ofs("iscammcmc_decision_table.csv");
+    decisionTable.write(ofs);
+    LOG<<"Decision table for "<<decisionTable.getCount(1)<<" draws written to iscammcmc_decision_table.csv\n";
   }
-  if(!mceval_phase()){
-   LOG<<"Finished projection model for TAC = "<<tac<<'\n';
+  if(hcrDraws.size()){
+    hcr_projection();
   }
 
-FUNCTION void projection_model_dd(const double& tac);	
+FUNCTION void hcr_projection()
+  /*
+  Projections of all mceval draws under the hockey-stick harvest control
+  rule in pf_cntrl(11-14).  The TAC in each projection year is
+
+    u(B/Bref) * B,  B = spawning biomass in the previous year,
+
+  so the catch, and the ft that takes it, depend on the draw's own
+  projected biomass.  projection_model keeps the inputs of each draw in
+  hcrDraws and they are projected here together: every year the catch
+  equations of all draws are solved in one BaranovBatch call, shared out
+  over the worker threads.
+
+  Output:
+  * iscammcmc_proj_hcr.csv has the same columns as iscammcmc_proj_Gear1.csv,
+    one row per draw, with TAC the catch from the rule in nyr+1.
+  * iscammcmc_proj_hcr_years.csv has one row per draw and projection year.
+  */
+  int ndraw = hcrDraws.size();
+  int pyr   = nyr+1;
+  LOG<<"Running harvest control rule projections for "<<ndraw<<" draws\n";
+  ProjectionModel cProj(ndraw, dAllocation, sage, nage, syr, nyr, n_proj, int(d_iscamCntrl(2)), d_iscamCntrl(13));
+  cProj.setHarvestControlRule(hcr_ref, hcr_lrp, hcr_usr, hcr_hmax);
+  for(int p=1; p<=ndraw; p++){
+    cProj.setProblem(p, hcrDraws[p-1]);
+  }
+  cProj.run(true);
+
+  ofstream ofsmcmc("iscammcmc_proj_hcr.csv");
+  ofstream ofsyrs("iscammcmc_proj_hcr_years.csv");
+  write_proj_headers(ofsmcmc, syr, nyr, d_iscamCntrl(17));
+  write_proj_year_headers(ofsyrs, ngear, d_iscamCntrl(17));
+  for(int p=1; p<=ndraw; p++){
+    const ProjectionDraw& d = hcrDraws[p-1];
+    dvector p_sbt = cProj.getSbt(p);
+    dmatrix p_ft  = cProj.getFt(p);
+    dvector p_tac = cProj.getTac(p);
+    write_proj_output(ofsmcmc, syr, nyr, p_tac(pyr), pyr, p_sbt, p_ft, d.ftnyr, d.bo, d.fmsy, d.bmsy, d_iscamCntrl(17));
+    write_proj_years(ofsyrs, d.draw, p_tac, nyr, cProj.getLastYear(), p_sbt, p_ft, cProj.getClipped(p), d.bo, d.bmsy, d_iscamCntrl(17));
+  }
+  hcrDraws.clear();
+
+FUNCTION void projection_model_dd(const dvector& tac);	
   {
 	/*
 	This routine conducts population projections based on 
@@ -5891,8 +7074,8 @@ FUNCTION void projection_model_dd(const double& tac);
 	in this routine are data type variables.
 	
 	Arguments:
-	tac is the total allowable catch that must be allocated 
-	to each gear type based on allocation(k)
+	tac is the vector of total allowable catch options, all of
+	which are projected together (see DDProjection)
 	
 	theta(1) = log_ro
 	theta(2) = h
@@ -5906,37 +7089,75 @@ FUNCTION void projection_model_dd(const double& tac);
 	* Projections are based on estimated constant natural mortality 
 	* Currently, reference points are historical only, based average historical biomass and ft, and minimum biomass, based on years provided in the pfc file
 	* TO DO: implement fmsy and bo-based reference points
+	* The history, reference points and recruitment deviates are shared by
+	  all TAC options; DDProjection advances the biomass, numbers and catch
+	  equation of every TAC option in contiguous arrays.
+	* The inputs of the draw are saved in the state file (see
+	  open_projection_state) and projected by run_projections_dd (see
+	  projection_only).
 	
 	*/
-	static int runNo=0;
-	runNo ++;
+	static int iter=0;
+	if(mceval_phase()) iter ++;
+
+	DDProjectionDraw d;
+	d.draw  = mceval_phase() ? pmcevalFirstDraw + iter : 0;
+	d.so    = value(so(1));
+	d.beta  = value(beta(1));
+	d.tau   = value(tau(1));
+	d.M     = value(M_dd(1)(syr));	//m_bar is same as constant M
+	d.rho   = rho_g(1);
+	d.alpha = alpha_g(1);
+	d.wk    = wk(1);
+	d.ft    = value(ft(1)(1)(syr,nyr));
+	d.N     = value(numbers(1)(syr,nyr));
+	d.bt    = value(biomass(1)(syr,nyr)); //sbt and vul biomass all the same for delay diff
+	d.S     = value(surv(1)(syr,nyr));
+	d.bo    = bo(1);
+	d.bmsy  = bmsy(1);
+	d.fmsy  = fmsy(1,1);
+
+	// Only the mceval and final MPD projections are written.
+	if(mceval_phase() || last_phase()){
+		static BufferedOfstream ofs;
+		open_projection_state(ofs, 1);
+		d.write(ofs);
+		if(!mceval_phase()) ofs.close();
+		if(!pmcevalWorker) run_projections_dd(tac, d, mceval_phase());
+	}
+  }
+
+FUNCTION void run_projections_dd(const dvector& tac, DDProjectionDraw& d, const bool& mcmc)
+  {
+	/*
+	Constant TAC projections of one delay difference draw (from
+	projection_model_dd or from the saved state in projection_only) and
+	their output, iscammcmc.proj for mcmc = true and iscammpd.proj
+	otherwise.  The historical reference points come from the biomass and
+	ft of the draw.  The projection runs for n_proj years (pf_cntrl(10));
+	the .proj files keep the nyr+1 and nyr+2 columns.  In mceval, as in
+	run_projections, every draw is added to decisionTable and
+	iscammcmc_proj_years.csv has one row for each draw, TAC and projection
+	year.
+	*/
+	static int nmcmc=0;
+	static int nmpd=0;
+	static BufferedOfstream ofsmcmc;	// open until the end of the run
+	static BufferedOfstream ofsyrs;
 	int i;
 	int pyr = nyr+2;	//projection year. 
+	int lyr = nyr+n_proj;	//last projection year.
+
+	int ntac = tac.indexmax()-tac.indexmin()+1;
+
+	// Same recruitment deviates for each tac (see run_projections).
+	CounterRng rng(rseed, CounterRng::PROJ_RECRUITMENT);
+	dvector xx(nyr+1,lyr);
+	for(i = nyr+1; i<=lyr; i++){
+		xx(i) = rng.randn(d.draw,0,i)*d.tau;
+	}
+	d.xx = xx;
 
-	 BaranovCatchEquation cBaranov;
-	     
-	//get parameters - convert to data objects
-	//double pbo   = value(bo(1));
-	//double pso = value (so(1));
-	//double pbeta =value(beta(1));
-		  
-	dvector p_bt(syr,pyr);
-	dvector p_ft(syr,pyr);
-	dvector p_N(syr,pyr);
-	dvector p_S(syr,pyr);
-	dvector p_rt(syr+sage,pyr);//dmatrix p_Ft(1,ngear,syr,pyr);
-	p_bt.initialize();
-	p_ft.initialize();
-	p_N.initialize();
-	p_S.initialize();
-	p_rt.initialize();
-	
-	p_ft(syr,nyr) = value(ft(1)(1)(syr,nyr));
-	p_N(syr,nyr) = value(numbers(1)(syr,nyr));
-	p_bt(syr,nyr)   = value(biomass(1)(syr,nyr)); //sbt and vul biomass all the same for delay diff
-	p_S(syr,nyr)   = value(surv(1)(syr,nyr));
-	p_rt(syr+sage,nyr)   = value(rt(1)(syr+sage,nyr));
-	
 	// *** HISTORICAL REFERENCE POINTS *** //
 	//Values needed for calculating historical reference points
 	int nshort=pf_cntrl(7)-syr+1;
@@ -5954,13 +7175,13 @@ FUNCTION void projection_model_dd(const double& tac);
         hist_ftshort.initialize();  hist_ftlong.initialize();
 	hist_btshort.initialize();  hist_btlong.initialize();
 
-	hist_ftshort=value(ft(1)(1)(syr,pf_cntrl(7)));
-	hist_btshort=value(biomass(1)(syr,pf_cntrl(7)));
+	hist_ftshort=d.ft(syr,int(pf_cntrl(7)));
+	hist_btshort=d.bt(syr,int(pf_cntrl(7)));
 	
 	if(nyr>=pf_cntrl(8)){
 
-		hist_ftlong=value(ft(1)(1)(syr,pf_cntrl(8)));
-		hist_btlong=value(biomass(1)(syr,pf_cntrl(8)));
+		hist_ftlong=d.ft(syr,int(pf_cntrl(8)));
+		hist_btlong=d.bt(syr,int(pf_cntrl(8)));
 	}
 
 	meanfshort=sum(hist_ftshort)/nshort;
@@ -5973,39 +7194,12 @@ FUNCTION void projection_model_dd(const double& tac);
 
 	
 	/* Simulate population into the future under constant tac policy. */
-	for(i = nyr+1; i<=pyr; i++)
-	{
-		//recruits
-		//double p_tau = value(sqrt(1-rho)/varphi);
-		double p_tau = value(tau(1)); 
-		double xx = randn(nf+i)*p_tau;
-			
-		//double rt;
-		double et=p_bt(i-kage(1)); //delay diff
-
-		if(d_iscamCntrl(2)==1)p_rt(i)=value((so(1)*et/(1.+beta(1)*et))*exp(xx-0.5*p_tau*p_tau));
-		if(d_iscamCntrl(2)==2)p_rt(i)=value((so(1)*et*exp(-beta(1)*et))*exp(xx-0.5*p_tau*p_tau));
-				
-		//numbers and biomass
-		//Update biomass and numbers	
-		p_bt(i) =(p_S(i-1)*(rho_g(1)*p_bt(i-1)+alpha_g(1)*p_N(i-1))+wk(1)*p_rt(i));
-		p_N(i)=p_S(i-1)*p_N(i-1)+p_rt(i);
-               	//LOG<<i<<"  "<<p_rt(i)<<"  "<<p_bt(i)<<"  "<<p_N(i)<<'\n';
-
-		//get_ftdd is defined in the Baranov.cpp file
-		p_ft(i) = cBaranov.get_ftdd(tac,value(M_dd(1)(syr)),p_bt(i));	    //hardwiring the catch to gear 1 for this assessment       m_bar is same as constant M
-
-		/*
-		//test get_ftdd with Baranov equation
-		double testf =p_ft(i);
-		double testc = p_bt(i)*(1-mfexp(-value(m)-testf))*(testf/(value(m) + testf));
-		LOG<<i<<"  "<<testf<<"  "<<tac<<"  "<<testc<<'\n'<<'\n';
-		*/
-		
-		//Calculate mortality for next projection year
-		p_S(i) = mfexp(-(value(M_dd(1)(syr))+p_ft(i)));
-				
-	} 
+	//hardwiring the catch to gear 1 for this assessment
+	DDProjection cProj(ntac, syr, nyr, kage(1), n_proj, int(d_iscamCntrl(2)));
+	for(int t=1; t<=ntac; t++){
+		cProj.setProblem(t, d, tac(tac.indexmin()+t-1));
+	}
+	cProj.run();
 	
 	
 	//_S= Short: Start and end year in pfc file (for P. cod 1956-2004) 
@@ -6013,10 +7207,11 @@ FUNCTION void projection_model_dd(const double& tac);
 	
 	//QUANTITIES NEEDED FOR DECISION TABLE
 	//TO DO: IMPLEMENT MSY AND B0-BASED REFERENCE POINTS AND ADD TO TABLE (LRP=0.2B0; USR=0.4B0 -- could add these to control file)
-	if(mceval_phase()){
-		if(nf==1 && runNo==1)
+	if(mcmc){
+		BufferedOfstream& ofsP = ofsmcmc;
+		if(nmcmc++==0)
 		{
-			ofstream ofsP("iscammcmc.proj");
+			ofsP.open("iscammcmc.proj");
 			ofsP<<"tac" <<setw(6)     <<   "\t";
 			ofsP<<"B_"<<nyr+1 <<setw(6)     <<   "\t";
 			ofsP<<"B_"<<nyr+2<<setw(6)     <<   "\t";
@@ -6045,43 +7240,74 @@ FUNCTION void projection_model_dd(const double& tac);
 			ofsP<<"F_"<<nyr+1<<"FAvg_L\n";		   //want probability Fnyr+1>FAvg - this will be > 1 if true
 		      
 			LOG<<"Running MCMC evaluations"<<'\n';
-			LOG<<"Bo when nf==1 \t"<<bo<<'\n';
+			LOG<<"Bo when nf==1 \t"<<d.bo<<'\n';
 		}
 
-		ofstream ofsP("iscammcmc.proj",ios::app);
-		ofsP <<tac <<setw(6)                            <<"\t"
-		  << p_bt(pyr-1) <<setw(6)       <<"\t"	      
-		  << p_bt(pyr) <<setw(6)       <<"\t"		 
-		  << p_bt(pyr)/p_bt(pyr-1) <<setw(6)      <<"\t"	     
-		 << p_ft(pyr-2) <<setw(6)      <<"\t"
-		 << p_ft(pyr-1)  <<setw(6)     <<"\t"
-		 << p_ft(pyr-1)/p_ft(pyr-2)  <<setw(6)     <<"\t"	 
-		//MSY based ref points
-		<<bmsy <<setw(6)     <<   "\t"
-		<<p_bt(pyr)/bmsy <<setw(6)     <<   "\t"		 
-		<<p_bt(pyr)/(0.8*bmsy) <<setw(6)     <<   "\t"		  
-		<<p_bt(pyr)/(0.4*bmsy) <<setw(6)     <<   "\t"		   
-		<<fmsy <<setw(6)     <<   "\t"
-		<<p_ft(pyr-1)/fmsy <<setw(6)     <<   "\t"		   
-		//Historical ref points "short"	 
-		<<minb <<setw(6)     <<   "\t"
-		<<p_bt(pyr)/minb <<setw(6)     <<   "\t"		   
-		<<meanbshort <<setw(6)     <<   "\t"
-		<<p_bt(pyr)/meanbshort <<setw(6)     <<   "\t"		   
-		<<meanfshort <<setw(6)     <<   "\t"
-		<<p_ft(pyr-1)/meanfshort<<setw(6)     <<   "\t"		  
-		 //Historical ref points "long"	 
-		<<meanblong <<setw(6)     <<   "\t"
-		<<p_bt(pyr)/meanblong <<setw(6)     <<   "\t"		   
-		<<meanflong <<setw(6)     <<   "\t"
-		<<p_ft(pyr-1)/meanflong<<   "\t"		   	   		   
-		 <<'\n';
+		for(int t=1; t<=ntac; t++){
+			double p_tac = cProj.getTac(t);
+			dvector p_bt(pyr-1,pyr);
+			dvector p_ft(pyr-2,pyr-1);
+			for(i = pyr-1; i<=pyr; i++) p_bt(i) = cProj.getBt(t,i);
+			for(i = pyr-2; i<=pyr-1; i++) p_ft(i) = cProj.getFt(t,i);
+			ofsP <<p_tac <<setw(6)                            <<"\t"
+			  << p_bt(pyr-1) <<setw(6)       <<"\t"	      
+			  << p_bt(pyr) <<setw(6)       <<"\t"		 
+			  << p_bt(pyr)/p_bt(pyr-1) <<setw(6)      <<"\t"	     
+			 << p_ft(pyr-2) <<setw(6)      <<"\t"
+			 << p_ft(pyr-1)  <<setw(6)     <<"\t"
+			 << p_ft(pyr-1)/p_ft(pyr-2)  <<setw(6)     <<"\t"	 
+			//MSY based ref points
+			<<d.bmsy <<setw(6)     <<   "\t"
+			<<p_bt(pyr)/d.bmsy <<setw(6)     <<   "\t"		 
+			<<p_bt(pyr)/(0.8*d.bmsy) <<setw(6)     <<   "\t"		  
+			<<p_bt(pyr)/(0.4*d.bmsy) <<setw(6)     <<   "\t"		   
+			<<d.fmsy <<setw(6)     <<   "\t"
+			<<p_ft(pyr-1)/d.fmsy <<setw(6)     <<   "\t"		   
+			//Historical ref points "short"	 
+			<<minb <<setw(6)     <<   "\t"
+			<<p_bt(pyr)/minb <<setw(6)     <<   "\t"		   
+			<<meanbshort <<setw(6)     <<   "\t"
+			<<p_bt(pyr)/meanbshort <<setw(6)     <<   "\t"		   
+			<<meanfshort <<setw(6)     <<   "\t"
+			<<p_ft(pyr-1)/meanfshort<<setw(6)     <<   "\t"		  
+			 //Historical ref points "long"	 
+			<<meanblong <<setw(6)     <<   "\t"
+			<<p_bt(pyr)/meanblong <<setw(6)     <<   "\t"		   
+			<<meanflong <<setw(6)     <<   "\t"
+			<<p_ft(pyr-1)/meanflong<<   "\t"		   	   		   
+			 <<'\n';
+		}
+
+		// Decision table and per-year rows, as in run_projections (gear 1 only).
+		if(!decisionTable.allocated()){
+			decisionTable.allocate(tac, syr, nyr, d_iscamCntrl(17));
+		}
+		if(drawCsv && !ofsyrs.is_open()){
+			ofsyrs.open("iscammcmc_proj_years.csv");
+			write_proj_year_headers(ofsyrs, 1, d_iscamCntrl(17));
+		}
+		for(int t=1; t<=ntac; t++){
+			dvector p_tac(nyr+1,lyr);
+			dvector p_bt(syr,lyr);
+			dmatrix p_ft(syr,lyr,1,1);
+			ivector p_clip(nyr+1,lyr);
+			p_tac = cProj.getTac(t);
+			for(i = syr; i<=lyr; i++){
+				p_bt(i)   = cProj.getBt(t,i);
+				p_ft(i,1) = cProj.getFt(t,i);
+			}
+			for(i = nyr+1; i<=lyr; i++) p_clip(i) = cProj.getClipped(t,i);
+			decisionTable.add(t, p_bt, p_ft, d.ft(nyr), d.bo, d.fmsy, d.bmsy);
+			if(drawCsv){
+				write_proj_years(ofsyrs, d.draw, p_tac, nyr, lyr, p_bt, p_ft, p_clip, d.bo, d.bmsy, d_iscamCntrl(17));
+			}
+		}
 	   }
 
 	 //MPD projections
  	//TO DO: IMPLEMENT MSY AND B0-BASED REFERENCE POINTS AND ADD TO TABLE (LRP=0.2B0; USR=0.4B0 -- could add proportions to control file)
-       if(last_phase() && !mceval_phase()){
-	   		if(runNo==1)
+       else{
+	   		if(nmpd++==0)
 	   		{
 	   			LOG<<"Running MPD projections"<<'\n';
 	   			
@@ -6115,36 +7341,43 @@ FUNCTION void projection_model_dd(const double& tac);
 				
 	   		}
 	   
-	   		LOG<<"tac = "<<tac<<'\n';
 	   		ofstream ofsP("iscammpd.proj",ios::app);
-	   		ofsP 
-	   		  <<tac <<setw(6)                            <<"\t"
-			  << p_bt(pyr-1) <<setw(6)       <<"\t"	      
-			  << p_bt(pyr) <<setw(6)       <<"\t"		 
-			  << p_bt(pyr)/p_bt(pyr-1) <<setw(6)      <<"\t"	     
-		  	 << p_ft(pyr-2) <<setw(6)      <<"\t"
-			 << p_ft(pyr-1)  <<setw(6)     <<"\t"
-		  	 << p_ft(pyr-1)/p_ft(pyr-2)  <<setw(6)     <<"\t"	 
-			//MSY based ref points
-			<<bmsy <<setw(6)     <<   "\t"
-			<<p_bt(pyr)/bmsy <<setw(6)     <<   "\t"		 
-			<<p_bt(pyr)/(0.8*bmsy) <<setw(6)     <<   "\t"		  
-			<<p_bt(pyr)/(0.4*bmsy) <<setw(6)     <<   "\t"		   
-			<<fmsy <<setw(6)     <<   "\t"
-			<<p_ft(pyr-1)/fmsy <<setw(6)     <<   "\t"		   
-			//Historical ref points "short"	 
-			<<minb <<setw(6)     <<   "\t"
-			<<p_bt(pyr)/minb <<setw(6)     <<   "\t"		   
-			<<meanbshort <<setw(6)     <<   "\t"
-			<<p_bt(pyr)/meanbshort <<setw(6)     <<   "\t"		   
-			<<meanfshort <<setw(6)     <<   "\t"
-			<<p_ft(pyr-1)/meanfshort<<setw(6)     <<   "\t"		  
-			 //Historical ref points "long"	 
-			<<meanblong <<setw(6)     <<   "\t"
-			<<p_bt(pyr)/meanblong <<setw(6)     <<   "\t"		   
-			<<meanflong <<setw(6)     <<   "\t"
-			<<p_ft(pyr-1)/meanflong<<   "\t"		   	   		   
-			<<'\n';
+	   		for(int t=1; t<=ntac; t++){
+	   			double p_tac = cProj.getTac(t);
+	   			dvector p_bt(pyr-1,pyr);
+	   			dvector p_ft(pyr-2,pyr-1);
+	   			for(i = pyr-1; i<=pyr; i++) p_bt(i) = cProj.getBt(t,i);
+	   			for(i = pyr-2; i<=pyr-1; i++) p_ft(i) = cProj.getFt(t,i);
+	   			LOG<<"tac = "<<p_tac<<'\n';
+		   		ofsP 
+		   		  <<p_tac <<setw(6)                            <<"\t"
+				  << p_bt(pyr-1) <<setw(6)       <<"\t"	      
+				  << p_bt(pyr) <<setw(6)       <<"\t"		 
+				  << p_bt(pyr)/p_bt(pyr-1) <<setw(6)      <<"\t"	     
+			  	 << p_ft(pyr-2) <<setw(6)      <<"\t"
+				 << p_ft(pyr-1)  <<setw(6)     <<"\t"
+			  	 << p_ft(pyr-1)/p_ft(pyr-2)  <<setw(6)     <<"\t"	 
+				//MSY based ref points
+				<<d.bmsy <<setw(6)     <<   "\t"
+				<<p_bt(pyr)/d.bmsy <<setw(6)     <<   "\t"		 
+				<<p_bt(pyr)/(0.8*d.bmsy) <<setw(6)     <<   "\t"		  
+				<<p_bt(pyr)/(0.4*d.bmsy) <<setw(6)     <<   "\t"		   
+				<<d.fmsy <<setw(6)     <<   "\t"
+				<<p_ft(pyr-1)/d.fmsy <<setw(6)     <<   "\t"		   
+				//Historical ref points "short"	 
+				<<minb <<setw(6)     <<   "\t"
+				<<p_bt(pyr)/minb <<setw(6)     <<   "\t"		   
+				<<meanbshort <<setw(6)     <<   "\t"
+				<<p_bt(pyr)/meanbshort <<setw(6)     <<   "\t"		   
+				<<meanfshort <<setw(6)     <<   "\t"
+				<<p_ft(pyr-1)/meanfshort<<setw(6)     <<   "\t"		  
+				 //Historical ref points "long"	 
+				<<meanblong <<setw(6)     <<   "\t"
+				<<p_bt(pyr)/meanblong <<setw(6)     <<   "\t"		   
+				<<meanflong <<setw(6)     <<   "\t"
+				<<p_ft(pyr-1)/meanflong<<   "\t"		   	   		   
+				<<'\n';
+	   		}
 	   }
 	}
 
@@ -6188,12 +7421,29 @@ GLOBALS_SECTION
   #include <string.h>
   #include <unistd.h>
   #include <fcntl.h>
+  #include <sys/stat.h>
+  #include <sys/types.h>
+  #include <sys/wait.h>
+  #include <sstream>
   #include "../../include/baranov.h"
+  #include "../../include/buffered_ofstream.h"
+  #include "../../include/output_manifest.h"
+  #include "../../include/posterior_table.h"
+  #include "../../include/counter_rng.h"
+  #include "../../include/ddmsy.h"
+  #include "../../include/dd_projection.h"
+  #include "../../include/decision_table.h"
+  #include "../../include/draw_memo.h"
   #include "../../include/gdbprintlib.h"
   #include "../../include/LogisticNormal.h"
   #include "../../include/LogisticStudentT.h"
+  #include "../../include/mcmc_chains.h"
+  #include "../../include/mcmc_monitor.h"
   #include "../../include/msy.h"
   #include "../../include/msy.hpp"
+  #include "../../include/msy_frontier.hpp"
+  #include "../../include/parallel.h"
+  #include "../../include/projection_model.h"
   #include "../../include/multinomial.h"
   #include "../../include/utilities.h"
   #include "../../include/Logger.h"
@@ -6209,6 +7459,21 @@ GLOBALS_SECTION
   // Variables to store results from DIC calculations.
   double dicNoPar = 0;
   double dicValue = 0;
+  // Projection inputs kept for each mceval draw (harvest control rule projections).
+  std::vector<ProjectionDraw> hcrDraws;
+  // Decision table accumulated over the mceval draws.
+  DecisionTable decisionTable;
+  PosteriorTable mcmcTables[7];  ///< mcmc_output files, open for the whole mceval.
+  const char* mcmcTableNames[7] = {"iscam_mcmc", "iscam_sbt_mcmc", "iscam_rt_mcmc",
+    "iscam_ft_mcmc", "iscam_rdev_mcmc", "iscam_vbt_mcmc", "iscam_ut_mcmc"};
+  const char* mcmcSeries[7] = {"mcmc", "sbt", "rt", "ft", "rdev", "vbt", "ut"};  ///< OutputManifest names of mcmcTables.
+  OutputManifest outputManifest;  ///< Series written in mceval (-manifest).
+  DrawMemo drawMemo;  ///< Repeated mceval draws (-memo).
+  bool pmcevalWorker = false;  ///< This process is a -pmceval worker.
+  int pmcevalFirstDraw = 0;    ///< Draws before the chunk of a -pmceval worker.
+  const long monitorEvery = 1000;  ///< Evaluations between two mcmc_monitor checks.
+  ConvergenceMonitor mcmcMonitor;  ///< Diagnostics of the -mcmc draws (mcmc_monitor).
+  DrawCache monitorCache(2*monitorEvery);  ///< Monitored values of the evaluations since the last check.
 
 //Extra test functions by RF to test ref points
 //Called by run_FRP() in calcReferencePoints
@@ -6327,63 +7592,6 @@ FUNCTION void slow_msy(dvector& ftest,
   LOG<<fmsy<<'\n';
   LOG<<bmsy<<'\n';
 
-FUNCTION void ddiff_msy(dvector& ftest,
-                        dvector& ye,
-                        dvector& be,
-                        double& msy,
-                        double& fmsy,
-                        double& bmsy)
-  int k;
-  int NF = size_count(ftest);
-  ye.initialize();
-  be.initialize();
-  dvariable rec_a;
-  dvariable rec_b;
-  dvariable M;
-
-  //double M = value(m);
-  rec_a=value(so(1));
-  rec_b=value(beta(1));
-  //int f,g,h,ih,gs;
-
-  // Calculate equilibrium survivorship as function of FMSY
-  for(k = 1; k <= NF; k++){
-    double se; //survival in equilibrium
-    double we; //average weight in equilibrium
-    se = exp(-value(M_dd(1)(nyr)) - ftest(k));
-    we = (se*alpha_g(1)+wk(1) *(1.-se))/(1.-rho_g(1)*se);
-    be(k) = value(-1 * ((-we + se * alpha_g(1) + se * rho_g(1) * we +
-      wk(1) * rec_a * we)/(rec_b * (-we + se * alpha_g(1) + se *
-      rho_g(1) * we))));
-    M = value(M_dd(1)(nyr));
-    ye(k) = value(be(k) * (1.0 - mfexp(-ftest(k) - M)) * (ftest(k) /
-      (ftest(k) + M)));
-    if(ye(k) < 0){
-      ye(k) = 0;
-    }
-    if(be(k) < 0){
-      be(k) = 0;
-    }
-  }
-
-  //LOG<<"ye"<<ye<<'\n';
-  //LOG<<"be"<<be<<'\n';
-  //LOG<<"ftest"<<ftest<<'\n';
-  //exit(1);
-  double mtest;
-  msy = max(ye);
-  for(k = 1; k <= NF; k++){
-    mtest = ye(k);
-    if(mtest == msy){
-      fmsy = ftest(k);
-      bmsy = be(k);
-    }
-  }
-  LOG<<"Slow msy calcs"<<'\n';
-  LOG<<"msy = "<<msy<<'\n';
-  LOG<<"fmsy = "<<fmsy<<'\n';
-  LOG<<"bmsy = "<<bmsy<<'\n';
-
 //RF's function for calling slow msy routine to test ref points
 //Called by calcReferencePoints if turned on
 FUNCTION void run_FRP()
@@ -6424,32 +7632,51 @@ FUNCTION void run_FRP()
   ofsr<<"Ye"<<'\n'<<Ye<<'\n';
   ofsr<<"Be"<<'\n'<<Be<<'\n';
 
-//RF's function for calling slow msy routine to test ref points -- currently
-// the only ref points implemented for delay difference model
+//MSY-based reference points for the delay difference model, one stock per
+// group.  Fmsy is found with the analytic Newton solver in DDMsy (ddmsy.h);
+// the groups are solved concurrently.
 //Called by calcReferencePoints
 FUNCTION void run_FRPdd()
-  if(n_ags > 1){
-    LOG<<"MSY quantities not defined for n_ags > 1"<<'\n';
+  if(n_ags != ngroup){
+    LOG<<"MSY quantities not defined for more than one area or sex per group"<<'\n';
   }else{
-    if(last_phase()){
-      LOG<<"\nGetting ref points the slow way for delay difference model\n";
-      LOG<<"*******************************************\n\n";
+    std::vector<DDMsy> c_dd;
+    for(int g = 1; g <= ngroup; g++){
+      int ig = pntr_ags(1,g,1);
+      int gs = pntr_gs(g,1);
+      c_dd.push_back(DDMsy(value(so(g)), value(beta(g)), value(M_dd(ig)(nyr)),
+                           alpha_g(gs), rho_g(gs), wk(gs),
+                           int(d_iscamCntrl(2))));
     }
-    dvector ftest(1, 101);
-    ftest.fill_seqadd(0, 0.01);
-
-    int Nf = size_count(ftest);
-
+    DDMsy::solve(c_dd);
     for(int g = 1; g <= ngroup; g++){
-      //dvector Ye(1, Nf); // Should be a matrix by group and gear?
-      //Matrix for putting numerically derived equilibrium catches for
-      // calculating MSY and FMSY (in R)
-      //dvector Be(1, Nf); // Should be a matrix by group?
-      dvector ye(1, Nf); // i think this should be a matrix by group and gear
-      dvector be(1, Nf);
-      ddiff_msy(ftest, ye, be, msy(g, 1), fmsy(g, 1), bmsy(g));
+      fmsy(g, 1) = c_dd[g-1].getFmsy();
+      msy(g, 1)  = c_dd[g-1].getMsy();
+      bmsy(g)    = c_dd[g-1].getBmsy();
+      if(c_dd[g-1].getFail() && last_phase() && !mceval_phase()){
+        LOG<<"Delay difference Fmsy for group "<<g<<" is at the upper bound\n";
+      }
     }
   }
 
 FINAL_SECTION
   LOG<<"\n\nNumber of function evaluations: "<<nf<<'\n';
+  if(drawMemo.getDraws()){
+    LOG<<drawMemo.getRepeats()<<" of "<<drawMemo.getDraws()
+       <<" mceval draws repeated the previous draw and were not evaluated (-memo)\n";
+  }
+  if(!pmcevalWorker){
+    write_mcmc_projections();
+  }
+  close_mcmc_output();
+  // Baranov catch equation convergence counters for the whole run.
+  BaranovStats bstats = BaranovCatchEquation::getStats();
+  if(bstats.calls){
+    ofstream ofs("iscam_baranov.txt");
+    bstats.write(ofs);
+    if(bstats.unconverged || bstats.clipped){
+      LOG<<"Baranov solver: "<<bstats.unconverged<<" of "<<bstats.calls
+         <<" solves did not converge, "<<bstats.clipped
+         <<" hit MAXF (see iscam_baranov.txt)\n";
+    }
+  }